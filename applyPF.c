@@ -9,6 +9,16 @@
 
 #include "CommandLineInterface/CLIcore.h"
 
+#include "linPF_frac.h"
+#include "linPF_mvm.h"
+#include "linPF_place.h"
+#include "linPF_lathist.h"
+#include "linPF_rtpool.h"
+#include "linPF_runs.h"
+#include "linPF_sched.h"
+#include "linPF_sparse.h"
+#include "linPF_tfir.h"
+#include "linPF_wait.h"
 
 
 #ifdef HAVE_CUDA
@@ -24,19 +34,132 @@ static char *inmask;
 
 static char *PFmat;
 
+static uint64_t *PFsparse;
+static long      fpi_PFsparse;
+
+static char *mvmkernel;
+
+static uint64_t *tfirmode;
+static long      fpi_tfirmode;
+
 static char *outdata;
 static char *outmask;
 
+static uint32_t *MHmain;
+static long      fpi_MHmain;
+
+static uint64_t *fracenable;
+static long      fpi_fracenable;
+
+static float *fraclat0;
+static long   fpi_fraclat0;
+
+static float *fracdlat;
+static long   fpi_fracdlat;
+
+static float *fracactlat;
+static long   fpi_fracactlat;
+
+static float *fractau;
+static long   fpi_fractau;
+
+static float *fracalpha;
+static long   fpi_fracalpha;
+
+static float *fracTframe;
+static long   fpi_fracTframe;
+
+static uint64_t *fracNBclamp;
+static long      fpi_fracNBclamp;
+
 
 static char *GPUsetstr;
 static long  fpi_GPUsetstr;
 
+static char *CPUsetstr;
+
+static char *RTcpusetstr;
+
+static int32_t *RTpriority;
+static long     fpi_RTpriority;
+
+static uint64_t *RTmlock;
+static long      fpi_RTmlock;
+
+static char *NUMApolicystr;
+
+static int32_t *NUMAnode;
+static long     fpi_NUMAnode;
+
+static float *NUMAPFmatlocal;
+static long   fpi_NUMAPFmatlocal;
+
+static float *NUMAinbufflocal;
+static long   fpi_NUMAinbufflocal;
+
+static float *NUMAoutlocal;
+static long   fpi_NUMAoutlocal;
+
+static int32_t *RTFIFO;
+static long     fpi_RTFIFO;
+
+static int32_t *RTmlocked;
+static long     fpi_RTmlocked;
+
 static uint64_t *compOLresidual;
 static long      fpi_compOLresidual;
 
 static uint32_t *compOLresidualNBpt;
 static long      fpi_compOLresidualNBpt;
 
+static uint64_t *monitor;
+static long      fpi_monitor;
+
+static float *monitorlag;
+static long   fpi_monitorlag;
+
+static uint32_t *monitorNBpt;
+static long      fpi_monitorNBpt;
+
+static uint64_t *latenable;
+static long      fpi_latenable;
+
+static uint32_t *latNBframe;
+static long      fpi_latNBframe;
+
+static float *lattotalp50;
+static long   fpi_lattotalp50;
+
+static float *lattotalp99;
+static long   fpi_lattotalp99;
+
+static float *lattotalp999;
+static long   fpi_lattotalp999;
+
+static float *lattotalmax;
+static long   fpi_lattotalmax;
+
+static float *latperiodp999;
+static long   fpi_latperiodp999;
+
+static uint64_t *latmissed;
+static long      fpi_latmissed;
+
+static char *waitmodestr;
+
+static float *waitspinus;
+static long   fpi_waitspinus;
+
+// wake latency of each wait strategy, see linPF_wait.h
+static uint64_t *waitNBwake[LINPF_WAIT_NBMODE];
+static long      fpi_waitNBwake[LINPF_WAIT_NBMODE];
+
+static float *waitlat[LINPF_WAIT_NBMODE];
+static long   fpi_waitlat[LINPF_WAIT_NBMODE];
+
+static float *waitlatmax[LINPF_WAIT_NBMODE];
+static long   fpi_waitlatmax[LINPF_WAIT_NBMODE];
+
 
 
 static CLICMDARGDEF farg[] =
@@ -81,6 +204,37 @@ static CLICMDARGDEF farg[] =
         (void **) &PFmat,
         NULL
     },
+    {
+        // use sparse (CSR) filter <PFmat>_sprow, _spcol, _spval
+        CLIARG_ONOFF,
+        ".sparse",
+        "apply sparse filter",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &PFsparse,
+        &fpi_PFsparse
+    },
+    {
+        // CPU MVM kernel: auto, generic, sse, avx2, avx512
+        CLIARG_STR,
+        ".mvmkernel",
+        "CPU MVM kernel",
+        "auto",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &mvmkernel,
+        NULL
+    },
+    {
+        // compute older inputs contribution ahead of next frame (CPU)
+        // see linPF_tfir.c
+        CLIARG_ONOFF,
+        ".tfir",
+        "split apply, older inputs ahead",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &tfirmode,
+        &fpi_tfirmode
+    },
     {
         // Output stream
         CLIARG_STREAM,
@@ -101,6 +255,91 @@ static CLICMDARGDEF farg[] =
         (void **) &outmask,
         NULL
     },
+    {
+        // with a multi-horizon filter cube, horizon written to outdata
+        // all horizons are written to <outdata>_MH
+        CLIARG_UINT32,
+        ".MH.main",
+        "horizon index of main output",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &MHmain,
+        &fpi_MHmain
+    },
+    {
+        // main output interpolated between horizons of the filter cube,
+        // at horizon estimated from input time stamps, see linPF_frac.c
+        CLIARG_ONOFF,
+        ".frac.enable",
+        "fractional horizon output",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &fracenable,
+        &fpi_fracenable
+    },
+    {
+        CLIARG_FLOAT32,
+        ".frac.lat0",
+        "prediction latency of horizon 0 [frame]",
+        "2.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &fraclat0,
+        &fpi_fraclat0
+    },
+    {
+        CLIARG_FLOAT32,
+        ".frac.dlat",
+        "latency step between horizons [frame]",
+        "1.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &fracdlat,
+        &fpi_fracdlat
+    },
+    {
+        CLIARG_FLOAT32,
+        ".frac.actlat",
+        "output to actuation delay [frame]",
+        "0.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &fracactlat,
+        &fpi_fracactlat
+    },
+    {
+        CLIARG_FLOAT32,
+        ".frac.tau",
+        "prediction latency of last frame [frame]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &fractau,
+        &fpi_fractau
+    },
+    {
+        CLIARG_FLOAT32,
+        ".frac.alpha",
+        "interpolation weight of last frame",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &fracalpha,
+        &fpi_fracalpha
+    },
+    {
+        CLIARG_FLOAT32,
+        ".frac.Tframe",
+        "frame period estimate [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &fracTframe,
+        &fpi_fracTframe
+    },
+    {
+        CLIARG_UINT64,
+        ".frac.NBclamp",
+        "frames outside of filter horizons",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &fracNBclamp,
+        &fpi_fracNBclamp
+    },
     {
         // Set of GPU(s) for computation
         CLIARG_STR,
@@ -111,6 +350,109 @@ static CLICMDARGDEF farg[] =
         (void **) &GPUsetstr,
         &fpi_GPUsetstr
     },
+    {
+        // CPUs for MVM worker threads, e.g. "2-5", see linPF_rtpool.c
+        CLIARG_STR,
+        ".CPUset",
+        "list of CPUs for MVM workers",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &CPUsetstr,
+        NULL
+    },
+    {
+        // CPUs for the apply loop thread, e.g. "4", see linPF_place.c
+        CLIARG_STR,
+        ".RT.cpuset",
+        "list of CPUs for apply loop",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &RTcpusetstr,
+        NULL
+    },
+    {
+        // SCHED_FIFO priority of apply loop, 0 for default scheduling
+        CLIARG_INT32,
+        ".RT.priority",
+        "SCHED_FIFO priority",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &RTpriority,
+        &fpi_RTpriority
+    },
+    {
+        CLIARG_ONOFF,
+        ".RT.mlock",
+        "lock process memory",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &RTmlock,
+        &fpi_RTmlock
+    },
+    {
+        // NUMA memory policy: none, local, replicate
+        CLIARG_STR,
+        ".NUMA.policy",
+        "NUMA policy (none, local, replicate)",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &NUMApolicystr,
+        NULL
+    },
+    {
+        CLIARG_INT32,
+        ".NUMA.node",
+        "NUMA node of apply loop",
+        "-1",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NUMAnode,
+        &fpi_NUMAnode
+    },
+    {
+        CLIARG_FLOAT32,
+        ".NUMA.PFmatlocal",
+        "fraction of filter on local node",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NUMAPFmatlocal,
+        &fpi_NUMAPFmatlocal
+    },
+    {
+        CLIARG_FLOAT32,
+        ".NUMA.inbufflocal",
+        "fraction of input buffer on local node",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NUMAinbufflocal,
+        &fpi_NUMAinbufflocal
+    },
+    {
+        CLIARG_FLOAT32,
+        ".NUMA.outlocal",
+        "fraction of output on local node",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NUMAoutlocal,
+        &fpi_NUMAoutlocal
+    },
+    {
+        CLIARG_INT32,
+        ".RT.FIFO",
+        "SCHED_FIFO priority set",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &RTFIFO,
+        &fpi_RTFIFO
+    },
+    {
+        CLIARG_INT32,
+        ".RT.mlocked",
+        "process memory locked",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &RTmlocked,
+        &fpi_RTmlocked
+    },
     {
         // compute residual mismatch
         CLIARG_ONOFF,
@@ -130,6 +472,183 @@ static CLICMDARGDEF farg[] =
         CLIARG_HIDDEN_DEFAULT,
         (void **) &compOLresidualNBpt,
         &fpi_compOLresidualNBpt
+    },
+    {
+        // measure prediction residual, written to <outdata>_PFres
+        CLIARG_ONOFF,
+        ".monitor.enable",
+        "publish prediction residual",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &monitor,
+        &fpi_monitor
+    },
+    {
+        // prediction horizon, in frames, same as mkPF .PFlatency
+        CLIARG_FLOAT32,
+        ".monitor.lag",
+        "prediction lag [frame]",
+        "2.7",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &monitorlag,
+        &fpi_monitorlag
+    },
+    {
+        CLIARG_UINT32,
+        ".monitor.NBpt",
+        "sampling size for prediction residual",
+        "1000",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &monitorNBpt,
+        &fpi_monitorNBpt
+    },
+    {
+        // per-frame latency histograms, written to <outdata>_lat
+        // see linPF_lathist.c
+        CLIARG_ONOFF,
+        ".lat.enable",
+        "measure frame latency",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &latenable,
+        &fpi_latenable
+    },
+    {
+        CLIARG_UINT32,
+        ".lat.NBframe",
+        "frames per latency publication",
+        "10000",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &latNBframe,
+        &fpi_latNBframe
+    },
+    {
+        CLIARG_FLOAT32,
+        ".lat.total.p50",
+        "input to output latency 50% [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &lattotalp50,
+        &fpi_lattotalp50
+    },
+    {
+        CLIARG_FLOAT32,
+        ".lat.total.p99",
+        "input to output latency 99% [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &lattotalp99,
+        &fpi_lattotalp99
+    },
+    {
+        CLIARG_FLOAT32,
+        ".lat.total.p999",
+        "input to output latency 99.9% [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &lattotalp999,
+        &fpi_lattotalp999
+    },
+    {
+        CLIARG_FLOAT32,
+        ".lat.total.max",
+        "input to output latency max [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &lattotalmax,
+        &fpi_lattotalmax
+    },
+    {
+        CLIARG_FLOAT32,
+        ".lat.period.p999",
+        "frame period 99.9% [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &latperiodp999,
+        &fpi_latperiodp999
+    },
+    {
+        CLIARG_UINT64,
+        ".lat.missed",
+        "missed input frames",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &latmissed,
+        &fpi_latmissed
+    },
+    {
+        // input wait: sem or spin, see linPF_wait.c
+        CLIARG_STR,
+        ".wait.mode",
+        "input wait mode (sem, spin)",
+        "sem",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &waitmodestr,
+        NULL
+    },
+    {
+        // spin time before semaphore fallback, 0 for no limit
+        CLIARG_FLOAT32,
+        ".wait.spinus",
+        "spin budget [us]",
+        "10000.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &waitspinus,
+        &fpi_waitspinus
+    },
+    {
+        CLIARG_UINT64,
+        ".wait.sem.NBwake",
+        "wakes by sem",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &waitNBwake[LINPF_WAIT_SEM],
+        &fpi_waitNBwake[LINPF_WAIT_SEM]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".wait.sem.lat",
+        "sem wake latency average [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &waitlat[LINPF_WAIT_SEM],
+        &fpi_waitlat[LINPF_WAIT_SEM]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".wait.sem.latmax",
+        "sem wake latency max [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &waitlatmax[LINPF_WAIT_SEM],
+        &fpi_waitlatmax[LINPF_WAIT_SEM]
+    },
+    {
+        CLIARG_UINT64,
+        ".wait.spin.NBwake",
+        "wakes by spin",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &waitNBwake[LINPF_WAIT_SPIN],
+        &fpi_waitNBwake[LINPF_WAIT_SPIN]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".wait.spin.lat",
+        "spin wake latency average [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &waitlat[LINPF_WAIT_SPIN],
+        &fpi_waitlat[LINPF_WAIT_SPIN]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".wait.spin.latmax",
+        "spin wake latency max [us]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &waitlatmax[LINPF_WAIT_SPIN],
+        &fpi_waitlatmax[LINPF_WAIT_SPIN]
     }
 };
 
@@ -141,6 +660,10 @@ static errno_t customCONFsetup()
 {
     if(data.fpsptr != NULL)
     {
+        data.fpsptr->parray[fpi_monitor].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_latenable].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_fracenable].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_fracactlat].fpflag |= FPFLAG_WRITERUN;
     }
 
     return RETURN_SUCCESS;
@@ -190,6 +713,19 @@ static errno_t compute_function()
 #endif
 
 
+    // Pin apply loop first, so that buffers created below are placed
+    // on the local NUMA node, see linPF_place.c
+    //
+    if(linARfilterPred_place_thread(RTcpusetstr) == -1)
+    {
+        PRINT_WARNING("cannot use CPU set \"%s\" - apply loop not pinned",
+                      RTcpusetstr);
+    }
+    int RTcpu  = -1;
+    *NUMAnode  = linARfilterPred_place_node(&RTcpu);
+    printf("Apply loop on CPU %d, NUMA node %d\n", RTcpu, *NUMAnode);
+
+
     // Connect to 2D input stream
     //
     IMGID imgin = mkIMGID_from_name(indata);
@@ -197,10 +733,64 @@ static errno_t compute_function()
     long NBmodeINmax = imgin.md->size[0] * imgin.md->size[1];
 
     // connect to 2D predictive filter (PF) matrix
+    // or, in sparse mode, to its CSR streams (see linPF_sparse.c),
+    // so that only the existing filter taps are applied
     //
-    IMGID imgPFmat = mkIMGID_from_name(PFmat);
-    resolveIMGID(&imgPFmat, ERRMODE_ABORT);
-    long NBmodeOUT = imgPFmat.md->size[1];
+    // A 3D filter cube holds one filter per prediction horizon, of size
+    // PFmatncol x NBmodeOUT x NBhorizon. Its slices are contiguous, so
+    // that it is applied as one stacked (NBhorizon x NBmodeOUT) row
+    // filter, reading the input history once for all horizons.
+    //
+    IMGID   imgPFmat  = mkIMGID_from_name(PFmat);
+    long    NBhorizon = 1;
+    imageID IDsprow   = -1;
+    imageID IDspcol  = -1;
+    imageID IDspval  = -1;
+    long    NBmodeOUT;
+    long    PFmatncol;
+
+    LINARFILTERPRED_SPARSESNAP spsnap;
+    if(*PFsparse == 1)
+    {
+        NBmodeOUT =
+            linARfilterPred_sparse_connect(PFmat, &IDsprow, &IDspcol, &IDspval);
+        if(NBmodeOUT < 1)
+        {
+            PRINT_ERROR("sparse filter %s_sp* not found", PFmat);
+            DEBUG_TRACE_FEXIT();
+            return (EXIT_FAILURE);
+        }
+        // private copy, never read while mkPF updates the streams
+        linARfilterPred_sparse_snapinit(&spsnap,
+                                        NBmodeOUT,
+                                        IDsprow,
+                                        IDspcol,
+                                        IDspval);
+        // number of time steps from the 2D filter if it exists, as the
+        // sparse filter support may change when it is updated
+        resolveIMGID(&imgPFmat, ERRMODE_WARN);
+        if(imgPFmat.ID != -1)
+        {
+            PFmatncol = imgPFmat.md->size[0];
+        }
+        else
+        {
+            PFmatncol = linARfilterPred_sparse_ncol(NBmodeOUT,
+                                                    spsnap.sprow,
+                                                    spsnap.spcol);
+        }
+        printf("Sparse filter: %u coefficients\n", spsnap.sprow[NBmodeOUT]);
+    }
+    else
+    {
+        resolveIMGID(&imgPFmat, ERRMODE_ABORT);
+        NBmodeOUT = imgPFmat.md->size[1];
+        PFmatncol = imgPFmat.md->size[0];
+        if(imgPFmat.md->naxis == 3)
+        {
+            NBhorizon = imgPFmat.md->size[2];
+        }
+    }
 
     list_image_ID();
 
@@ -250,12 +840,15 @@ static errno_t compute_function()
         printf("no input mask -> assuming NBinmaskpix = %ld\n", NBinmaskpix);
 
         inmaskindex = (long *) malloc(sizeof(long) * NBinmaskpix);
+        if(inmaskindex == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
 
-        for(uint32_t ii = 0;
-                ii < imginmask.md->size[0] * imginmask.md->size[1];
-                ii++)
+        for(long ii = 0; ii < NBinmaskpix; ii++)
         {
-            inmaskindex[NBinmaskpix] = ii;
+            inmaskindex[ii] = ii;
         }
     }
     long NBmodeIN = NBinmaskpix;
@@ -263,30 +856,151 @@ static errno_t compute_function()
 
 
 
-    long NBPFstep = imgPFmat.md->size[0] / NBmodeIN;
+    // Packed filter columns may not fill the last time step. The dense
+    // filter is read NBmodeIN x NBPFstep columns per row, which must then
+    // be its row size.
+    long NBPFstep;
+    if(*PFsparse == 1)
+    {
+        NBPFstep = (PFmatncol + NBmodeIN - 1) / NBmodeIN;
+    }
+    else
+    {
+        if(PFmatncol % NBmodeIN != 0)
+        {
+            PRINT_ERROR("filter %s row size %ld is not a multiple of the "
+                        "number of active input modes %ld",
+                        PFmat,
+                        PFmatncol,
+                        NBmodeIN);
+            DEBUG_TRACE_FEXIT();
+            return (EXIT_FAILURE);
+        }
+        NBPFstep = PFmatncol / NBmodeIN;
+    }
 
     printf("Number of active input modes  = %ld  / %ld\n",
            NBmodeIN,
            NBmodeINmax);
     printf("Number of output modes        = %ld\n", NBmodeOUT);
     printf("Number of time steps          = %ld\n", NBPFstep);
+    printf("Number of horizons            = %ld\n", NBhorizon);
+
+    uint32_t MHmainindex = *MHmain;
+    if(MHmainindex >= NBhorizon)
+    {
+        PRINT_WARNING("horizon %u not in filter - using 0 for main output",
+                      MHmainindex);
+        MHmainindex = 0;
+    }
+    // rows of stacked filter
+    long NBrow = NBmodeOUT * NBhorizon;
+
+
+
+
+    // Identify GPUs
+    //
+    int  NBGPUmax = 20;
+    int  NBGPU    = 0;
+    int *GPUset   = (int *) malloc(sizeof(int) * NBGPUmax);
+    for(int gpui = 0; gpui < NBGPUmax; gpui++)
+    {
+        char gpuistr[5];
+        sprintf(gpuistr, ":%d:", gpui);
+        if(strstr(GPUsetstr, gpuistr) != NULL)
+        {
+            GPUset[NBGPU] = gpui;
+            printf("Using GPU device %d\n", gpui);
+            NBGPU++;
+        }
+    }
+    if((NBGPU > 0) && (*PFsparse == 1))
+    {
+        printf("Sparse filter not supported on GPU -> using CPU\n");
+        NBGPU = 0;
+    }
+    if((NBGPU > 0) && (NBhorizon > 1))
+    {
+        printf("Multi-horizon filter not supported on GPU -> using CPU\n");
+        NBGPU = 0;
+    }
+    if(NBGPU > 0)
+    {
+        printf("Using %d GPUs\n", NBGPU);
+    }
+    else
+    {
+        printf("Using CPU\n");
+    }
 
 
 
 
     // create input buffer holding recent input values
     //
+    // On CPU, the buffer is a ring of 2 x NBPFstep time steps: each new
+    // input is written to slot inbuffhead and to its mirror slot
+    // inbuffhead+NBPFstep, so that the NBPFstep most recent inputs are
+    // always contiguous, most recent first, starting at slot inbuffhead.
+    // No shift of older inputs is needed. The head slot is written to
+    // cnt1 of the buffer stream.
+    // GPU MVM reads the whole buffer stream, which is then shifted by one
+    // time step each frame.
+    //
     printf("Creating input buffer\n");
-    IMGID imginbuff = makeIMGID_2D("iminbuff", NBmodeIN, NBPFstep);
+    int   inbuffring = (NBGPU == 0) ? 1 : 0;
+    IMGID imginbuff  = makeIMGID_2D("iminbuff",
+                                    NBmodeIN,
+                                    (1 + inbuffring) * NBPFstep);
     createimagefromIMGID(&imginbuff);
+    long   inbuffhead = 0;
+    float *inhist     = imginbuff.im->array.F; // most recent input first
 
 
 
     // create input buffer holding recent input values
     //
     printf("Creating output buffer\n");
-    IMGID imgoutbuff = makeIMGID_2D("imoutbuff", NBmodeOUT, 1);
+    IMGID imgoutbuff = makeIMGID_2D("imoutbuff", NBmodeOUT, NBhorizon);
     createimagefromIMGID(&imgoutbuff);
+    float *PFmain = &imgoutbuff.im->array.F[NBmodeOUT * MHmainindex];
+    float *PFout  = PFmain;
+
+    // all horizons, in filter output order (not scattered by outmask)
+    IMGID imgMH;
+    if(NBhorizon > 1)
+    {
+        char MHname[STRINGMAXLEN_IMGNAME];
+        WRITE_IMAGENAME(MHname, "%s_MH", outdata);
+        imgMH = stream_connect_create_2Df32(MHname, NBmodeOUT, NBhorizon);
+    }
+
+    // fractional horizon output, interpolated between horizons
+    //
+    LINARFILTERPRED_FRAC frac;
+    float               *PFfrac = NULL;
+    if(NBhorizon > 1)
+    {
+        double dlat = *fracdlat;
+        if(dlat <= 0.0)
+        {
+            PRINT_WARNING("latency step %f not positive - using 1", dlat);
+            dlat = 1.0;
+        }
+        linARfilterPred_frac_init(&frac, NBhorizon, *fraclat0, dlat, 0.0);
+
+        PFfrac = (float *) malloc(sizeof(float) * NBmodeOUT);
+        if(PFfrac == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+    }
+    else if(*fracenable == 1)
+    {
+        PRINT_WARNING("fractional horizon needs multi-horizon filter");
+    }
 
 
     // Create output buffer holding recent output values
@@ -381,7 +1095,7 @@ static errno_t compute_function()
             // 2D array
             //
             imgout = stream_connect_create_2Df32(outdata, NBmodeOUT, 1);
-            imgout = stream_connect_create_2Df32(outmask, NBmodeOUT, 1);
+            imgoutmask = stream_connect_create_2Df32(outmask, NBmodeOUT, 1);
             for(uint32_t ii = 0; ii < NBmodeOUT; ii++)
             {
                 imgoutmask.im->array.SI8[ii] = 1;
@@ -397,9 +1111,9 @@ static errno_t compute_function()
     {
         NBoutmaskpix = 0;
         for(uint32_t ii = 0;
-                ii < imginmask.md->size[0] * imginmask.md->size[1];
+                ii < imgoutmask.md->size[0] * imgoutmask.md->size[1];
                 ii++)
-            if(imginmask.im->array.SI8[ii] == 1)
+            if(imgoutmask.im->array.SI8[ii] == 1)
             {
                 NBoutmaskpix++;
             }
@@ -428,12 +1142,15 @@ static errno_t compute_function()
         printf("no output mask -> assuming NBoutmaskpix = %ld\n", NBoutmaskpix);
 
         outmaskindex = (long *) malloc(sizeof(long) * NBoutmaskpix);
+        if(outmaskindex == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
 
-        for(uint32_t ii = 0;
-                ii < imgoutmask.md->size[0] * imgoutmask.md->size[1];
-                ii++)
+        for(long ii = 0; ii < NBoutmaskpix; ii++)
         {
-            outmaskindex[NBoutmaskpix] = ii;
+            outmaskindex[ii] = ii;
         }
     }
     if(NBmodeOUT != NBoutmaskpix)
@@ -446,32 +1163,152 @@ static errno_t compute_function()
         return (EXIT_FAILURE);
     }
 
+    // masked inputs and outputs, as runs of consecutive elements
+    // see linPF_runs.c
+    //
+    LINARFILTERPRED_RUNS inruns;
+    LINARFILTERPRED_RUNS outruns;
+    linARfilterPred_runs_init(&inruns, inmaskindex, NBmodeIN);
+    linARfilterPred_runs_init(&outruns, outmaskindex, NBmodeOUT);
+    printf("Input mask runs               = %ld\n", inruns.NBrun);
+    printf("Output mask runs              = %ld\n", outruns.NBrun);
+
+    // With a single horizon and contiguous output mask, CPU MVM output
+    // goes directly to the output stream, without scatter
+    //
+    float *PFy       = imgoutbuff.im->array.F;
+    int    outdirect = 0;
+    if((NBGPU == 0) && (NBhorizon == 1) && (outruns.NBrun == 1))
+    {
+        PFy       = &imgout.im->array.F[outruns.start[0]];
+        PFmain    = PFy;
+        PFout     = PFy;
+        outdirect = 1;
+        printf("Writing MVM output directly to %s\n", outdata);
+    }
 
 
 
-    // Identify GPUs
+
+    // NUMA placement
+    // local     : migrate filter, input buffer and output pages to the
+    //             node of the apply loop
+    // replicate : same, and apply a local copy of the filter, refreshed
+    //             when the filter stream is updated
     //
-    int  NBGPUmax = 20;
-    int  NBGPU    = 0;
-    int *GPUset   = (int *) malloc(sizeof(int) * NBGPUmax);
-    for(int gpui = 0; gpui < NBGPUmax; gpui++)
+    int NUMApolicy = linARfilterPred_place_parsepolicy(NUMApolicystr);
+    if(NUMApolicy == -1)
     {
-        char gpuistr[5];
-        sprintf(gpuistr, ":%d:", gpui);
-        if(strstr(GPUsetstr, gpuistr) != NULL)
+        PRINT_WARNING("unknown NUMA policy \"%s\" - using none",
+                      NUMApolicystr);
+        NUMApolicy = LINPF_NUMA_NONE;
+    }
+    int NUMAmove = (NUMApolicy == LINPF_NUMA_NONE) ? 0 : 1;
+
+    // filter applied by the loop thread, and its update counter
+    float             *PFmatF      = NULL;
+    volatile uint64_t *PFmatFcnt   = NULL;
+    float             *PFmatloc    = NULL;
+    uint64_t           PFmatloccnt = 0;
+    if(*PFsparse == 0)
+    {
+        size_t PFmatsize = sizeof(float) * imgPFmat.md->nelement;
+        PFmatF           = imgPFmat.im->array.F;
+        PFmatFcnt        = &imgPFmat.md->cnt0;
+        *NUMAPFmatlocal  = linARfilterPred_place_pages(PFmatF,
+                           PFmatsize,
+                           *NUMAnode,
+                           NUMAmove);
+        if(NUMApolicy == LINPF_NUMA_REPLICATE)
         {
-            GPUset[NBGPU] = gpui;
-            printf("Using GPU device %d\n", gpui);
-            NBGPU++;
+            PFmatloc = (float *) aligned_alloc(64,
+                                               ((PFmatsize + 63) / 64) * 64);
+            if(PFmatloc == NULL)
+            {
+                PRINT_ERROR("aligned_alloc returns NULL pointer");
+                abort();
+            }
+            PFmatloccnt = imgPFmat.md->cnt0;
+            memcpy(PFmatloc, imgPFmat.im->array.F, PFmatsize);
+            PFmatF          = PFmatloc;
+            PFmatFcnt       = &PFmatloccnt;
+            *NUMAPFmatlocal = linARfilterPred_place_pages(PFmatloc,
+                              PFmatsize,
+                              *NUMAnode,
+                              0);
         }
     }
-    if(NBGPU > 0)
+    *NUMAinbufflocal =
+        linARfilterPred_place_pages(imginbuff.im->array.F,
+                                    sizeof(float) * imginbuff.md->nelement,
+                                    *NUMAnode,
+                                    NUMAmove);
+    *NUMAoutlocal = linARfilterPred_place_pages(imgout.im->array.F,
+                    sizeof(float) * imgout.md->nelement,
+                    *NUMAnode,
+                    NUMAmove);
+    printf("NUMA policy %s : local fraction filter %.3f, input %.3f, "
+           "output %.3f\n",
+           linARfilterPred_place_policyname(NUMApolicy),
+           *NUMAPFmatlocal,
+           *NUMAinbufflocal,
+           *NUMAoutlocal);
+
+
+    // CPU MVM kernel, selected for this CPU, see linPF_mvm.c
+    const char              *mvmname;
+    LINARFILTERPRED_MVM_FUNC mvmfunc =
+        linARfilterPred_mvm_select(mvmkernel, &mvmname);
+    printf("CPU MVM kernel : %s\n", mvmname);
+
+    // CPU device set: each CPU runs a pinned worker thread, computing
+    // its slice of output modes when triggered
+    LINARFILTERPRED_RTPOOL rtpool;
+    rtpool.NBworker = 0;
+    if((NBGPU == 0) && (*PFsparse == 0))
     {
-        printf("Using %d GPUs\n", NBGPU);
+        int  CPUset[LINPF_SCHED_NBCPUMAX];
+        long NBCPU = linARfilterPred_sched_cpuset_parse(CPUsetstr,
+                     CPUset,
+                     LINPF_SCHED_NBCPUMAX);
+        if(NBCPU == -1)
+        {
+            PRINT_WARNING("cannot parse CPU set \"%s\" - using single thread",
+                          CPUsetstr);
+        }
+        else if(NBCPU > 0)
+        {
+            linARfilterPred_rtpool_create(&rtpool,
+                                          CPUset,
+                                          NBCPU,
+                                          mvmfunc,
+                                          NBrow,
+                                          (*tfirmode == 1) ? NBmodeIN : 0,
+                                          NBmodeIN * NBPFstep,
+                                          NBmodeIN * NBPFstep,
+                                          imgPFmat.im->array.F,
+                                          &imgPFmat.md->cnt0,
+                                          PFy);
+            printf("Using %ld CPU workers\n", NBCPU);
+        }
     }
-    else
+
+    // Split apply on single CPU thread: only the most recent input
+    // columns are multiplied between input and output, see linPF_tfir.c
+    LINARFILTERPRED_TFIR tfir;
+    int                  tfiron = 0;
+    if((NBGPU == 0) && (*PFsparse == 0) && (rtpool.NBworker == 0) &&
+            (*tfirmode == 1))
     {
-        printf("Using CPU\n");
+        linARfilterPred_tfir_init(&tfir,
+                                  mvmfunc,
+                                  NBrow,
+                                  NBmodeIN,
+                                  NBmodeIN * NBPFstep,
+                                  NBmodeIN * NBPFstep,
+                                  PFmatF,
+                                  PFmatFcnt);
+        tfiron = 1;
     }
 
     list_image_ID();
@@ -493,18 +1330,147 @@ static errno_t compute_function()
         (double *) malloc(sizeof(double) * NBPFstep * NBPFstep);
 
 
+    // Prediction residual monitoring
+    // The lag L + alpha (L integer, 0 <= alpha < 1) is fractional, as the
+    // mkPF filter latency: the prediction made at frame k is compared to
+    // (1-alpha) x[k+L] + alpha x[k+L+1], as in mkPF expected residual.
+    // Ring buffer of the last L+2 predictions, so that the prediction
+    // made L+1 frames ago can be compared to the previous and current
+    // inputs. Mean squared residual and mean squared signal are
+    // published every monitorNBpt frames in <outdata>_PFres, which mkPF
+    // reads to decide if the filter needs to be rebuilt.
+    //
+    uint32_t monlag   = (uint32_t) * monitorlag;
+    float    monalpha = *monitorlag - monlag;
+    float   *PFpredring = (float *) malloc(sizeof(float) * NBmodeOUT *
+                                         (monlag + 2));
+    float   *moninprev  = (float *) malloc(sizeof(float) * NBmodeOUT);
+    if((PFpredring == NULL) || (moninprev == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    // monitor enabled at loop count monstart, -1 if disabled
+    int64_t  monstart  = -1;
+    uint32_t monrescnt = 0;
+    double   monres2   = 0.0;
+    double   monsig2   = 0.0;
+    IMGID    imgPFres;
+    {
+        char PFresname[STRINGMAXLEN_IMGNAME];
+        WRITE_IMAGENAME(PFresname, "%s_PFres", outdata);
+        imgPFres = stream_connect_create_2Df32(PFresname, 2, 1);
+    }
+
+
+    // Latency histograms
+    // Time stamps at wake, input gathered, output computed and output
+    // posted, published every latNBframe frames to <outdata>_lat
+    //
+    LINARFILTERPRED_LATHIST *lathist =
+        (LINARFILTERPRED_LATHIST *) malloc(sizeof(LINARFILTERPRED_LATHIST));
+    if(lathist == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    linARfilterPred_lathist_init(lathist);
+    imageID IDlat = -1;
+    char    latname[STRINGMAXLEN_IMGNAME];
+    WRITE_IMAGENAME(latname, "%s_lat", outdata);
+
+
+    // Input wait strategy
+    // In spin mode, the loop is triggered immediately after the first
+    // frame, and waits on the input stream itself, see linPF_wait.c
+    //
+    LINARFILTERPRED_WAIT waitctrl;
+    int                  waitmode = linARfilterPred_wait_parsemode(waitmodestr);
+    if(waitmode == -1)
+    {
+        PRINT_WARNING("unknown wait mode \"%s\" - using sem", waitmodestr);
+        waitmode = LINPF_WAIT_SEM;
+    }
+    linARfilterPred_wait_init(&waitctrl, waitmode, *waitspinus, imgin.md->cnt0);
+    int waitsem = -1;
+    if(waitmode == LINPF_WAIT_SPIN)
+    {
+        waitsem = ImageStreamIO_getsemwaitindex(imgin.im, 1);
+    }
+    printf("Input wait mode : %s\n", linARfilterPred_wait_modename(waitmode));
+
+
+    // Real-time scheduling and memory locking, once all buffers exist
+    //
+    *RTFIFO = 0;
+    if((*RTpriority > 0) && (linARfilterPred_place_fifo(*RTpriority) == 0))
+    {
+        *RTFIFO = *RTpriority;
+    }
+    *RTmlocked = 0;
+    if((*RTmlock == 1) && (linARfilterPred_place_mlock() == 0))
+    {
+        *RTmlocked = 1;
+    }
+    printf("SCHED_FIFO priority %d, memory locked %d\n", *RTFIFO, *RTmlocked);
+
+
 
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_START
 
+    if((waitmode == LINPF_WAIT_SPIN) && (processinfo->loopcnt > 0))
+    {
+        linARfilterPred_wait_frame(&waitctrl,
+                                   imgin.md,
+                                   imgin.im->semptr[waitsem]);
+    }
+    else
+    {
+        // woken by processinfo trigger
+        waitctrl.cnt0last = imgin.md->cnt0;
+        linARfilterPred_wait_latency(&waitctrl, LINPF_WAIT_SEM, imgin.md);
+        if(waitmode == LINPF_WAIT_SPIN)
+        {
+            processinfo->triggermode = PROCESSINFO_TRIGGERMODE_IMMEDIATE;
+        }
+    }
+
+    uint64_t latmode = *latenable;
+    if(latmode == 1)
+    {
+        linARfilterPred_lathist_mark(lathist, LINPF_LAT_T_WAKE);
+    }
+    else
+    {
+        // no period or missed frames across disabled frames
+        lathist->twakeprev = 0;
+    }
+
     // Fill in input buffer most recent measurement
-    // At this point, the older measurements have already been moved down
+    // At this point, the older measurements have already been moved down,
+    // or the ring head has moved to the oldest slot
     //
-    for(long mi = 0; mi < NBmodeIN; mi++)
+    if(inbuffring == 1)
+    {
+        inbuffhead = (inbuffhead + NBPFstep - 1) % NBPFstep;
+        inhist     = &imginbuff.im->array.F[NBmodeIN * inbuffhead];
+        float *inhistmirror =
+            &imginbuff.im->array.F[NBmodeIN * (inbuffhead + NBPFstep)];
+        linARfilterPred_runs_gather(&inruns, imgin.im->array.F, inhist);
+        memcpy(inhistmirror, inhist, sizeof(float) * NBmodeIN);
+        imginbuff.md->cnt1 = inbuffhead;
+    }
+    else
     {
-        imginbuff.im->array.F[mi] = imgin.im->array.F[inmaskindex[mi]];
+        linARfilterPred_runs_gather(&inruns, imgin.im->array.F, inhist);
     }
 
+    // output stream is written from MVM on if outdirect is 1, and posted
+    // once, after all outputs are written
+    //
+    imgout.md->write = 1;
+
 
     if(NBGPU > 0)  // if using GPU
     {
@@ -538,33 +1504,183 @@ static errno_t compute_function()
                                  0);
 #endif
     }
+    else if(*PFsparse == 1)
+    {
+        // sparse filter : only existing taps are applied
+        linARfilterPred_sparse_mvm(NBmodeOUT,
+                                   spsnap.sprow,
+                                   spsnap.spcol,
+                                   spsnap.spval,
+                                   inhist,
+                                   PFy);
+    }
     else // if using CPU
     {
-        // compute output : matrix vector mult with a CPU-based loop
-        imgout.md->write = 1;
-        for(long mi = 0; mi < NBmodeOUT; mi++)
+        // compute output : matrix vector mult on CPU
+        // result goes to output buffer, like the GPU path
+        if(rtpool.NBworker > 0)
         {
-            imgout.im->array.F[mi] = 0.0;
-            for(uint32_t ii = 0; ii < NBmodeIN * NBPFstep; ii++)
-            {
-                imgout.im->array.F[mi] +=
-                    imginbuff.im->array.F[ii] *
-                    imgPFmat.im->array.F[mi * NBmodeIN * NBPFstep + ii];
-            }
+            linARfilterPred_rtpool_run(&rtpool, inhist);
+        }
+        else if(tfiron == 1)
+        {
+            linARfilterPred_tfir_output(&tfir,
+                                        inhist,
+                                        PFy);
+        }
+        else
+        {
+            mvmfunc(NBrow,
+                    NBmodeIN * NBPFstep,
+                    NBmodeIN * NBPFstep,
+                    PFmatF,
+                    inhist,
+                    PFy);
         }
-        COREMOD_MEMORY_image_set_sempost_byID(imgout.ID, -1);
-        imgout.md->write = 0;
-        imgout.md->cnt0++;
+    }
+    if(latmode == 1)
+    {
+        linARfilterPred_lathist_mark(lathist, LINPF_LAT_T_MVM);
+    }
+
+
+    // Fractional horizon : interpolate between bracketing horizons
+    //
+    int fracon = ((*fracenable == 1) && (NBhorizon > 1));
+    PFout      = PFmain;
+    if(fracon == 1)
+    {
+        frac.actlat = *fracactlat;
+        linARfilterPred_frac_update(&frac, imgin.md);
+        linARfilterPred_frac_blend(&frac,
+                                   NBmodeOUT,
+                                   PFy,
+                                   PFfrac);
+        PFout = PFfrac;
     }
 
 
     // Place output block in main output
     //
-    for(long mi = 0; mi < NBmodeOUT; mi++)
+    if(outdirect == 0)
     {
-        imgout.im->array.F[outmaskindex[mi]] = imgoutbuff.im->array.F[mi];
+        linARfilterPred_runs_scatter(&outruns, PFout, imgout.im->array.F);
     }
     processinfo_update_output_stream(processinfo, imgout.ID);
+    if(NBhorizon > 1)
+    {
+        imgMH.md->write = 1;
+        memcpy(imgMH.im->array.F,
+               PFy,
+               sizeof(float) * NBrow);
+        processinfo_update_output_stream(processinfo, imgMH.ID);
+    }
+    if(latmode == 1)
+    {
+        linARfilterPred_lathist_mark(lathist, LINPF_LAT_T_POST);
+        linARfilterPred_lathist_frame(lathist, waitctrl.cnt0last);
+    }
+
+    // Output is out: refresh local filter copy after filter update, off
+    // the critical path (an update is used from the next frame on). CPU
+    // workers read the filter stream directly.
+    //
+    if((PFmatloc != NULL) && (rtpool.NBworker == 0) &&
+            (imgPFmat.md->cnt0 != PFmatloccnt))
+    {
+        PFmatloccnt = imgPFmat.md->cnt0;
+        memcpy(PFmatloc,
+               imgPFmat.im->array.F,
+               sizeof(float) * imgPFmat.md->nelement);
+    }
+
+    // Compute older inputs contribution to next frame
+    //
+    if(tfiron == 1)
+    {
+        linARfilterPred_tfir_prepare(&tfir, inhist);
+    }
+
+    // sparse filter update is copied for next frame, see linPF_sparse.c
+    if(*PFsparse == 1)
+    {
+        linARfilterPred_sparse_snapupdate(&spsnap);
+    }
+
+    if(fracon == 1)
+    {
+        *fractau     = frac.tau;
+        *fracalpha   = frac.alpha;
+        *fracTframe  = 1.0e6 * frac.Tframe;
+        *fracNBclamp = frac.NBclamp;
+    }
+
+
+
+
+    if((*monitor == 1) && (monstart < 0))
+    {
+        // enabled, or enabled again : predictions made while monitor
+        // was off were not stored, clear ring and restart averages
+        monstart = processinfo->loopcnt;
+        memset(PFpredring, 0, sizeof(float) * NBmodeOUT * (monlag + 2));
+        monrescnt = 0;
+        monres2   = 0.0;
+        monsig2   = 0.0;
+    }
+    else if(*monitor == 0)
+    {
+        monstart = -1;
+    }
+
+    if(*monitor == 1)
+    {
+        // Compare prediction made monlag+1 frames ago with previous and
+        // current input, interpolated at fractional lag
+        //
+        int64_t monk = processinfo->loopcnt - monstart;
+        if(monk > monlag)
+        {
+            float *PFpred =
+                &PFpredring[NBmodeOUT * ((processinfo->loopcnt + 1) %
+                                         (monlag + 2))];
+            for(long mi = 0; mi < NBmodeOUT; mi++)
+            {
+                if(outmaskindex[mi] < NBmodeINmax)
+                {
+                    double vin = (1.0 - monalpha) * moninprev[mi] +
+                                 monalpha * imgin.im->array.F[outmaskindex[mi]];
+                    double vdiff = vin - PFpred[mi];
+                    monres2 += vdiff * vdiff;
+                    monsig2 += vin * vin;
+                }
+            }
+            monrescnt++;
+        }
+        memcpy(&PFpredring[NBmodeOUT *
+                           (processinfo->loopcnt % (monlag + 2))],
+               PFout,
+               sizeof(float) * NBmodeOUT);
+        for(long mi = 0; mi < NBmodeOUT; mi++)
+        {
+            if(outmaskindex[mi] < NBmodeINmax)
+            {
+                moninprev[mi] = imgin.im->array.F[outmaskindex[mi]];
+            }
+        }
+
+        if(monrescnt == *monitorNBpt)
+        {
+            imgPFres.md->write        = 1;
+            imgPFres.im->array.F[0] = monres2 / monrescnt;
+            imgPFres.im->array.F[1] = monsig2 / monrescnt;
+            processinfo_update_output_stream(processinfo, imgPFres.ID);
+
+            monrescnt = 0;
+            monres2   = 0.0;
+            monsig2   = 0.0;
+        }
+    }
 
 
 
@@ -586,7 +1702,7 @@ static errno_t compute_function()
         // update top entry
         for(long mi = 0; mi < NBmodeOUT; mi++)
         {
-            imgoutTbuff.im->array.F[mi] = imgoutbuff.im->array.F[mi];
+            imgoutTbuff.im->array.F[mi] = PFout[mi];
         }
 
 
@@ -601,7 +1717,7 @@ static errno_t compute_function()
             double val2 = 0.0;
             for(long mi = 0; mi < NBmodeOUT; mi++)
             {
-                double vdiff = imginbuff.im->array.F[mi] -
+                double vdiff = inhist[mi] -
                                imgoutTbuff.im->array.F[NBmodeOUT * tstep + mi];
                 val2 += vdiff * vdiff;
             }
@@ -620,10 +1736,10 @@ static errno_t compute_function()
                     double vave = 0.0;
                     for(long tstep1 = tstep; tstep1 < tstep + tave; tstep1++)
                     {
-                        vave += imginbuff.im->array.F[NBmodeOUT * tstep1 + mi];
+                        vave += inhist[NBmodeOUT * tstep1 + mi];
                     }
                     vave /= tave;
-                    double vdiff = imginbuff.im->array.F[mi] - vave;
+                    double vdiff = inhist[mi] - vave;
                     val2 += vdiff * vdiff;
                 }
                 OLRMS2avedt[tave * NBPFstep + tstep] += val2;
@@ -673,15 +1789,52 @@ static errno_t compute_function()
 
     // Update time buffer input
     // do this now to save time when semaphore is posted
+    // (ring buffer: nothing to move)
     //
-    for(long tstep = NBPFstep - 1; tstep > 0; tstep--)
+    if(inbuffring == 0)
     {
-        // tstep-1 -> tstep
-        for(long mi = 0; mi < NBmodeIN; mi++)
+        for(long tstep = NBPFstep - 1; tstep > 0; tstep--)
         {
-            imginbuff.im->array.F[NBmodeIN * tstep + mi] =
-                imginbuff.im->array.F[NBmodeIN * (tstep - 1) + mi];
+            // tstep-1 -> tstep
+            for(long mi = 0; mi < NBmodeIN; mi++)
+            {
+                imginbuff.im->array.F[NBmodeIN * tstep + mi] =
+                    imginbuff.im->array.F[NBmodeIN * (tstep - 1) + mi];
+            }
+        }
+    }
+
+    // Publish latency and wake latency statistics
+    //
+    if((latmode == 1) && (lathist->NBframe >= *latNBframe))
+    {
+        linARfilterPred_lathist_stream(lathist, latname, &IDlat);
+        *lattotalp50 = 1.0e-3 * linARfilterPred_lathist_percentile(lathist,
+                       LINPF_LAT_TOTAL,
+                       0.5);
+        *lattotalp99 = 1.0e-3 * linARfilterPred_lathist_percentile(lathist,
+                       LINPF_LAT_TOTAL,
+                       0.99);
+        *lattotalp999 = 1.0e-3 * linARfilterPred_lathist_percentile(lathist,
+                        LINPF_LAT_TOTAL,
+                        0.999);
+        *lattotalmax   = 1.0e-3 * linARfilterPred_lathist_max(lathist,
+                         LINPF_LAT_TOTAL);
+        *latperiodp999 = 1.0e-3 * linARfilterPred_lathist_percentile(lathist,
+                         LINPF_LAT_PERIOD,
+                         0.999);
+        *latmissed = lathist->NBmissedtot;
+        linARfilterPred_lathist_reset(lathist);
+
+        for(int mode = 0; mode < LINPF_WAIT_NBMODE; mode++)
+        {
+            *waitNBwake[mode] = waitctrl.NBwake[mode];
+            *waitlat[mode]    = (waitctrl.NBwake[mode] > 0) ?
+                                waitctrl.latsum[mode] / waitctrl.NBwake[mode] :
+                                0.0;
+            *waitlatmax[mode] = waitctrl.latmax[mode];
         }
+        linARfilterPred_wait_reset(&waitctrl);
     }
 
 
@@ -689,10 +1842,30 @@ static errno_t compute_function()
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
+    if(rtpool.NBworker > 0)
+    {
+        linARfilterPred_rtpool_destroy(&rtpool);
+    }
+    if(tfiron == 1)
+    {
+        linARfilterPred_tfir_free(&tfir);
+    }
+    if(*PFsparse == 1)
+    {
+        linARfilterPred_sparse_snapfree(&spsnap);
+    }
     free(GPUset);
     free(inmaskindex);
+    free(outmaskindex);
+    linARfilterPred_runs_free(&inruns);
+    linARfilterPred_runs_free(&outruns);
     free(OLRMS2res);
     free(OLRMS2avedt);
+    free(PFpredring);
+    free(moninprev);
+    free(lathist);
+    free(PFmatloc);
+    free(PFfrac);
 
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
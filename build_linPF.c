@@ -7,11 +7,30 @@
 
 #include <math.h>
 #include <time.h>
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "CommandLineInterface/CLIcore.h"
 #include "CommandLineInterface/timeutils.h"
 #include "COREMOD_iofits/COREMOD_iofits.h"
 
+#include "linPF_arena.h"
+#include "linPF_gram.h"
+#include "linPF_groupsel.h"
+#include "linPF_local.h"
+#include "linPF_monitor.h"
+#include "linPF_orderscan.h"
+#include "linPF_plan.h"
+#include "linPF_sched.h"
+#include "linPF_sparse.h"
+#include "linPF_subspace.h"
+#include "linPF_timing.h"
+#include "linPF_tsqr.h"
+#include "linPF_valid.h"
+
 
 #ifdef HAVE_CUDA
 #include "cudacomp/cudacomp.h"
@@ -43,6 +62,169 @@ static long      fpi_out3Dwrite;
 static int32_t *GPUdevice;
 static long     fpi_GPUdevice;
 
+static uint64_t *DCmode;
+static long      fpi_DCmode;
+
+static uint32_t *solver;
+static long      fpi_solver;
+
+static uint32_t *SVDwarmrank;
+static long      fpi_SVDwarmrank;
+
+static uint32_t *SVDwarmNBsweep;
+static long      fpi_SVDwarmNBsweep;
+
+static uint32_t *SVDwarmNBsweepinit;
+static long      fpi_SVDwarmNBsweepinit;
+
+static uint32_t *TSQRblocksize;
+static long      fpi_TSQRblocksize;
+
+static uint32_t *sparsemaxgroups;
+static long      fpi_sparsemaxgroups;
+
+static float *sparsetol;
+static long   fpi_sparsetol;
+
+static uint64_t *sparsennz;
+static long      fpi_sparsennz;
+
+static uint64_t *arenahugepage;
+static long      fpi_arenahugepage;
+
+static float *arenasizeMB;
+static long   fpi_arenasizeMB;
+
+static uint32_t *schedNBthread;
+static long      fpi_schedNBthread;
+
+static char *schedcpuset;
+
+static uint32_t *schedtile;
+static long      fpi_schedtile;
+
+static uint64_t *planauto;
+static long      fpi_planauto;
+
+static float *planbudgetGB;
+static long   fpi_planbudgetGB;
+
+static float *planGFLOPS;
+static long   fpi_planGFLOPS;
+
+static int32_t *planstrategy;
+static long     fpi_planstrategy;
+
+static float *planSVDmemGB;
+static long   fpi_planSVDmemGB;
+
+static float *planSVDtsec;
+static long   fpi_planSVDtsec;
+
+static float *planGrammemGB;
+static long   fpi_planGrammemGB;
+
+static float *planGramtsec;
+static long   fpi_planGramtsec;
+
+static float *planSVDwarmmemGB;
+static long   fpi_planSVDwarmmemGB;
+
+static float *planSVDwarmtsec;
+static long   fpi_planSVDwarmtsec;
+
+static float *planTSQRmemGB;
+static long   fpi_planTSQRmemGB;
+
+static float *planTSQRtsec;
+static long   fpi_planTSQRtsec;
+
+static float *planOOCmemGB;
+static long   fpi_planOOCmemGB;
+
+static float *planOOCtsec;
+static long   fpi_planOOCtsec;
+
+static char *validmask;
+
+static char *segments;
+
+static uint64_t *NBsamplevalid;
+static long      fpi_NBsamplevalid;
+
+static float *localradius;
+static long   fpi_localradius;
+
+static char *localstencil;
+
+static char *ordermap;
+
+static uint64_t *orderscan;
+static long      fpi_orderscan;
+
+static uint32_t *orderscanNBfold;
+static long      fpi_orderscanNBfold;
+
+static float *orderscankneetol;
+static long   fpi_orderscankneetol;
+
+static uint32_t *orderscanorder;
+static long      fpi_orderscanorder;
+
+static uint64_t *monitor;
+static long      fpi_monitor;
+
+static char *monitorresstream;
+
+static float *monitormargin;
+static long   fpi_monitormargin;
+
+static float *monitormaxage;
+static long   fpi_monitormaxage;
+
+static uint32_t *monitorNBsample;
+static long      fpi_monitorNBsample;
+
+static double *monitorexpres;
+static long    fpi_monitorexpres;
+
+static double *monitormeasres;
+static long    fpi_monitormeasres;
+
+static uint64_t *monitorNBskip;
+static long      fpi_monitorNBskip;
+
+static uint64_t *scoreenable;
+static long      fpi_scoreenable;
+
+static float *scorefrac;
+static long   fpi_scorefrac;
+
+static uint64_t *scorerefuse;
+static long      fpi_scorerefuse;
+
+static double *scoreold;
+static long    fpi_scoreold;
+
+static double *scorenew;
+static long    fpi_scorenew;
+
+static double *scoremix;
+static long    fpi_scoremix;
+
+static uint64_t *scoreNBrefused;
+static long      fpi_scoreNBrefused;
+
+// time of each build stage, see linPF_timing.h
+static float *timingtsec[LINPF_NBSTAGE];
+static long   fpi_timingtsec[LINPF_NBSTAGE];
+
+static float *timingMBmoved;
+static long   fpi_timingMBmoved;
+
+static float *timingpeakMB;
+static long   fpi_timingpeakMB;
+
 
 
 
@@ -133,6 +315,627 @@ static CLICMDARGDEF farg[] =
         CLIARG_HIDDEN_DEFAULT,
         (void **) &GPUdevice,
         &fpi_GPUdevice
+    },
+    {
+        // remove time-averaged value of each input and output variable
+        CLIARG_ONOFF,
+        ".DCmode",
+        "remove average",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &DCmode,
+        &fpi_DCmode
+    },
+    {
+        // 0: SVD of data matrix, 1: normal equations (Gram matrix)
+        // 2: warm-started subspace iteration, 3: tall-skinny QR
+        // 4: group-sparse (greedy input selection per output)
+        CLIARG_UINT32,
+        ".solver",
+        "solver (0:SVD 1:Gram 2:SVDwarm 3:TSQR 4:sparse)",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &solver,
+        &fpi_solver
+    },
+    {
+        // number of singular vectors tracked by subspace iteration
+        CLIARG_UINT32,
+        ".SVDwarm.rank",
+        "subspace rank",
+        "100",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &SVDwarmrank,
+        &fpi_SVDwarmrank
+    },
+    {
+        CLIARG_UINT32,
+        ".SVDwarm.NBsweep",
+        "sweeps per iteration",
+        "2",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &SVDwarmNBsweep,
+        &fpi_SVDwarmNBsweep
+    },
+    {
+        CLIARG_UINT32,
+        ".SVDwarm.NBsweepinit",
+        "sweeps on first iteration",
+        "20",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &SVDwarmNBsweepinit,
+        &fpi_SVDwarmNBsweepinit
+    },
+    {
+        // number of samples per TSQR row block
+        CLIARG_UINT32,
+        ".TSQR.blocksize",
+        "TSQR row block size",
+        "4096",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &TSQRblocksize,
+        &fpi_TSQRblocksize
+    },
+    {
+        // maximum number of input modes per output (sparse solver)
+        CLIARG_UINT32,
+        ".sparse.maxgroups",
+        "max number of inputs per output",
+        "10",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &sparsemaxgroups,
+        &fpi_sparsemaxgroups
+    },
+    {
+        // input is only added if residual decreases by more than tol
+        CLIARG_FLOAT32,
+        ".sparse.tol",
+        "min relative residual reduction",
+        "0.01",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &sparsetol,
+        &fpi_sparsetol
+    },
+    {
+        CLIARG_UINT64,
+        ".sparse.nnz",
+        "number of sparse filter coefficients",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &sparsennz,
+        &fpi_sparsennz
+    },
+    {
+        // back workspace arena with huge pages if available
+        CLIARG_ONOFF,
+        ".arena.hugepage",
+        "huge page workspace",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &arenahugepage,
+        &fpi_arenahugepage
+    },
+    {
+        CLIARG_FLOAT32,
+        ".arena.sizeMB",
+        "workspace size [MB]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &arenasizeMB,
+        &fpi_arenasizeMB
+    },
+    {
+        // 0: OpenMP default, or one worker per CPU of .sched.cpuset
+        CLIARG_UINT32,
+        ".sched.NBthread",
+        "number of worker threads",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &schedNBthread,
+        &fpi_schedNBthread
+    },
+    {
+        // worker i is pinned to i-th CPU of list, e.g. "0-3,8"
+        CLIARG_STR,
+        ".sched.cpuset",
+        "worker CPU list",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &schedcpuset,
+        NULL
+    },
+    {
+        // rows or output modes per task
+        CLIARG_UINT32,
+        ".sched.tile",
+        "tile size",
+        "32",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &schedtile,
+        &fpi_schedtile
+    },
+    {
+        // set .solver to fastest strategy fitting memory budget
+        CLIARG_ONOFF,
+        ".plan.auto",
+        "automatic solver selection",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &planauto,
+        &fpi_planauto
+    },
+    {
+        // 0: use physical memory size
+        CLIARG_FLOAT32,
+        ".plan.budgetGB",
+        "memory budget [GB]",
+        "0.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &planbudgetGB,
+        &fpi_planbudgetGB
+    },
+    {
+        // sustained computing rate assumed for runtime estimates
+        CLIARG_FLOAT32,
+        ".plan.GFLOPS",
+        "computing rate [GFLOP/s]",
+        "10.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &planGFLOPS,
+        &fpi_planGFLOPS
+    },
+    {
+        // 0:SVD 1:Gram 2:SVDwarm 3:TSQR 5:out-of-core (mkPFooc), -1:none
+        CLIARG_INT32,
+        ".plan.strategy",
+        "fastest strategy fitting memory budget",
+        "-1",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planstrategy,
+        &fpi_planstrategy
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.SVD.memGB",
+        "SVD peak memory [GB]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planSVDmemGB,
+        &fpi_planSVDmemGB
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.SVD.tsec",
+        "SVD runtime [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planSVDtsec,
+        &fpi_planSVDtsec
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.Gram.memGB",
+        "Gram peak memory [GB]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planGrammemGB,
+        &fpi_planGrammemGB
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.Gram.tsec",
+        "Gram runtime [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planGramtsec,
+        &fpi_planGramtsec
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.SVDwarm.memGB",
+        "SVDwarm peak memory [GB]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planSVDwarmmemGB,
+        &fpi_planSVDwarmmemGB
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.SVDwarm.tsec",
+        "SVDwarm runtime [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planSVDwarmtsec,
+        &fpi_planSVDwarmtsec
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.TSQR.memGB",
+        "TSQR peak memory [GB]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planTSQRmemGB,
+        &fpi_planTSQRmemGB
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.TSQR.tsec",
+        "TSQR runtime [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planTSQRtsec,
+        &fpi_planTSQRtsec
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.OOC.memGB",
+        "out-of-core peak memory [GB]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planOOCmemGB,
+        &fpi_planOOCmemGB
+    },
+    {
+        CLIARG_FLOAT32,
+        ".plan.OOC.tsec",
+        "out-of-core runtime [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &planOOCtsec,
+        &fpi_planOOCtsec
+    },
+    {
+        // per-frame validity, frame is used if value > 0.5
+        CLIARG_STR,
+        ".validmask",
+        "frame validity mask image",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &validmask,
+        NULL
+    },
+    {
+        // list of valid frame ranges, end excluded
+        CLIARG_STR,
+        ".segments",
+        "valid segments start:end,start:end",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &segments,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".NBsamplevalid",
+        "number of valid training samples",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBsamplevalid,
+        &fpi_NBsamplevalid
+    },
+    {
+        // local filter: only use input pixels within radius of output pixel
+        CLIARG_FLOAT32,
+        ".local.radius",
+        "local PF radius [pix], 0 for global PF",
+        "0.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &localradius,
+        &fpi_localradius
+    },
+    {
+        // local filter: explicit neighbourhood, centered on output pixel
+        CLIARG_STR,
+        ".local.stencil",
+        "local PF stencil image",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &localstencil,
+        NULL
+    },
+    {
+        // per-input filter order, input geometry, clamped to PForder
+        CLIARG_STR,
+        ".ordermap",
+        "per-mode filter order image",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &ordermap,
+        NULL
+    },
+    {
+        // select filter order (up to PForder) by cross-validation
+        CLIARG_ONOFF,
+        ".orderscan.enable",
+        "select order by cross-validation",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &orderscan,
+        &fpi_orderscan
+    },
+    {
+        CLIARG_UINT32,
+        ".orderscan.NBfold",
+        "number of cross-validation time segments",
+        "4",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &orderscanNBfold,
+        &fpi_orderscanNBfold
+    },
+    {
+        // knee: smallest order with error < (1+kneetol) x minimum error
+        CLIARG_FLOAT32,
+        ".orderscan.kneetol",
+        "relative error tolerance for knee",
+        "0.02",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &orderscankneetol,
+        &fpi_orderscankneetol
+    },
+    {
+        CLIARG_UINT32,
+        ".orderscan.order",
+        "selected filter order",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &orderscanorder,
+        &fpi_orderscanorder
+    },
+    {
+        // only rebuild filter when measured prediction residual degrades
+        CLIARG_ONOFF,
+        ".monitor.enable",
+        "rebuild on prediction degradation",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &monitor,
+        &fpi_monitor
+    },
+    {
+        // residual stream written by applyPF: <outdata>_PFres
+        CLIARG_STR,
+        ".monitor.resstream",
+        "measured residual stream",
+        "outPF_PFres",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &monitorresstream,
+        NULL
+    },
+    {
+        CLIARG_FLOAT32,
+        ".monitor.margin",
+        "rebuild if measured > margin x expected residual",
+        "1.2",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &monitormargin,
+        &fpi_monitormargin
+    },
+    {
+        CLIARG_FLOAT32,
+        ".monitor.maxage",
+        "rebuild if filter older than maxage [s]",
+        "60.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &monitormaxage,
+        &fpi_monitormaxage
+    },
+    {
+        CLIARG_UINT32,
+        ".monitor.NBsample",
+        "number of samples for expected residual",
+        "1000",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &monitorNBsample,
+        &fpi_monitorNBsample
+    },
+    {
+        CLIARG_FLOAT64,
+        ".monitor.expres",
+        "expected residual",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &monitorexpres,
+        &fpi_monitorexpres
+    },
+    {
+        CLIARG_FLOAT64,
+        ".monitor.measres",
+        "measured residual",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &monitormeasres,
+        &fpi_monitormeasres
+    },
+    {
+        CLIARG_UINT64,
+        ".monitor.NBskip",
+        "number of skipped rebuilds",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &monitorNBskip,
+        &fpi_monitorNBskip
+    },
+    {
+        // score old, new and blended filters on held-out samples
+        CLIARG_ONOFF,
+        ".score.enable",
+        "score filters on held-out window",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &scoreenable,
+        &fpi_scoreenable
+    },
+    {
+        // last samples of telemetry, not used for training
+        CLIARG_FLOAT32,
+        ".score.frac",
+        "held-out fraction of samples",
+        "0.1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &scorefrac,
+        &fpi_scorefrac
+    },
+    {
+        CLIARG_ONOFF,
+        ".score.refuse",
+        "do not publish blend worse than current filter",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &scorerefuse,
+        &fpi_scorerefuse
+    },
+    {
+        CLIARG_FLOAT64,
+        ".score.old",
+        "held-out residual of current filter",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &scoreold,
+        &fpi_scoreold
+    },
+    {
+        CLIARG_FLOAT64,
+        ".score.new",
+        "held-out residual of new filter",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &scorenew,
+        &fpi_scorenew
+    },
+    {
+        CLIARG_FLOAT64,
+        ".score.mix",
+        "held-out residual of blended filter",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &scoremix,
+        &fpi_scoremix
+    },
+    {
+        CLIARG_UINT64,
+        ".score.NBrefused",
+        "number of refused filter updates",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &scoreNBrefused,
+        &fpi_scoreNBrefused
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.wait",
+        "wait time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_WAIT],
+        &fpi_timingtsec[LINPF_STAGE_WAIT]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.copy",
+        "copy and averages time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_COPY],
+        &fpi_timingtsec[LINPF_STAGE_COPY]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.DC",
+        "DC removal time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_DC],
+        &fpi_timingtsec[LINPF_STAGE_DC]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.fill",
+        "data matrix fill time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_FILL],
+        &fpi_timingtsec[LINPF_STAGE_FILL]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.factor",
+        "factorization and solve time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_FACTOR],
+        &fpi_timingtsec[LINPF_STAGE_FACTOR]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.assemble",
+        "filter assembly time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_ASSEMBLE],
+        &fpi_timingtsec[LINPF_STAGE_ASSEMBLE]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.score",
+        "held-out scoring time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_SCORE],
+        &fpi_timingtsec[LINPF_STAGE_SCORE]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.blend",
+        "filter blend time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_BLEND],
+        &fpi_timingtsec[LINPF_STAGE_BLEND]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.publish",
+        "publish time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_PUBLISH],
+        &fpi_timingtsec[LINPF_STAGE_PUBLISH]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.io",
+        "disk I/O time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_IO],
+        &fpi_timingtsec[LINPF_STAGE_IO]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.monitor",
+        "monitor time [s]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingtsec[LINPF_STAGE_MONITOR],
+        &fpi_timingtsec[LINPF_STAGE_MONITOR]
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.MBmoved",
+        "data moved in last iteration [MB]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingMBmoved,
+        &fpi_timingMBmoved
+    },
+    {
+        CLIARG_FLOAT32,
+        ".timing.peakMB",
+        "peak resident memory [MB]",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &timingpeakMB,
+        &fpi_timingpeakMB
     }
 };
 
@@ -151,6 +954,17 @@ static errno_t customCONFsetup()
         data.fpsptr->parray[fpi_reglambda].fpflag |= FPFLAG_WRITERUN;
         data.fpsptr->parray[fpi_loopgain].fpflag |= FPFLAG_WRITERUN;
         data.fpsptr->parray[fpi_out3Dwrite].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_DCmode].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_SVDwarmNBsweep].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_sparsemaxgroups].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_sparsetol].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_orderscan].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_orderscanNBfold].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_orderscankneetol].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_monitor].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_monitormargin].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_monitormaxage].fpflag |= FPFLAG_WRITERUN;
+        data.fpsptr->parray[fpi_scorerefuse].fpflag |= FPFLAG_WRITERUN;
     }
 
     return RETURN_SUCCESS;
@@ -159,11 +973,108 @@ static errno_t customCONFsetup()
 // Optional custom configuration checks.
 // Runs at every configuration check loop iteration
 //
+static long mask_count(imageID IDmask, uint64_t xysize);
+
 static errno_t customCONFcheck()
 {
 
     if(data.fpsptr != NULL)
     {
+        /// Peak memory and runtime of build strategies are estimated from
+        /// the input telemetry and mask sizes, see linPF_plan.c
+        imageID IDin = image_ID(inname);
+        if((IDin != -1) && (data.image[IDin].md->naxis > 1))
+        {
+            int      naxis  = data.image[IDin].md->naxis;
+            uint64_t xysize = data.image[IDin].md->size[0];
+            if(naxis == 3)
+            {
+                xysize *= data.image[IDin].md->size[1];
+            }
+
+            LINARFILTERPRED_PLANSIZE ps;
+            ps.nbspl     = data.image[IDin].md->size[naxis - 1];
+            ps.xysize    = xysize;
+            ps.NBpixin   = mask_count(image_ID("inmask"), xysize);
+            ps.NBpixout  = mask_count(image_ID("outmask"), xysize);
+            ps.PForder   = *PForder;
+            ps.NBmvec    = ps.nbspl - *PForder - (int)(*PFlatency) - 2;
+            ps.rank      = *SVDwarmrank;
+            ps.NBsweep   = *SVDwarmNBsweep;
+            ps.blocksize = *TSQRblocksize;
+            ps.chunksize = 10000; // mkPFooc default
+            ps.NBthread  = 1;
+#ifdef _OPENMP
+            ps.NBthread = omp_get_max_threads();
+#endif
+            if(*schedNBthread > 0)
+            {
+                ps.NBthread = *schedNBthread;
+            }
+            ps.GFLOPS = (*planGFLOPS > 0.0) ? *planGFLOPS : 1.0;
+
+            double budgetGB = *planbudgetGB;
+            if(budgetGB <= 0.0)
+            {
+                budgetGB = 1.0 * sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) /
+                           1024.0 / 1024.0 / 1024.0;
+            }
+
+            int strategylist[5] = {LINPF_PLAN_SVD,
+                                   LINPF_PLAN_GRAM,
+                                   LINPF_PLAN_SVDWARM,
+                                   LINPF_PLAN_TSQR,
+                                   LINPF_PLAN_OOC
+                                  };
+            double memGB[5];
+            double tsec[5];
+
+            int strategy = -1;
+            if(ps.NBmvec > 0)
+            {
+                strategy = linARfilterPred_plan_select(&ps,
+                                                       strategylist,
+                                                       5,
+                                                       budgetGB,
+                                                       memGB,
+                                                       tsec);
+                *planSVDmemGB     = memGB[0];
+                *planSVDtsec      = tsec[0];
+                *planGrammemGB    = memGB[1];
+                *planGramtsec     = tsec[1];
+                *planSVDwarmmemGB = memGB[2];
+                *planSVDwarmtsec  = tsec[2];
+                *planTSQRmemGB    = memGB[3];
+                *planTSQRtsec     = tsec[3];
+                *planOOCmemGB     = memGB[4];
+                *planOOCtsec      = tsec[4];
+            }
+
+            static int strategyprev = -2;
+            if(strategy != strategyprev)
+            {
+                if(strategy == -1)
+                {
+                    printf("No build strategy fits memory budget %.2f GB\n",
+                           budgetGB);
+                }
+                else if(strategy == LINPF_PLAN_OOC)
+                {
+                    printf("Only out-of-core build fits memory budget %.2f GB,"
+                           " use mkPFooc\n",
+                           budgetGB);
+                }
+                strategyprev = strategy;
+            }
+            *planstrategy = strategy;
+
+            // sparse solver is a different filter model, left unchanged
+            if((*planauto == 1) && (strategy >= 0) &&
+                    (strategy != LINPF_PLAN_OOC) && (*solver != 4))
+            {
+                *solver = strategy;
+            }
+        }
     }
 
     return RETURN_SUCCESS;
@@ -188,12 +1099,216 @@ static errno_t help_function()
 
 
 
-static errno_t compute_function()
+/** @brief Workspace arrays of mkPF, carved out of a single arena
+ */
+typedef struct
 {
-    DEBUG_TRACE_FSTART();
+    long                         *pixarray_x;     ///< NBpixin
+    long                         *pixarray_y;     ///< NBpixin
+    long                         *pixarray_xy;    ///< NBpixin
+    double                       *ave_inarray;    ///< NBpixin
+    long                         *outpixarray_x;  ///< NBpixout
+    long                         *outpixarray_y;  ///< NBpixout
+    long                         *outpixarray_xy; ///< NBpixout
+    double                       *ave_outarray;   ///< NBpixout
+    uint8_t                      *framevalid;     ///< nbspl
+    long                         *NBinvalid;      ///< nbspl + 1
+    uint8_t                      *samplevalid;    ///< NBmvec
+    long                         *colmap;         ///< mvecsize
+    float                        *PFmatr;         ///< NBpixout x mvecsize
+    float                        *xvec;           ///< mvecsize (monitor, scoring)
+    double                       *Wgram;          ///< NBpixout x mvecsize (solver 1, 4)
+    double                       *solvebuf;       ///< solve of mvecsize (solver 1)
+    long                         *group;          ///< mvecsize (solver 4)
+    LINARFILTERPRED_GRAM          gram;           ///< mvecsize x NBpixout (solver 1, 4)
+    LINARFILTERPRED_GRAM          gramscore;      ///< mvecsize x NBpixout (held-out)
+    uint8_t                      *scorevalid;     ///< NBmvec (held-out)
+    double                       *localwork;      ///< NBthread slices (local mode)
+    LINARFILTERPRED_ORDERSCAN_WS  orderscan;      ///< NBfold = 0 if not carved
+
+    // gsl eigen workspaces, allocated after carving, NULL if not used
+    gsl_eigen_symmv_workspace   **solveeig;       ///< ndesign (solver 1)
+    gsl_eigen_symmv_workspace   **localeig;       ///< NBthread x NBlocaleig
+    long                          NBlocaleig;     ///< localqmax / PForder
+    gsl_eigen_symmv_workspace   **orderscaneig;   ///< PForder (order scan)
+} BUILD_WORKSPACE;
+
+
+
+
+/**
+ * @brief Number of active pixels in mask image, xysize if no mask
+ */
+static long mask_count(imageID IDmask, uint64_t xysize)
+{
+    if(IDmask == -1)
+    {
+        return xysize;
+    }
+
+    long cnt = 0;
+    for(uint64_t ii = 0; ii < xysize; ii++)
+        if(data.image[IDmask].array.F[ii] > 0.5)
+        {
+            cnt++;
+        }
+    return cnt;
+}
+
+
+
+
+/**
+ * @brief Carve workspace arrays out of arena
+ *
+ * Called first on a sizing arena to measure the exact footprint, then on
+ * the allocated arena.
+ *
+ * Local mode work buffers are carved if localqmax > 0, for NBthread
+ * threads and local filters of up to localqmax coefficients.
+ * The order scan workspace is carved if orderscanNBfold > 0.
+ */
+static void build_workspace_carve(LINARFILTERPRED_ARENA *arena,
+                                  BUILD_WORKSPACE       *ws,
+                                  uint32_t               nbspl,
+                                  long                   NBpixin,
+                                  long                   NBpixout,
+                                  long                   PForder,
+                                  long                   NBmvec,
+                                  long                   mvecsize,
+                                  uint32_t               solvermode,
+                                  int                    scoremode,
+                                  long                   localqmax,
+                                  int                    NBthread,
+                                  long                   orderscanNBfold)
+{
+    ws->pixarray_x  = linARfilterPred_arena_alloc(arena, sizeof(long) * NBpixin);
+    ws->pixarray_y  = linARfilterPred_arena_alloc(arena, sizeof(long) * NBpixin);
+    ws->pixarray_xy = linARfilterPred_arena_alloc(arena, sizeof(long) * NBpixin);
+    ws->ave_inarray =
+        linARfilterPred_arena_alloc(arena, sizeof(double) * NBpixin);
+
+    ws->outpixarray_x =
+        linARfilterPred_arena_alloc(arena, sizeof(long) * NBpixout);
+    ws->outpixarray_y =
+        linARfilterPred_arena_alloc(arena, sizeof(long) * NBpixout);
+    ws->outpixarray_xy =
+        linARfilterPred_arena_alloc(arena, sizeof(long) * NBpixout);
+    ws->ave_outarray =
+        linARfilterPred_arena_alloc(arena, sizeof(double) * NBpixout);
+
+    ws->framevalid  = linARfilterPred_arena_alloc(arena, sizeof(uint8_t) * nbspl);
+    ws->NBinvalid   =
+        linARfilterPred_arena_alloc(arena, sizeof(long) * (nbspl + 1));
+    ws->samplevalid = linARfilterPred_arena_alloc(arena, sizeof(uint8_t) * NBmvec);
+
+    ws->colmap = linARfilterPred_arena_alloc(arena, sizeof(long) * mvecsize);
+    ws->PFmatr =
+        linARfilterPred_arena_alloc(arena, sizeof(float) * NBpixout * mvecsize);
+    ws->xvec = linARfilterPred_arena_alloc(arena, sizeof(float) * mvecsize);
+
+    ws->Wgram     = NULL;
+    ws->solvebuf  = NULL;
+    ws->group     = NULL;
+    ws->gram.G    = NULL;
+    if((solvermode == 1) || (solvermode == 4))
+    {
+        ws->Wgram = linARfilterPred_arena_alloc(arena,
+                                                sizeof(double) * NBpixout * mvecsize);
+        double *grambuf = linARfilterPred_arena_alloc(arena,
+                          sizeof(double) *
+                          linARfilterPred_gram_bufsize(mvecsize, NBpixout));
+        if(grambuf != NULL)
+        {
+            linARfilterPred_gram_init_buffer(&ws->gram,
+                                             mvecsize,
+                                             NBpixout,
+                                             grambuf);
+        }
+    }
+    if(solvermode == 1)
+    {
+        ws->solvebuf = linARfilterPred_arena_alloc(arena,
+                       sizeof(double) *
+                       linARfilterPred_gram_solve_bufsize(mvecsize));
+    }
+    if(solvermode == 4)
+    {
+        ws->group = linARfilterPred_arena_alloc(arena, sizeof(long) * mvecsize);
+    }
+    ws->gramscore.G = NULL;
+    ws->scorevalid  = NULL;
+    if(scoremode == 1)
+    {
+        ws->scorevalid =
+            linARfilterPred_arena_alloc(arena, sizeof(uint8_t) * NBmvec);
+        double *grambuf = linARfilterPred_arena_alloc(arena,
+                          sizeof(double) *
+                          linARfilterPred_gram_bufsize(mvecsize, NBpixout));
+        if(grambuf != NULL)
+        {
+            linARfilterPred_gram_init_buffer(&ws->gramscore,
+                                             mvecsize,
+                                             NBpixout,
+                                             grambuf);
+        }
+    }
+
+    ws->localwork = NULL;
+    if(localqmax > 0)
+    {
+        ws->localwork = linARfilterPred_arena_alloc(arena,
+                        sizeof(double) * NBthread *
+                        linARfilterPred_local_worksize(localqmax, NBmvec));
+    }
+
+    ws->solveeig     = NULL;
+    ws->localeig     = NULL;
+    ws->NBlocaleig   = 0;
+    ws->orderscaneig = NULL;
+
+    ws->orderscan.NBfold = 0;
+    if(orderscanNBfold > 0)
+    {
+        linARfilterPred_orderscan_carve(arena,
+                                        &ws->orderscan,
+                                        NBpixin,
+                                        NBpixout,
+                                        PForder,
+                                        orderscanNBfold);
+    }
+}
 
 
-    int DC_MODE = 0; // 1 if average value of each mode is removed
+
+
+/**
+ * @brief Expand filter over kept columns to 2D filter layout
+ *
+ * Wr is NBpixout x ndesign, column c of Wr is column colmap[c] of W.
+ * Coefficients of missing taps are zero.
+ */
+static void ordermap_expand(const float *Wr,
+                            long         NBpixout,
+                            long         ndesign,
+                            const long  *colmap,
+                            long         mvecsize,
+                            float       *W)
+{
+    memset(W, 0, sizeof(float) * NBpixout * mvecsize);
+    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+        for(long c = 0; c < ndesign; c++)
+        {
+            W[PFpix * mvecsize + colmap[c]] = Wr[PFpix * ndesign + c];
+        }
+}
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
 
 
     // connect to input telemetry
@@ -261,39 +1376,120 @@ static errno_t compute_function()
     printf("xysize = %lu\n", xysize);
 
 
-    /// Once input telemetry size measured, arrays are created:
-    /// - pixarray_x  : x coordinate of each variable (useful to keep track of spatial coordinates)
-    /// - pixarray_y  : y coordinate of each variable (useful to keep track of spatial coordinates)
-    /// - pixarray_xy : combined index (avoids re-computing index frequently)
-    /// - ave_inarray : time averaged value, useful because the predictive filter often needs average to be zero, so we will remove it
+    /// ## Workspace
+    ///
+    /// Input and output variables are selected by the optional images
+    /// "inmask" and "outmask" (see below). They are counted first, so that
+    /// all workspace arrays can be sized exactly and carved out of a single
+    /// arena, allocated once before the compute loop, see linPF_arena.c.\n
+    /// The gsl eigen workspaces of Gram solves are allocated once, after
+    /// carving. Iterations of the Gram solver (1), held-out scoring,
+    /// local mode, order scan and monitor residual then do not allocate
+    /// memory.
+    /// Loop iterations still allocate in :
+    /// - the SVD solvers (0, 2), in linopt_imtools / cudacomp and
+    ///   linPF_subspace.c
+    /// - the TSQR solver (3) and group selection (4)
+    /// - the order scan, on the first iteration after it is enabled at
+    ///   runtime or after .orderscan.NBfold is changed
+    /// - the first publication of the timing stream
+
+    imageID IDinmask  = image_ID("inmask");
+    imageID IDoutmask = image_ID("outmask");
+    long    NBpixin   = mask_count(IDinmask, xysize);
+    long    NBpixout  = mask_count(IDoutmask, xysize);
 
-    long *pixarray_x = (long *) malloc(sizeof(long) * xsize * ysize);
-    if(pixarray_x == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
 
-    long *pixarray_y = (long *) malloc(sizeof(long) * xsize * ysize);
-    if(pixarray_y == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
+    /// ## Build Empty Data Matrix
+    ///
+    /// Note: column / row description follows FITS file viewing conventions.\n
+    /// The data matrix is build from the telemetry. Each column (= time sample) of the
+    /// data matrix consists of consecutives columns (= time sample) of the input telemetry.\n
+    ///
+    /// Variable naming:
+    /// - NBmvec is the number of telemetry vectors (each corresponding to a different time) in the data matrix.
+    /// - mvecsize is the size of each vector, equal to NBpixin times PForder
+    ///
+    /// Data matrix is stored as image of size NBmvec x mvecsize, to be fed to routine compute_SVDpseudoInverse in linopt_imtools (CPU mode) or in cudacomp (GPU mode)\n
+    ///
+    long NBmvec =
+        nbspl - *PForder - (int)(*PFlatency) -
+        2; // could put "-1", but "-2" allows user to change PFlag_run by up to 1 frame without reading out of array
+    long mvecsize =
+        NBpixin *
+        *PForder; // size of each sample vector for AR filter, excluding regularization
 
-    long *pixarray_xy = (long *) malloc(sizeof(long) * xsize * ysize);
-    if(pixarray_xy == NULL)
+    // Local mode work buffers are sized from the neighbourhood size,
+    // known before the neighbourhood lists are built (see below)
+    imageID IDstencil = image_ID(localstencil);
+    long    localqmax = 0;
+    int     NBthread  = 1;
+#ifdef _OPENMP
+    NBthread = omp_get_max_threads();
+#endif
+    if((*localradius > 0.0) || (IDstencil != -1))
     {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
+        localqmax = linARfilterPred_local_nboffset(*localradius, IDstencil);
+        if(localqmax > NBpixin)
+        {
+            localqmax = NBpixin;
+        }
+        localqmax *= *PForder;
     }
 
-    double *ave_inarray = (double *) malloc(sizeof(double) * xsize * ysize);
-    if(ave_inarray == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
+    BUILD_WORKSPACE       ws;
+    LINARFILTERPRED_ARENA arena;
+    linARfilterPred_arena_init(&arena, 0, 0); // sizing pass
+    build_workspace_carve(&arena,
+                          &ws,
+                          nbspl,
+                          NBpixin,
+                          NBpixout,
+                          *PForder,
+                          NBmvec,
+                          mvecsize,
+                          *solver,
+                          (int) *scoreenable,
+                          localqmax,
+                          NBthread,
+                          (*orderscan == 1) ? *orderscanNBfold : 0);
+    size_t arenasize = arena.offset;
+    linARfilterPred_arena_init(&arena, arenasize, *arenahugepage);
+    build_workspace_carve(&arena,
+                          &ws,
+                          nbspl,
+                          NBpixin,
+                          NBpixout,
+                          *PForder,
+                          NBmvec,
+                          mvecsize,
+                          *solver,
+                          (int) *scoreenable,
+                          localqmax,
+                          NBthread,
+                          (*orderscan == 1) ? *orderscanNBfold : 0);
+    *arenasizeMB = 1.0 * arenasize / 1024 / 1024;
+    printf("Workspace : %.3f MB%s\n",
+           *arenasizeMB,
+           (arena.hugepage == 1) ? " (huge pages)" : "");
+
+    /// Build stages are split into tiles of .sched.tile rows or output
+    /// modes, run as tasks by pinned worker threads, see linPF_sched.c.
+    int  NBworker = linARfilterPred_sched_init(*schedNBthread, schedcpuset);
+    long tile     = (*schedtile > 0) ? *schedtile : 1;
+    printf("Workers   : %d, tile %ld\n", NBworker, tile);
+
+
+    /// Once input telemetry size measured, arrays are set up:
+    /// - pixarray_x  : x coordinate of each variable (useful to keep track of spatial coordinates)
+    /// - pixarray_y  : y coordinate of each variable (useful to keep track of spatial coordinates)
+    /// - pixarray_xy : combined index (avoids re-computing index frequently)
+    /// - ave_inarray : time averaged value, useful because the predictive filter often needs average to be zero, so we will remove it
+
+    long   *pixarray_x  = ws.pixarray_x;
+    long   *pixarray_y  = ws.pixarray_y;
+    long   *pixarray_xy = ws.pixarray_xy;
+    double *ave_inarray = ws.ave_inarray;
 
 
     /// ### Select input variables from mask (optional)
@@ -301,8 +1497,7 @@ static errno_t compute_function()
     /// Otherwise, all variables are active\n
     /// The number of active input variables is stored in NBpixin.
 
-    imageID IDinmask = image_ID("inmask");
-    long    NBpixin  = 0;
+    NBpixin = 0;
     if(IDinmask == -1)
     {
         for(uint32_t ii = 0; ii < xsize; ii++)
@@ -337,34 +1532,16 @@ static errno_t compute_function()
     /// With inmask and outmask, input AND output variables can be
     /// selected amond the telemetry.
 
-    /// Arrays are created:
+    /// Arrays are set up:
     /// - outpixarray_x  : x coordinate of each output variable (useful to keep track of spatial coordinates)
     /// - outpixarray_y  : y coordinate of each output variable (useful to keep track of spatial coordinates)
     /// - outpixarray_xy : combined output index (avoids re-computing index frequently)
 
-    long *outpixarray_x = (long *) malloc(sizeof(long) * xsize * ysize);
-    if(outpixarray_x == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
+    long *outpixarray_x  = ws.outpixarray_x;
+    long *outpixarray_y  = ws.outpixarray_y;
+    long *outpixarray_xy = ws.outpixarray_xy;
 
-    long *outpixarray_y = (long *) malloc(sizeof(long) * xsize * ysize);
-    if(outpixarray_y == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    long *outpixarray_xy = (long *) malloc(sizeof(long) * xsize * ysize);
-    if(outpixarray_xy == NULL)
-    {
-        PRINT_ERROR("malloc returns NULL pointer");
-        abort();
-    }
-
-    imageID IDoutmask = image_ID("outmask");
-    long    NBpixout  = 0;
+    NBpixout = 0;
     if(IDoutmask == -1)
     {
         for(uint32_t ii = 0; ii < xsize; ii++)
@@ -389,44 +1566,124 @@ static errno_t compute_function()
                 }
     }
 
+    /// - ave_outarray : time averaged value of each output variable
+    double *ave_outarray = ws.ave_outarray;
 
 
 
-    /// ## Build Empty Data Matrix
-    ///
-    /// Note: column / row description follows FITS file viewing conventions.\n
-    /// The data matrix is build from the telemetry. Each column (= time sample) of the
-    /// data matrix consists of consecutives columns (= time sample) of the input telemetry.\n
-    ///
-    /// Variable naming:
-    /// - NBmvec is the number of telemetry vectors (each corresponding to a different time) in the data matrix.
-    /// - mvecsize is the size of each vector, equal to NBpixin times PForder
-    ///
-    /// Data matrix is stored as image of size NBmvec x mvecsize, to be fed to routine compute_SVDpseudoInverse in linopt_imtools (CPU mode) or in cudacomp (GPU mode)\n
-    ///
-    long NBmvec =
-        nbspl - *PForder - (int)(*PFlatency) -
-        2; // could put "-1", but "-2" allows user to change PFlag_run by up to 1 frame without reading out of array
-    long mvecsize =
-        NBpixin *
-        *PForder; // size of each sample vector for AR filter, excluding regularization
+    /// ## Local filter mode (optional)
+    /// If .local.radius is positive, or if the .local.stencil image exists,
+    /// each output pixel is predicted from the input pixels within its
+    /// neighbourhood only. The filter is then written in sparse (CSR)
+    /// format, see linPF_sparse.c, instead of the 2D filter matrix.
+
+    int       LOCALmode = 0;
+    uint32_t *nbrowptr  = NULL;
+    uint32_t *nbpix     = NULL;
+    long      NBlocalcoeff = 0;
+    if((*localradius > 0.0) || (IDstencil != -1))
+    {
+        LOCALmode = 1;
+
+        nbrowptr = (uint32_t *) malloc(sizeof(uint32_t) * (NBpixout + 1));
+        if(nbrowptr == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+
+        long NBnb = linARfilterPred_local_neighbours(xsize,
+                    ysize,
+                    NBpixin,
+                    pixarray_x,
+                    pixarray_y,
+                    NBpixout,
+                    outpixarray_x,
+                    outpixarray_y,
+                    *localradius,
+                    IDstencil,
+                    nbrowptr,
+                    &nbpix);
+        NBlocalcoeff = NBnb * (*PForder);
+        printf("LOCAL MODE: %ld neighbours -> %ld coefficients\n",
+               NBnb,
+               NBlocalcoeff);
+    }
+
+
+
+
+    /// ## Per-mode filter order (optional)
+    /// If the .ordermap image exists, input pixel pix only uses time steps
+    /// dt < ordermap(pix), so that low-order modes keep long histories
+    /// while nearly white modes only use one or two taps.\n
+    /// colmap lists the ndesign kept columns (dt*NBpixin+pix) of the
+    /// data matrix, all mvecsize columns otherwise. The filter is written
+    /// in 2D format with zero coefficients for missing taps, and also
+    /// in sparse (CSR) format <outPF>_sp*, with only the kept taps, for
+    /// applyPF and LINARFILTERPRED_PF_RealTimeApply.\n
+    /// The order map is not used in local mode, and takes precedence over
+    /// order selection (.orderscan).
+    long   *colmap       = ws.colmap;
+    imageID IDordermap   = image_ID(ordermap);
+    int     ORDERMAPmode = 0;
+    long    ndesign      = 0;
+    if((IDordermap != -1) && (LOCALmode == 0))
+    {
+        ndesign = linARfilterPred_sparse_ordermap(IDordermap,
+                  NBpixin,
+                  pixarray_xy,
+                  *PForder,
+                  colmap);
+        if(ndesign > 0)
+        {
+            ORDERMAPmode = 1;
+            printf("ORDER MAP: %ld / %ld coefficients per output\n",
+                   ndesign,
+                   mvecsize);
+        }
+        else
+        {
+            PRINT_WARNING("order map %s keeps no coefficient - ignored",
+                          ordermap);
+        }
+    }
+    if(ORDERMAPmode == 0)
+    {
+        ndesign = mvecsize;
+        for(long col = 0; col < mvecsize; col++)
+        {
+            colmap[col] = col;
+        }
+    }
+
+    /// Telemetry may consist of several valid segments (.segments, .validmask).
+    /// Samples are only used if all frames they span are valid, see linPF_valid.c
+    uint8_t *framevalid  = ws.framevalid;
+    uint8_t *samplevalid = ws.samplevalid;
+    imageID  IDvalidmask = image_ID(validmask);
 
     /// Regularization can be added to penalize strong coefficients in the predictive filter.
     /// It is optionally implemented by adding extra columns at the end of the data matrix.\n
     long    NBmvec1 = 0;
     imageID IDmatA  = -1;
     int     REG     = 0;
-    if(REG == 0)  // no regularization
+    if((LOCALmode == 1) || (*solver == 1) ||
+            (*solver == 3) || (*solver == 4))  // no global data matrix
+    {
+        NBmvec1 = NBmvec;
+    }
+    else if(REG == 0)  // no regularization
     {
         printf("NBmvec   = %ld  -> %ld \n", NBmvec, NBmvec);
         NBmvec1 = NBmvec;
-        create_2Dimage_ID("PFmatD", NBmvec, mvecsize, &IDmatA);
+        create_2Dimage_ID("PFmatD", NBmvec, ndesign, &IDmatA);
     }
     else // with regularization
     {
-        printf("NBmvec   = %ld  -> %ld \n", NBmvec, NBmvec + mvecsize);
-        NBmvec1 = NBmvec + mvecsize;
-        create_2Dimage_ID("PFmatD", NBmvec + mvecsize, mvecsize, &IDmatA);
+        printf("NBmvec   = %ld  -> %ld \n", NBmvec, NBmvec + ndesign);
+        NBmvec1 = NBmvec + ndesign;
+        create_2Dimage_ID("PFmatD", NBmvec + ndesign, ndesign, &IDmatA);
     }
 
 
@@ -450,8 +1707,11 @@ static errno_t compute_function()
 
 
     // Allocate future measured data matrix
-    imageID IDfm;
-    create_2Dimage_ID("PFfmdat", NBmvec, NBpixout, &IDfm);
+    imageID IDfm = -1;
+    if((LOCALmode == 0) && ((*solver == 0) || (*solver == 2)))
+    {
+        create_2Dimage_ID("PFfmdat", NBmvec, NBpixout, &IDfm);
+    }
 
 
     // Prepare output filter images
@@ -465,8 +1725,56 @@ static errno_t compute_function()
     // axis 0 [ii1] : input mode x time step
     // axis 1 [jj1] : output mode
 
-    imageID IDoutPF2Draw;
-    imageID IDoutPF2D;
+    imageID IDoutPF2Draw = -1;
+    imageID IDoutPF2D    = -1;
+    imageID IDoutPF2Dn   = -1; // new filter, before mixing
+    imageID IDsprow      = -1;
+    imageID IDspcol      = -1;
+    imageID IDspval      = -1;
+    imageID IDspvalraw   = -1;
+    if(LOCALmode == 1)
+    {
+        // Sparse filter: <outPF>_sp* (mixed) and <outPF>_raw_sp* (individual)
+        char IDoutPF_name_raw[STRINGMAXLEN_IMGNAME];
+        WRITE_IMAGENAME(IDoutPF_name_raw, "%s_raw", outPFname);
+
+        imageID IDsprowraw;
+        imageID IDspcolraw;
+        linARfilterPred_sparse_create(outPFname,
+                                      NBpixout,
+                                      NBlocalcoeff,
+                                      &IDsprow,
+                                      &IDspcol,
+                                      &IDspval);
+        linARfilterPred_sparse_create(IDoutPF_name_raw,
+                                      NBpixout,
+                                      NBlocalcoeff,
+                                      &IDsprowraw,
+                                      &IDspcolraw,
+                                      &IDspvalraw);
+
+        linARfilterPred_local_sparseindex(NBpixin,
+                                          NBpixout,
+                                          nbrowptr,
+                                          nbpix,
+                                          *PForder,
+                                          data.image[IDsprow].array.UI32,
+                                          data.image[IDspcol].array.UI32);
+        memcpy(data.image[IDsprowraw].array.UI32,
+               data.image[IDsprow].array.UI32,
+               sizeof(uint32_t) * (NBpixout + 1));
+        memcpy(data.image[IDspcolraw].array.UI32,
+               data.image[IDspcol].array.UI32,
+               sizeof(uint32_t) * NBlocalcoeff);
+
+        imageID IDsparray[4] = {IDsprow, IDspcol, IDsprowraw, IDspcolraw};
+        for(int i = 0; i < 4; i++)
+        {
+            COREMOD_MEMORY_image_set_sempost_byID(IDsparray[i], -1);
+            data.image[IDsparray[i]].md[0].cnt0++;
+        }
+    }
+    else
     {
         uint32_t *imsizearray = (uint32_t *) malloc(sizeof(uint32_t) * 2);
         if(imsizearray == NULL)
@@ -499,8 +1807,73 @@ static errno_t compute_function()
         free(imsizearray);
         COREMOD_MEMORY_image_set_semflush(outPFname, -1);
         COREMOD_MEMORY_image_set_semflush(IDoutPF_name_raw, -1);
+
+        IDoutPF2Dn = image_ID("psinvPFmat");
+        if(IDoutPF2Dn == -1)
+        {
+            create_2Dimage_ID("psinvPFmat",
+                              NBpixin * *PForder,
+                              NBpixout,
+                              &IDoutPF2Dn);
+        }
+
+        if((ORDERMAPmode == 1) || (*solver == 4))
+        {
+            // Packed filter <outPF>_sp* : non-zero coefficients only,
+            // written after each update of the 2D filter
+            linARfilterPred_sparse_create(outPFname,
+                                          NBpixout,
+                                          NBpixout * ndesign,
+                                          &IDsprow,
+                                          &IDspcol,
+                                          &IDspval);
+        }
+    }
+
+
+    // Order scan error curve <outPF>_orderscan, resolved once since the
+    // scan can be enabled at runtime. Its workspace is allocated in a
+    // separate arena if not carved at startup, see order scan step.
+    imageID               IDorderscan = -1;
+    LINARFILTERPRED_ARENA orderscanarena;
+    linARfilterPred_arena_init(&orderscanarena, 0, 0);
+    if((LOCALmode == 0) && (ORDERMAPmode == 0))
+    {
+        char imnameorderscan[STRINGMAXLEN_IMGNAME];
+        WRITE_IMAGENAME(imnameorderscan, "%s_orderscan", outPFname);
+        IDorderscan = image_ID(imnameorderscan);
+        if(IDorderscan == -1)
+        {
+            uint32_t imsizearray[2] = {*PForder, 1};
+            create_image_ID(imnameorderscan,
+                            2,
+                            imsizearray,
+                            _DATATYPE_FLOAT,
+                            1,
+                            1,
+                            0,
+                            &IDorderscan);
+        }
     }
 
+    // gsl eigen workspaces of Gram solves, allocated once for all solve
+    // sizes, see linARfilterPred_gram_eigen_alloc()
+    if((LOCALmode == 1) && (localqmax > 0))
+    {
+        ws.NBlocaleig = localqmax / (*PForder);
+        ws.localeig   = linARfilterPred_gram_eigen_alloc(NBthread,
+                        ws.NBlocaleig,
+                        *PForder);
+    }
+    else if(*solver == 1)
+    {
+        ws.solveeig = linARfilterPred_gram_eigen_alloc(1, 1, ndesign);
+    }
+    if((IDorderscan != -1) && (*orderscan == 1))
+    {
+        ws.orderscaneig =
+            linARfilterPred_gram_eigen_alloc(1, *PForder, NBpixin);
+    }
 
 
 
@@ -508,12 +1881,45 @@ static errno_t compute_function()
     struct timespec t1;
 
 
+    // Subspace solver: singular subspace kept between iterations
+    LINARFILTERPRED_SUBSPACE subspace;
+    subspace.V = NULL;
+    if((LOCALmode == 0) && (*solver == 2))
+    {
+        linARfilterPred_subspace_init(&subspace, ndesign, *SVDwarmrank);
+    }
+
+    // Filter solution over the ndesign kept columns, see ordermap_expand()
+    float *PFmatr = ws.PFmatr;
+
+    // Monitor mode: stream of residual measured by applyPF
+    IMGID           imgres       = mkIMGID_from_name(monitorresstream);
+    uint64_t        rescnt0build = 0;
+    struct timespec tbuild;
+    clock_gettime(CLOCK_REALTIME, &tbuild);
+
+    // Per-stage timing, published to <outPF>_timing, see linPF_timing.c
+    LINARFILTERPRED_TIMING timing;
+    imageID                IDtiming = -1;
+    char                   timingname[STRINGMAXLEN_IMGNAME];
+    WRITE_IMAGENAME(timingname, "%s_timing", outPFname);
+    clock_gettime(CLOCK_REALTIME, &t1);
+
+
 
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_START
 
     clock_gettime(CLOCK_REALTIME, &t0);
 
+    // waiting time since end of previous iteration
+    linARfilterPred_timing_reset(&timing);
+    {
+        struct timespec tdiffwait = timespec_diff(t1, t0);
+        timing.tsec[LINPF_STAGE_WAIT] =
+            1.0 * tdiffwait.tv_sec + 1.0e-9 * tdiffwait.tv_nsec;
+    }
+
     printf("=========== LOOP ITERATION %6ld =======\n", processinfo->loopcnt);
     printf("  PFlag     = %20f      ", *PFlatency);
     printf("  SVDeps    = %20f\n", *SVDeps);
@@ -521,270 +1927,1059 @@ static errno_t compute_function()
     printf("  LOOPgain  = %20f\n", *loopgain);
     printf("\n");
 
-    /// *STEP: Copy IDin to IDincp*
+    /// *STEP: Decide if filter needs to be rebuilt (monitor mode)*
     ///
-    /// Necessary as input may be continuously changing between consecutive loop iterations.
+    /// In monitor mode, the filter is only rebuilt if the prediction
+    /// residual measured by applyPF exceeds the expected residual by
+    /// factor .monitor.margin, or if the filter is older than
+    /// .monitor.maxage.
     ///
-    IDincp = image_ID("PFin_copy");
-    memcpy(data.image[IDincp].array.F,
-           imgin.im->array.F,
-           sizeof(float) * inNBelem);
+    /// The measured residual is only used once it is fresh: the stream
+    /// cnt0 was rescnt0build at the last rebuild, the next publication
+    /// (rescnt0build+1) averages frames partly applied with the previous
+    /// filter, so only cnt0 > rescnt0build+1 is entirely measured with
+    /// the current filter.
+    ///
+    /// applyPF .monitor.lag should be set to .PFlatency: the measured
+    /// residual is interpolated at the same fractional lag as the
+    /// training targets and the expected residual.
+    ///
+    int rebuild = 1;
+    if((*monitor == 1) && (processinfo->loopcnt > 0))
+    {
+        if(imgres.ID == -1)
+        {
+            resolveIMGID(&imgres, ERRMODE_WARN);
+        }
+
+        struct timespec tdiffbuild = timespec_diff(tbuild, t0);
+        double          agebuild =
+            1.0 * tdiffbuild.tv_sec + 1.0e-9 * tdiffbuild.tv_nsec;
+
+        if(agebuild < *monitormaxage)
+        {
+            rebuild = 0;
+            if(imgres.ID != -1)
+            {
+                if(imgres.md->cnt0 > rescnt0build + 1)
+                {
+                    *monitormeasres = imgres.im->array.F[0];
+                    if(*monitormeasres > (*monitormargin) * (*monitorexpres))
+                    {
+                        rebuild = 1;
+                    }
+                }
+            }
+        }
+
+        if(rebuild == 0)
+        {
+            (*monitorNBskip)++;
+            printf("Skipping rebuild: age %.3f s, residual %g / %g\n",
+                   agebuild,
+                   *monitormeasres,
+                   *monitorexpres);
+        }
+    }
 
 
+    if(rebuild == 1)
+    {
+        /// *STEP: Flag valid frames and training samples*
+        ///
+        /// Without any valid sample, the statistics are empty and the
+        /// solve would publish a zero filter: the rebuild is skipped and
+        /// the previous filter is kept.
+        ///
+        long NBframevalid =
+            linARfilterPred_valid_frames(nbspl,
+                                         segments,
+                                         IDvalidmask,
+                                         framevalid);
+        *NBsamplevalid =
+            linARfilterPred_valid_samples(nbspl,
+                                          framevalid,
+                                          NBmvec,
+                                          *PForder + (long)(*PFlatency) + 1,
+                                          samplevalid,
+                                          ws.NBinvalid);
+        printf("Valid frames  : %ld / %u\n", NBframevalid, nbspl);
+        printf("Valid samples : %lu / %ld\n", *NBsamplevalid, NBmvec);
+
+        if(*NBsamplevalid == 0)
+        {
+            PRINT_WARNING("no valid training sample - keeping previous filter");
+            rebuild = 0;
+        }
+    }
 
 
-    /// *STEP: if DC_MODE==1, compute average value from each variable*
-    if(DC_MODE == 1)  // remove average
+    if(rebuild == 1)
     {
+        /// *STEP: Copy IDin to IDincp*
+        ///
+        /// Necessary as input may be continuously changing between consecutive loop iterations.
+        ///
+        /// If DCmode is ON, the average value of each input and output
+        /// variable is computed during the copy, frame by frame, as a
+        /// running (Welford) mean, so no extra pass over the data is needed.
+        ///
+        linARfilterPred_timing_start(&timing, LINPF_STAGE_COPY);
+        linARfilterPred_timing_bytes(&timing,
+                                     LINPF_STAGE_COPY,
+                                     2.0 * sizeof(float) * inNBelem);
+
         for(long pix = 0; pix < NBpixin; pix++)
         {
             ave_inarray[pix] = 0.0;
+        }
+        for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+        {
+            ave_outarray[PFpix] = 0.0;
+        }
+        if(*DCmode == 1)
+        {
+            long cnt = 0;
             for(uint32_t m = 0; m < nbspl; m++)
             {
-                ave_inarray[pix] +=
-                    data.image[IDincp].array.F[m * xysize + pixarray_xy[pix]];
+                float *frame = &data.image[IDincp].array.F[m * xysize];
+                memcpy(frame, &imgin.im->array.F[m * xysize], sizeof(float) * xysize);
+
+                if(framevalid[m] == 0)
+                {
+                    continue;
+                }
+                cnt++;
+                double invcnt = 1.0 / cnt;
+                for(long pix = 0; pix < NBpixin; pix++)
+                {
+                    ave_inarray[pix] +=
+                        (frame[pixarray_xy[pix]] - ave_inarray[pix]) * invcnt;
+                }
+                for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+                {
+                    ave_outarray[PFpix] +=
+                        (frame[outpixarray_xy[PFpix]] - ave_outarray[PFpix]) *
+                        invcnt;
+                }
             }
-            ave_inarray[pix] /= nbspl;
         }
-    }
-    else
-    {
-        for(uint32_t pix = 0; pix < NBpixin; pix++)
+        else
         {
-            ave_inarray[pix] = 0.0;
+            memcpy(data.image[IDincp].array.F,
+                   imgin.im->array.F,
+                   sizeof(float) * inNBelem);
         }
-    }
 
+        /// *STEP: Set aside held-out window (optional)*
+        ///
+        /// With .score.enable, the last .score.frac samples are not used
+        /// for training. The residuals of the current, new and blended
+        /// filters on these samples are computed before blending. Not used
+        /// in local mode.\n
+        /// With Nheld held-out samples, scoring from their normal-equation
+        /// statistics (SCOREmode 1), see
+        /// linARfilterPred_gram_residual_blend(), costs about
+        /// (Nheld + 2 NBpixout) mvecsize^2, and replaying the samples
+        /// (SCOREmode 2), see linARfilterPred_monitor_blendres(), costs
+        /// 2 Nheld NBpixout mvecsize. Samples are replayed if
+        /// Nheld < mvecsize.
+        ///
+        int  SCOREmode = 0;
+        long mscore    = NBmvec;
+        long NBheld    = 0;
+        if((*scoreenable == 1) && (LOCALmode == 0))
+        {
+            linARfilterPred_timing_start(&timing, LINPF_STAGE_SCORE);
+            mscore = NBmvec - (long)(*scorefrac * NBmvec);
+            if((mscore > 0) && (mscore < NBmvec))
+            {
+                for(long m = mscore; m < NBmvec; m++)
+                {
+                    ws.scorevalid[m] = samplevalid[m];
+                    NBheld += samplevalid[m];
+                }
+                if(NBheld == (long) *NBsamplevalid)
+                {
+                    // all valid samples held out: keep them for training
+                    printf("No training sample outside of held-out window - not scoring\n");
+                    NBheld = 0;
+                    mscore = NBmvec;
+                }
 
+                if(NBheld >= mvecsize)
+                {
+                    linARfilterPred_timing_bytes(&timing,
+                                                 LINPF_STAGE_SCORE,
+                                                 sizeof(float) * (NBmvec - mscore) *
+                                                 (mvecsize + NBpixout));
+                    linARfilterPred_gram_reset(&ws.gramscore);
+                    linARfilterPred_gram_accumulate_valid(&ws.gramscore,
+                                                          data.image[IDincp].array.F,
+                                                          xysize,
+                                                          NBpixin,
+                                                          pixarray_xy,
+                                                          NBpixout,
+                                                          outpixarray_xy,
+                                                          *PForder,
+                                                          *PFlatency,
+                                                          mscore,
+                                                          NBmvec,
+                                                          samplevalid);
+                    linARfilterPred_gram_symmetrize(&ws.gramscore);
+                    if(*DCmode == 1)
+                    {
+                        linARfilterPred_gram_center(&ws.gramscore,
+                                                    NBpixin,
+                                                    ave_inarray,
+                                                    ave_outarray);
+                    }
+                    SCOREmode = 1;
+                }
+                else if(NBheld > 0)
+                {
+                    SCOREmode = 2;
+                }
 
-    /// *STEP: Fill up data matrix PFmatD from input telemetry*
-    ///
-    for(long m = 0; m < NBmvec1; m++)
-    {
-        long k0 = m + *PForder - 1; // dt=0 index
-        for(long pix = 0; pix < NBpixin; pix++)
-            for(long dt = 0; dt < *PForder; dt++)
-            {
-                data.image[IDmatA].array.F[(NBpixin * dt + pix) * NBmvec1 + m] =
-                    data.image[IDincp]
-                    .array.F[(k0 - dt) * xysize + pixarray_xy[pix]] -
-                    ave_inarray[pix];
+                for(long m = mscore; m < NBmvec; m++)
+                {
+                    if(samplevalid[m] == 1)
+                    {
+                        samplevalid[m] = 0;
+                        (*NBsamplevalid)--;
+                    }
+                }
+                printf("Held-out samples : %ld\n", NBheld);
             }
-    }
+        }
 
 
 
-    /// *STEP: Write regularization coefficients (optional)*
-    ///
-    if(REG == 1)
-    {
-        for(long m = 0; m < mvecsize; m++)
+        if(LOCALmode == 1)
         {
-            //m1 = NBmvec + m;
-            data.image[IDmatA].array.F[(m) *NBmvec1 + (NBmvec + m)] =
-                *reglambda;
+            /// *STEP: Solve local filters (local mode)*
+            ///
+            /// Each output pixel filter is solved independently from its
+            /// neighbourhood, and written in sparse (CSR) format.
+            ///
+            linARfilterPred_timing_start(&timing, LINPF_STAGE_FACTOR);
+            data.image[IDspvalraw].md[0].write = 1;
+            linARfilterPred_local_solve(data.image[IDincp].array.F,
+                                        xysize,
+                                        pixarray_xy,
+                                        ave_inarray,
+                                        NBpixout,
+                                        outpixarray_xy,
+                                        ave_outarray,
+                                        nbrowptr,
+                                        nbpix,
+                                        *PForder,
+                                        *PFlatency,
+                                        NBmvec,
+                                        samplevalid,
+                                        *SVDeps,
+                                        data.image[IDspvalraw].array.F,
+                                        NBthread,
+                                        localqmax,
+                                        ws.localwork,
+                                        ws.localeig);
+            linARfilterPred_timing_start(&timing, LINPF_STAGE_PUBLISH);
+            COREMOD_MEMORY_image_set_sempost_byID(IDspvalraw, -1);
+            data.image[IDspvalraw].md[0].cnt0++;
+            data.image[IDspvalraw].md[0].write = 0;
+
+            linARfilterPred_timing_start(&timing, LINPF_STAGE_BLEND);
+            linARfilterPred_timing_bytes(&timing,
+                                         LINPF_STAGE_BLEND,
+                                         3.0 * sizeof(float) * NBlocalcoeff);
+            // on first iteration, set loopgain to 1 to initalize content
+            float loopgainval = *loopgain;
+            if(processinfo->loopcnt == 0)
+            {
+                loopgainval = 1.0;
+            }
+            data.image[IDspval].md[0].write = 1;
+            for(long e = 0; e < NBlocalcoeff; e++)
+            {
+                data.image[IDspval].array.F[e] =
+                    (1.0 - loopgainval) * data.image[IDspval].array.F[e] +
+                    loopgainval * data.image[IDspvalraw].array.F[e];
+            }
+            linARfilterPred_timing_start(&timing, LINPF_STAGE_PUBLISH);
+            COREMOD_MEMORY_image_set_sempost_byID(IDspval, -1);
+            data.image[IDspval].md[0].cnt0++;
+            data.image[IDspval].md[0].write = 0;
         }
-    }
+        else
+        {
+
+            if((*orderscan == 1) && (ORDERMAPmode == 0))
+            {
+                /// *STEP: Select filter order by cross-validation (optional)*
+                ///
+                /// Scores all orders up to PForder on held-out telemetry
+                /// segments, and writes the filter of the selected order
+                /// in psinvPFmat, with zero coefficients beyond that order.
+                ///
+                /// The scan workspace is carved out of the arena if the scan
+                /// is enabled at startup. If it is enabled later, or if
+                /// .orderscan.NBfold is changed, it is allocated here in a
+                /// separate arena, kept until the next change. Its gsl
+                /// eigen workspaces are then also allocated, once.
+                ///
+                long NBfold = (*orderscanNBfold < 2) ? 2 : *orderscanNBfold;
+                if(ws.orderscaneig == NULL)
+                {
+                    ws.orderscaneig =
+                        linARfilterPred_gram_eigen_alloc(1, *PForder, NBpixin);
+                }
+                if(ws.orderscan.NBfold != NBfold)
+                {
+                    printf("Order scan workspace : %ld folds\n", NBfold);
+                    linARfilterPred_arena_free(&orderscanarena);
+                    linARfilterPred_orderscan_carve(&orderscanarena,
+                                                    &ws.orderscan,
+                                                    NBpixin,
+                                                    NBpixout,
+                                                    *PForder,
+                                                    NBfold);
+                    linARfilterPred_arena_init(&orderscanarena,
+                                               orderscanarena.offset,
+                                               *arenahugepage);
+                    linARfilterPred_orderscan_carve(&orderscanarena,
+                                                    &ws.orderscan,
+                                                    NBpixin,
+                                                    NBpixout,
+                                                    *PForder,
+                                                    NBfold);
+                }
 
-    // int Save = 1;
-    // if (Save == 1)
-    // {
-    //save_fits("PFmatD", "PFmatD.fits");
-    // }
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_FACTOR);
+                *orderscanorder =
+                    linARfilterPred_orderscan(data.image[IDincp].array.F,
+                                              xysize,
+                                              NBpixin,
+                                              pixarray_xy,
+                                              ave_inarray,
+                                              NBpixout,
+                                              outpixarray_xy,
+                                              ave_outarray,
+                                              *PForder,
+                                              *PFlatency,
+                                              NBmvec,
+                                              samplevalid,
+                                              *SVDeps,
+                                              *orderscankneetol,
+                                              &ws.orderscan,
+                                              ws.orderscaneig);
+                printf("Selected filter order : %u\n", *orderscanorder);
+
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_PUBLISH);
+                // publish error curve
+                data.image[IDorderscan].md[0].write = 1;
+                for(uint32_t order = 1; order <= *PForder; order++)
+                {
+                    data.image[IDorderscan].array.F[order - 1] =
+                        ws.orderscan.errcurve[order - 1];
+                }
+                COREMOD_MEMORY_image_set_sempost_byID(IDorderscan, -1);
+                data.image[IDorderscan].md[0].cnt0++;
+                data.image[IDorderscan].md[0].write = 0;
 
+                for(long ii = 0; ii < NBpixout * mvecsize; ii++)
+                {
+                    data.image[IDoutPF2Dn].array.F[ii] = ws.orderscan.Wbest[ii];
+                }
+            }
+            else if((*solver == 1) || (*solver == 4))
+            {
+                /// *STEP: Solve normal equations (optional)*
+                ///
+                /// Accumulates G = X^T X and C = Y^T X in blocks, without
+                /// building the data matrix. Averages are removed analytically
+                /// from the statistics. Regularization adds reglambda^2 to the
+                /// diagonal of G, as the extra data matrix rows do.
+                ///
+                /// The sparse solver (4) selects, for each output, the input
+                /// modes (all time steps) that reduce the prediction residual
+                /// by more than .sparse.tol, up to .sparse.maxgroups inputs,
+                /// see linPF_groupsel.c. Other coefficients are zero.
+                ///
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_FILL);
+                linARfilterPred_timing_bytes(&timing,
+                                             LINPF_STAGE_FILL,
+                                             sizeof(float) * NBmvec * (mvecsize + NBpixout));
+                LINARFILTERPRED_GRAM gram = ws.gram;
+                linARfilterPred_gram_reset(&gram);
+                linARfilterPred_gram_accumulate_valid(&gram,
+                                                      data.image[IDincp].array.F,
+                                                      xysize,
+                                                      NBpixin,
+                                                      pixarray_xy,
+                                                      NBpixout,
+                                                      outpixarray_xy,
+                                                      *PForder,
+                                                      *PFlatency,
+                                                      0,
+                                                      NBmvec,
+                                                      samplevalid);
+                linARfilterPred_gram_symmetrize(&gram);
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_DC);
+                if(*DCmode == 1)
+                {
+                    linARfilterPred_gram_center(&gram,
+                                                NBpixin,
+                                                ave_inarray,
+                                                ave_outarray);
+                }
 
-    /// ### Compute pseudo-inverse of PFmatD
-    ///
-    /// *STEP: Compute Pseudo-Inverse of PFmatD*
-    ///
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_FACTOR);
+                // Kept columns only (order map)
+                if(ORDERMAPmode == 1)
+                {
+                    for(long c = 0; c < ndesign; c++)
+                        for(long c1 = 0; c1 < ndesign; c1++)
+                        {
+                            gram.G[c * ndesign + c1] =
+                                gram.G[colmap[c] * mvecsize + colmap[c1]];
+                        }
+                    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+                        for(long c = 0; c < ndesign; c++)
+                        {
+                            gram.C[PFpix * ndesign + c] =
+                                gram.C[PFpix * mvecsize + colmap[c]];
+                        }
+                }
+                if(REG == 1)
+                {
+                    for(long ii = 0; ii < ndesign; ii++)
+                    {
+                        gram.G[ii * ndesign + ii] += (*reglambda) * (*reglambda);
+                    }
+                }
+
+                double *Wgram = ws.Wgram;
+                if(*solver == 4)
+                {
+                    long *group = ws.group;
+                    for(long c = 0; c < ndesign; c++)
+                    {
+                        group[c] = colmap[c] % NBpixin;
+                    }
+                    long NBselect =
+                        linARfilterPred_groupsel_solve(gram.G,
+                                                       ndesign,
+                                                       gram.C,
+                                                       gram.yty,
+                                                       NBpixout,
+                                                       group,
+                                                       NBpixin,
+                                                       *sparsemaxgroups,
+                                                       *sparsetol,
+                                                       *SVDeps,
+                                                       Wgram);
+                    printf("Sparse solver: %.2f / %ld inputs per output\n",
+                           1.0 * NBselect / NBpixout,
+                           NBpixin);
+                }
+                else
+                {
+                    long NBmodekept = linARfilterPred_gram_solve_buffer(gram.G,
+                                      ndesign,
+                                      gram.C,
+                                      NBpixout,
+                                      *SVDeps,
+                                      Wgram,
+                                      ws.solveeig[0],
+                                      ws.solvebuf);
+                    printf("Gram solver: %ld / %ld modes kept\n",
+                           NBmodekept,
+                           ndesign);
+                }
+
+                for(long ii = 0; ii < NBpixout * ndesign; ii++)
+                {
+                    PFmatr[ii] = Wgram[ii];
+                }
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_ASSEMBLE);
+                ordermap_expand(PFmatr,
+                                NBpixout,
+                                ndesign,
+                                colmap,
+                                mvecsize,
+                                data.image[IDoutPF2Dn].array.F);
+            }
+            else if(*solver == 3)
+            {
+                /// *STEP: Solve with tall-skinny QR (optional)*
+                ///
+                /// Row blocks of [PFmatD PFfmdat] are built from telemetry and
+                /// factored in parallel, see linPF_tsqr.c.
+                ///
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_FACTOR);
+                linARfilterPred_timing_bytes(&timing,
+                                             LINPF_STAGE_FACTOR,
+                                             sizeof(float) * NBmvec * (mvecsize + NBpixout));
+                long NBmodekept =
+                    linARfilterPred_tsqr_solve(data.image[IDincp].array.F,
+                                               xysize,
+                                               NBpixin,
+                                               pixarray_xy,
+                                               ave_inarray,
+                                               NBpixout,
+                                               outpixarray_xy,
+                                               ave_outarray,
+                                               *PForder,
+                                               *PFlatency,
+                                               NBmvec,
+                                               samplevalid,
+                                               colmap,
+                                               ndesign,
+                                               (REG == 1) ? *reglambda : 0.0,
+                                               *TSQRblocksize,
+                                               *SVDeps,
+                                               PFmatr);
+                printf("TSQR solver: %ld / %ld modes kept\n",
+                       NBmodekept,
+                       ndesign);
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_ASSEMBLE);
+                ordermap_expand(PFmatr,
+                                NBpixout,
+                                ndesign,
+                                colmap,
+                                mvecsize,
+                                data.image[IDoutPF2Dn].array.F);
+            }
+            else
+            {
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_FILL);
+                linARfilterPred_timing_bytes(&timing,
+                                             LINPF_STAGE_FILL,
+                                             2.0 * sizeof(float) *
+                                             (ndesign * NBmvec1 + NBpixout * NBmvec));
+                /// *STEP: Fill up data matrix PFmatD and future measured data matrix PFfmdat*
+                ///
+                /// Invalid samples are zero rows, which do not contribute to the solution.
+                ///
+                /// Row c of PFmatD is 2D filter column colmap[c].\n
+                /// Tiles of PFmatD and PFfmdat rows are independent tasks.
+                ///
+                float alpha = *PFlatency - ((long)(*PFlatency));
+                #pragma omp parallel
+                #pragma omp single
+                {
+                    for(long c0 = 0; c0 < ndesign; c0 += tile)
+                    {
+                        #pragma omp task firstprivate(c0)
+                        {
+                            long c1 = (c0 + tile < ndesign) ? c0 + tile : ndesign;
+                            for(long c = c0; c < c1; c++)
+                            {
+                                long   dt    = colmap[c] / NBpixin;
+                                long   pix   = colmap[c] - dt * NBpixin;
+                                float *Arow  = &data.image[IDmatA].array.F[c * NBmvec1];
+                                float *frame = &data.image[IDincp].array.F[pixarray_xy[pix]];
+                                for(long m = 0; m < NBmvec; m++)
+                                {
+                                    long k0 = m + *PForder - 1; // dt=0 index
+                                    if(samplevalid[m] == 0)
+                                    {
+                                        Arow[m] = 0.0;
+                                        continue;
+                                    }
+                                    Arow[m] = frame[(k0 - dt) * xysize] - ave_inarray[pix];
+                                }
+                            }
+                        }
+                    }
+
+                    for(long PFpix0 = 0; PFpix0 < NBpixout; PFpix0 += tile)
+                    {
+                        #pragma omp task firstprivate(PFpix0)
+                        {
+                            long PFpix1 =
+                                (PFpix0 + tile < NBpixout) ? PFpix0 + tile : NBpixout;
+                            for(long PFpix = PFpix0; PFpix < PFpix1; PFpix++)
+                                for(long m = 0; m < NBmvec; m++)
+                                {
+                                    if(samplevalid[m] == 0)
+                                    {
+                                        data.image[IDfm].array.F[PFpix * NBmvec + m] = 0.0;
+                                        continue;
+                                    }
+                                    long k0 = m + *PForder - 1;
+                                    k0 += (long) * PFlatency;
+
+                                    data.image[IDfm].array.F[PFpix * NBmvec + m] =
+                                        (1.0 - alpha) *
+                                        data.image[IDincp]
+                                        .array.F[(k0) * xysize + outpixarray_xy[PFpix]] +
+                                        alpha * data.image[IDincp]
+                                        .array.F[(k0 + 1) * xysize + outpixarray_xy[PFpix]] -
+                                        ave_outarray[PFpix];
+                                }
+                        }
+                    }
+                }
+
+
+
+                /// *STEP: Write regularization coefficients (optional)*
+                ///
+                if(REG == 1)
+                {
+                    for(long ii = 0; ii < ndesign; ii++)
+                        for(long m = NBmvec; m < NBmvec1; m++)
+                        {
+                            data.image[IDmatA].array.F[ii * NBmvec1 + m] = 0.0;
+                        }
+                    for(long m = 0; m < ndesign; m++)
+                    {
+                        //m1 = NBmvec + m;
+                        data.image[IDmatA].array.F[(m) *NBmvec1 + (NBmvec + m)] =
+                            *reglambda;
+                    }
+                }
+
+                // int Save = 1;
+                // if (Save == 1)
+                // {
+                //save_fits("PFmatD", "PFmatD.fits");
+                // }
 
-    // Assemble future measured data matrix
-    float alpha = *PFlatency - ((long)(*PFlatency));
-    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
-        for(long m = 0; m < NBmvec; m++)
-        {
-            long k0 = m + *PForder - 1;
-            k0 += (long) * PFlatency;
-
-            data.image[IDfm].array.F[PFpix * NBmvec + m] =
-                (1.0 - alpha) *
-                data.image[IDincp]
-                .array.F[(k0) * xysize + outpixarray_xy[PFpix]] +
-                alpha * data.image[IDincp]
-                .array.F[(k0 + 1) * xysize + outpixarray_xy[PFpix]];
-        }
-    //save_fits("PFfmdat", "PFfmdat.fits");
 
-    /// If using MAGMA, call function CUDACOMP_magma_compute_SVDpseudoInverse()\n
-    /// Otherwise, call function linopt_compute_SVDpseudoInverse()\n
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_FACTOR);
+                /// ### Compute pseudo-inverse of PFmatD
+                ///
+                /// *STEP: Compute Pseudo-Inverse of PFmatD*
+                ///
 
-    long NB_SVD_Modes = 10000;
-    int  LOOPmode     = 0; // 1 if re-use arrays
+                //save_fits("PFfmdat", "PFfmdat.fits");
+
+                if(*solver == 2)
+                {
+                    /// *STEP: Warm-started subspace iteration (optional)*
+                    ///
+                    /// Tracks the dominant right singular subspace of PFmatD
+                    /// across loop iterations, see linPF_subspace.c.
+                    ///
+                    long NBmodekept =
+                        linARfilterPred_subspace_solve(&subspace,
+                                                       data.image[IDmatA].array.F,
+                                                       NBmvec1,
+                                                       data.image[IDfm].array.F,
+                                                       NBmvec,
+                                                       NBpixout,
+                                                       *SVDwarmNBsweep,
+                                                       *SVDwarmNBsweepinit,
+                                                       *SVDeps,
+                                                       PFmatr);
+                    printf("Subspace solver: %ld / %ld modes kept\n",
+                           NBmodekept,
+                           subspace.rank);
+                    linARfilterPred_timing_start(&timing, LINPF_STAGE_ASSEMBLE);
+                    ordermap_expand(PFmatr,
+                                    NBpixout,
+                                    ndesign,
+                                    colmap,
+                                    mvecsize,
+                                    data.image[IDoutPF2Dn].array.F);
+                }
+                else
+                {
+                    /// If using MAGMA, call function CUDACOMP_magma_compute_SVDpseudoInverse()\n
+                    /// Otherwise, call function linopt_compute_SVDpseudoInverse()\n
+
+                    long NB_SVD_Modes = 10000;
+                    int  LOOPmode     = 0; // 1 if re-use arrays
 
 #ifdef HAVE_MAGMA
-    printf("Using magma ...\n");
-    CUDACOMP_magma_compute_SVDpseudoInverse("PFmatD",
-                                            "PFmatC",
-                                            *SVDeps,
-                                            NB_SVD_Modes,
-                                            "PF_VTmat",
-                                            LOOPmode,
-                                            0, // testmode
-                                            32,
-                                            *GPUdevice,
-                                            NULL);
+                    printf("Using magma ...\n");
+                    CUDACOMP_magma_compute_SVDpseudoInverse("PFmatD",
+                                                            "PFmatC",
+                                                            *SVDeps,
+                                                            NB_SVD_Modes,
+                                                            "PF_VTmat",
+                                                            LOOPmode,
+                                                            0, // testmode
+                                                            32,
+                                                            *GPUdevice,
+                                                            NULL);
 #else
-    printf("Not using magma ...\n");
-    linopt_compute_SVDpseudoInverse("PFmatD",
-                                    "PFmatC",
-                                    *SVDeps,
-                                    NB_SVD_Modes,
-                                    "PF_VTmat",
-                                    NULL);
+                    printf("Not using magma ...\n");
+                    linopt_compute_SVDpseudoInverse("PFmatD",
+                                                    "PFmatC",
+                                                    *SVDeps,
+                                                    NB_SVD_Modes,
+                                                    "PF_VTmat",
+                                                    NULL);
 #endif
 
 
-    // Result (pseudoinverse) is stored in image PFmatC\n
-
-    //if (Save == 1)
-    // {
-    //    save_fits("PF_VTmat", "PF_VTmat.fits");
-    //    save_fits("PFmatC", "PFmatC.fits");
-    // }
-    imageID IDmatC = image_ID("PFmatC");
-
-    ///
-    /// ### Assemble Predictive Filter
-    ///
-    //printf("Compute filters\n");
-    //fflush(stdout);
+                    // Result (pseudoinverse) is stored in image PFmatC\n
 
-    if(system("mkdir -p pixfilters") != 0)
-    {
-        PRINT_ERROR("system() returns non-zero value");
-    }
+                    //if (Save == 1)
+                    // {
+                    //    save_fits("PF_VTmat", "PF_VTmat.fits");
+                    //    save_fits("PFmatC", "PFmatC.fits");
+                    // }
+                    imageID IDmatC = image_ID("PFmatC");
 
+                    ///
+                    /// ### Assemble Predictive Filter
+                    ///
+                    //printf("Compute filters\n");
+                    //fflush(stdout);
 
-    /*
-    printf("===========================================================\n");
-    printf("ASSEMBLING OUTPUT\n");
-    printf("  NBpixout = %ld\n", NBpixout);
-    printf("  NBmvec   = %ld\n", NBmvec);
-    printf("  NBmvec1  = %ld\n", NBmvec1);
-    printf("  NBpixin  = %ld\n", NBpixin);
-    printf("  PForder  = %u\n", *PForder);
-    printf("===========================================================\n");
-    */
+                    if(system("mkdir -p pixfilters") != 0)
+                    {
+                        PRINT_ERROR("system() returns non-zero value");
+                    }
 
-    long IDoutPF2Dn = image_ID("psinvPFmat");
-    if(IDoutPF2Dn == -1)
-    {
-        printf("------------------- CPU computing PF matrix\n");
 
-        create_2Dimage_ID("psinvPFmat",
-                          NBpixin * *PForder,
-                          NBpixout,
-                          &IDoutPF2Dn);
-        for(
-            long PFpix = 0; PFpix < NBpixout;
-            PFpix++) // PFpix is the pixel for which the filter is created (axis 1 in cube, jj)
-        {
+                    /*
+                    printf("===========================================================\n");
+                    printf("ASSEMBLING OUTPUT\n");
+                    printf("  NBpixout = %ld\n", NBpixout);
+                    printf("  NBmvec   = %ld\n", NBmvec);
+                    printf("  NBmvec1  = %ld\n", NBmvec1);
+                    printf("  NBpixin  = %ld\n", NBpixin);
+                    printf("  PForder  = %u\n", *PForder);
+                    printf("===========================================================\n");
+                    */
+
+                    // psinvPFmat is computed on GPU if it exists after the MAGMA call,
+                    // which may re-create it
+                    int PFmatGPU = 0;
+#ifdef HAVE_MAGMA
+                    IDoutPF2Dn = image_ID("psinvPFmat");
+                    if((IDoutPF2Dn != -1) && (ORDERMAPmode == 0))
+                    {
+                        PFmatGPU = 1;
+                    }
+                    if((IDoutPF2Dn != -1) &&
+                            (data.image[IDoutPF2Dn].md[0].nelement !=
+                             (uint64_t) NBpixout * mvecsize))
+                    {
+                        // GPU product over kept columns only (order map)
+                        delete_image_ID("psinvPFmat", DELETE_IMAGE_ERRMODE_WARNING);
+                        IDoutPF2Dn = -1;
+                    }
+#endif
+                    if(PFmatGPU == 0)
+                    {
+                        printf("------------------- CPU computing PF matrix\n");
+
+                        if(IDoutPF2Dn == -1)
+                        {
+                            create_2Dimage_ID("psinvPFmat",
+                                              NBpixin * *PForder,
+                                              NBpixout,
+                                              &IDoutPF2Dn);
+                        }
+                        linARfilterPred_timing_start(&timing, LINPF_STAGE_ASSEMBLE);
+                        linARfilterPred_timing_bytes(&timing,
+                                                     LINPF_STAGE_ASSEMBLE,
+                                                     sizeof(float) *
+                                                     (ndesign * NBmvec1 + NBpixout * NBmvec));
+                        // Tiles of output modes: assembly, then expansion
+                        // to 2D filter rows once the tile is assembled
+                        float *PFoutn = data.image[IDoutPF2Dn].array.F;
+                        #pragma omp parallel
+                        #pragma omp single
+                        {
+                            for(long PFpix0 = 0; PFpix0 < NBpixout; PFpix0 += tile)
+                            {
+                                long PFpix1 =
+                                    (PFpix0 + tile < NBpixout) ? PFpix0 + tile : NBpixout;
+
+                                #pragma omp task firstprivate(PFpix0, PFpix1) depend(out: PFmatr[PFpix0 * ndesign])
+                                for(
+                                    long PFpix = PFpix0; PFpix < PFpix1;
+                                    PFpix++) // PFpix is the pixel for which the filter is created (axis 1 in cube, jj)
+                                {
+
+                                    // loop on kept input values and time steps
+                                    for(long c = 0; c < ndesign; c++)
+                                    {
+                                        float val  = 0.0;
+                                        long  ind1 = c * NBmvec1;
+                                        for(long m = 0; m < NBmvec; m++)
+                                        {
+                                            val += data.image[IDmatC].array.F[ind1 + m] *
+                                                   data.image[IDfm].array.F[PFpix * NBmvec + m];
+                                        }
+                                        PFmatr[PFpix * ndesign + c] = val;
+                                    }
+                                }
+
+                                #pragma omp task firstprivate(PFpix0, PFpix1) depend(in: PFmatr[PFpix0 * ndesign])
+                                ordermap_expand(&PFmatr[PFpix0 * ndesign],
+                                                PFpix1 - PFpix0,
+                                                ndesign,
+                                                colmap,
+                                                mvecsize,
+                                                &PFoutn[PFpix0 * mvecsize]);
+                            }
+                        }
+                    }
+                    else
+                    {
+                        printf("------------------- Using GPU-computed PF matrix\n");
+                    }
+                }
+            }
+            // delete_image_ID("PFfmdat", DELETE_IMAGE_ERRMODE_WARNING);
+
+            linARfilterPred_timing_start(&timing, LINPF_STAGE_PUBLISH);
+            linARfilterPred_timing_bytes(&timing,
+                                         LINPF_STAGE_PUBLISH,
+                                         2.0 * sizeof(float) * NBpixout * mvecsize);
+            //printf("IDoutPF2Draw = %ld\n", IDoutPF2Draw);
+            data.image[IDoutPF2Draw].md[0].write = 1;
+            memcpy(data.image[IDoutPF2Draw].array.F,
+                   data.image[IDoutPF2Dn].array.F,
+                   sizeof(float) * NBpixout * NBpixin * *PForder);
+            COREMOD_MEMORY_image_set_sempost_byID(IDoutPF2Draw, -1);
+            data.image[IDoutPF2Draw].md[0].cnt0++;
+            data.image[IDoutPF2Draw].md[0].write = 0;
+
+            // on first iteration, set loopgain to 1 to initalize content
+            float loopgainval = 0.0;
+            if(processinfo->loopcnt == 0)
+            {
+                loopgainval = 1.0;
+            }
+            else
+            {
+                loopgainval = *loopgain;
+            }
 
-            // loop on input values
-            for(long pix = 0; pix < NBpixin; pix++)
+            /// *STEP: Score filters on held-out window (optional)*
+            ///
+            /// Residuals per held-out sample of the current filter, new
+            /// filter and their blend. With .score.refuse, a blend worse
+            /// than the current filter is not published.
+            ///
+            linARfilterPred_timing_start(&timing, LINPF_STAGE_SCORE);
+            int publish = 1;
+            if(SCOREmode != 0)
             {
-                for(long dt = 0; dt < *PForder; dt++)
+                double resold;
+                double resnew;
+                double resmix;
+                if(SCOREmode == 1)
                 {
-                    float val  = 0.0;
-                    long  ind1 = (NBpixin * dt + pix) * NBmvec1;
-                    for(long m = 0; m < NBmvec; m++)
+                    linARfilterPred_gram_residual_blend(&ws.gramscore,
+                                                        data.image[IDoutPF2D].array.F,
+                                                        data.image[IDoutPF2Dn].array.F,
+                                                        loopgainval,
+                                                        &resold,
+                                                        &resnew,
+                                                        &resmix);
+                }
+                else
+                {
+                    linARfilterPred_timing_bytes(&timing,
+                                                 LINPF_STAGE_SCORE,
+                                                 sizeof(float) * NBheld *
+                                                 (mvecsize + NBpixout) +
+                                                 2.0 * sizeof(float) *
+                                                 NBpixout * mvecsize);
+                    linARfilterPred_monitor_blendres(data.image[IDincp].array.F,
+                                                     xysize,
+                                                     NBpixin,
+                                                     pixarray_xy,
+                                                     ave_inarray,
+                                                     NBpixout,
+                                                     outpixarray_xy,
+                                                     ave_outarray,
+                                                     *PForder,
+                                                     *PFlatency,
+                                                     mscore,
+                                                     NBmvec,
+                                                     ws.scorevalid,
+                                                     data.image[IDoutPF2D].array.F,
+                                                     data.image[IDoutPF2Dn].array.F,
+                                                     loopgainval,
+                                                     ws.xvec,
+                                                     &resold,
+                                                     &resnew,
+                                                     &resmix);
+                }
+                *scoreold = resold / NBheld;
+                *scorenew = resnew / NBheld;
+                *scoremix = resmix / NBheld;
+                printf("Held-out residual : old %g  new %g  blend %g\n",
+                       *scoreold,
+                       *scorenew,
+                       *scoremix);
+
+                if((*scorerefuse == 1) && (processinfo->loopcnt > 0) &&
+                        (*scoremix > *scoreold))
+                {
+                    publish = 0;
+                    (*scoreNBrefused)++;
+                    printf("Blended filter is worse than current filter - not published\n");
+                }
+            }
+
+            if(publish == 1)
+            {
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_BLEND);
+                linARfilterPred_timing_bytes(&timing,
+                                             LINPF_STAGE_BLEND,
+                                             3.0 * sizeof(float) * NBpixout * mvecsize);
+                //printf("IDoutPF2D = %ld\n", IDoutPF2D);
+                // Mix current PF with last one
+                data.image[IDoutPF2D].md[0].write = 1;
+
+                printf("Mixing PF matrix with gain = %f / %f ....", loopgainval, *loopgain);
+                fflush(stdout);
+                float *PFout  = data.image[IDoutPF2D].array.F;  // Previous
+                float *PFoutn = data.image[IDoutPF2Dn].array.F; // New
+                #pragma omp parallel
+                #pragma omp single
+                #pragma omp taskloop grainsize(tile)
+                for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+                    for(long ii = PFpix * mvecsize; ii < (PFpix + 1) * mvecsize; ii++)
                     {
-                        val += data.image[IDmatC].array.F[ind1 + m] *
-                               data.image[IDfm].array.F[PFpix * NBmvec + m];
+                        PFout[ii] = (1.0 - loopgainval) * PFout[ii] + loopgainval * PFoutn[ii];
                     }
+                printf(" done\n");
+                fflush(stdout);
 
-                    data.image[IDoutPF2Dn]
-                    .array
-                    .F[PFpix * (*PForder * NBpixin) + dt * NBpixin + pix] =
-                        val;
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_PUBLISH);
+                COREMOD_MEMORY_image_set_sempost_byID(IDoutPF2D, -1);
+                data.image[IDoutPF2D].md[0].cnt0++;
+                data.image[IDoutPF2D].md[0].write = 0;
+
+                if(IDsprow != -1)
+                {
+                    // Packed filter : non-zero coefficients of the mixed filter
+                    // Support may grow as successive sparse filters are mixed
+                    imageID IDsparray[3] = {IDsprow, IDspcol, IDspval};
+                    for(int i = 0; i < 3; i++)
+                    {
+                        data.image[IDsparray[i]].md[0].write = 1;
+                    }
+                    *sparsennz =
+                        linARfilterPred_sparse_pack(NBpixout,
+                                                    mvecsize,
+                                                    data.image[IDoutPF2D].array.F,
+                                                    colmap,
+                                                    ndesign,
+                                                    data.image[IDsprow].array.UI32,
+                                                    data.image[IDspcol].array.UI32,
+                                                    data.image[IDspval].array.F);
+                    for(int i = 0; i < 3; i++)
+                    {
+                        COREMOD_MEMORY_image_set_sempost_byID(IDsparray[i], -1);
+                        data.image[IDsparray[i]].md[0].cnt0++;
+                        data.image[IDsparray[i]].md[0].write = 0;
+                    }
+                    printf("Packed filter: %lu / %ld coefficients\n",
+                           *sparsennz,
+                           NBpixout * mvecsize);
                 }
             }
-        }
-    }
-    else
-    {
-        printf("------------------- Using GPU-computed PF matrix\n");
-    }
-    // delete_image_ID("PFfmdat", DELETE_IMAGE_ERRMODE_WARNING);
 
-    //printf("IDoutPF2Draw = %ld\n", IDoutPF2Draw);
-    data.image[IDoutPF2Draw].md[0].write = 1;
-    memcpy(data.image[IDoutPF2Draw].array.F,
-           data.image[IDoutPF2Dn].array.F,
-           sizeof(float) * NBpixout * NBpixin * *PForder);
-    COREMOD_MEMORY_image_set_sempost_byID(IDoutPF2Draw, -1);
-    data.image[IDoutPF2Draw].md[0].cnt0++;
-    data.image[IDoutPF2Draw].md[0].write = 0;
+            if(*out3Dwrite == 1)
+            {
+                printf("Prepare 3D output \n");
+                linARfilterPred_timing_start(&timing, LINPF_STAGE_IO);
+                linARfilterPred_timing_bytes(&timing,
+                                             LINPF_STAGE_IO,
+                                             2.0 * sizeof(float) * NBpixin * NBpixout * (*PForder));
+
+                imageID IDoutPF3D;
+                create_3Dimage_ID("outPF3D", NBpixin, NBpixout, *PForder, &IDoutPF3D);
+
+                for(long pix = 0; pix < NBpixin; pix++)
+                    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+                        for(long dt = 0; dt < *PForder; dt++)
+                        {
+                            float val = data.image[IDoutPF2D]
+                                        .array.F[PFpix * (*PForder * NBpixin) +
+                                                       dt * NBpixin + pix];
+                            data.image[IDoutPF3D].array.F[NBpixout * NBpixin * dt +
+                                                          NBpixin * PFpix + pix] = val;
+                        }
+                save_fits("outPF3D", "_outPF3D.fits");
+                delete_image_ID("outPF3D", DELETE_IMAGE_ERRMODE_WARNING);
+            }
+        }
 
-    //printf("IDoutPF2D = %ld\n", IDoutPF2D);
-    // Mix current PF with last one
-    data.image[IDoutPF2D].md[0].write = 1;
 
+        /// *STEP: Compute expected residual (monitor mode)*
+        ///
+        if(*monitor == 1)
+        {
+            linARfilterPred_timing_start(&timing, LINPF_STAGE_MONITOR);
+            if(LOCALmode == 1)
+            {
+                *monitorexpres = linARfilterPred_monitor_expres(
+                                     data.image[IDincp].array.F,
+                                     xysize,
+                                     NBpixin,
+                                     pixarray_xy,
+                                     ave_inarray,
+                                     NBpixout,
+                                     outpixarray_xy,
+                                     ave_outarray,
+                                     *PForder,
+                                     *PFlatency,
+                                     NBmvec,
+                                     samplevalid,
+                                     data.image[IDspval].array.F,
+                                     data.image[IDsprow].array.UI32,
+                                     data.image[IDspcol].array.UI32,
+                                     *monitorNBsample,
+                                     ws.xvec);
+            }
+            else
+            {
+                *monitorexpres = linARfilterPred_monitor_expres(
+                                     data.image[IDincp].array.F,
+                                     xysize,
+                                     NBpixin,
+                                     pixarray_xy,
+                                     ave_inarray,
+                                     NBpixout,
+                                     outpixarray_xy,
+                                     ave_outarray,
+                                     *PForder,
+                                     *PFlatency,
+                                     NBmvec,
+                                     samplevalid,
+                                     data.image[IDoutPF2D].array.F,
+                                     NULL,
+                                     NULL,
+                                     *monitorNBsample,
+                                     ws.xvec);
+            }
+            printf("Expected residual = %g\n", *monitorexpres);
 
-    // on first iteration, set loopgain to 1 to initalize content
-    float loopgainval = 0.0;
-    if(processinfo->loopcnt == 0)
-    {
-        loopgainval = 1.0;
-    }
-    else
-    {
-        loopgainval = *loopgain;
-    }
-    printf("Mixing PF matrix with gain = %f / %f ....", loopgainval, *loopgain);
-    fflush(stdout);
-    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
-        for(long pix = 0; pix < NBpixin; pix++)
-            for(long dt = 0; dt < *PForder; dt++)
+            tbuild = t0;
+            if(imgres.ID != -1)
             {
-                float val0 = data.image[IDoutPF2D]
-                             .array.F[PFpix * (*PForder * NBpixin) +
-                                            dt * NBpixin + pix]; // Previous
-                float val = data.image[IDoutPF2Dn]
-                            .array.F[PFpix * (*PForder * NBpixin) +
-                                           dt * NBpixin + pix]; // New
-                data.image[IDoutPF2D].array.F[PFpix * (*PForder * NBpixin) +
-                                              dt * NBpixin + pix] =
-                                                  (1.0 - *loopgain) * val0 + *loopgain * val;
+                rescnt0build = imgres.md->cnt0;
             }
-    printf(" done\n");
-    fflush(stdout);
+        }
+    }
 
-    COREMOD_MEMORY_image_set_sempost_byID(IDoutPF2D, -1);
-    data.image[IDoutPF2D].md[0].cnt0++;
-    data.image[IDoutPF2D].md[0].write = 0;
 
-    if(*out3Dwrite == 1)
+    /// *STEP: Publish stage timing*
+    ///
+    linARfilterPred_timing_stop(&timing);
+    *timingMBmoved = 0.0;
+    for(int stage = 0; stage < LINPF_NBSTAGE; stage++)
     {
-        printf("Prepare 3D output \n");
-
-        imageID IDoutPF3D;
-        create_3Dimage_ID("outPF3D", NBpixin, NBpixout, *PForder, &IDoutPF3D);
-
-        for(long pix = 0; pix < NBpixin; pix++)
-            for(long PFpix = 0; PFpix < NBpixout; PFpix++)
-                for(long dt = 0; dt < *PForder; dt++)
-                {
-                    float val = data.image[IDoutPF2D]
-                                .array.F[PFpix * (*PForder * NBpixin) +
-                                               dt * NBpixin + pix];
-                    data.image[IDoutPF3D].array.F[NBpixout * NBpixin * dt +
-                                                  NBpixin * PFpix + pix] = val;
-                }
-        save_fits("outPF3D", "_outPF3D.fits");
-        delete_image_ID("outPF3D", DELETE_IMAGE_ERRMODE_WARNING);
+        *timingtsec[stage] = timing.tsec[stage];
+        *timingMBmoved += timing.bytes[stage] / 1024.0 / 1024.0;
     }
-
+    *timingpeakMB = linARfilterPred_timing_peakMB();
+    linARfilterPred_timing_stream(&timing, timingname, &IDtiming);
 
     struct timespec t2;
     clock_gettime(CLOCK_REALTIME, &t2);
@@ -807,13 +3002,22 @@ static errno_t compute_function()
 
     INSERT_STD_PROCINFO_COMPUTEFUNC_END
 
-    free(pixarray_x);
-    free(pixarray_y);
-    free(pixarray_xy);
+    linARfilterPred_gram_eigen_free(ws.solveeig, 1);
+    linARfilterPred_gram_eigen_free(ws.localeig, NBthread * ws.NBlocaleig);
+    linARfilterPred_gram_eigen_free(ws.orderscaneig, *PForder);
+    linARfilterPred_arena_free(&orderscanarena);
+    linARfilterPred_arena_free(&arena);
+
+    if(subspace.V != NULL)
+    {
+        linARfilterPred_subspace_free(&subspace);
+    }
 
-    free(outpixarray_x);
-    free(outpixarray_y);
-    free(outpixarray_xy);
+    if(LOCALmode == 1)
+    {
+        free(nbrowptr);
+        free(nbpix);
+    }
 
     DEBUG_TRACE_FEXIT();
     return RETURN_SUCCESS;
@@ -3,4 +3,6 @@
 
 errno_t CLIADDCMD_LinARfilterPred__build_linPF();
 
+errno_t CLIADDCMD_LinARfilterPred__build_linPF_ooc();
+
 #endif
@@ -0,0 +1,880 @@
+/**
+ * @file build_linPF_ooc.c
+ * @brief Build predictive filter from telemetry file (out-of-core)
+ *
+ * Telemetry is memory-mapped from a FITS file (32-bit float, primary HDU)
+ * or a raw 32-bit float file, and processed in chunks of .chunksize
+ * samples. Normal-equation statistics are accumulated chunk by chunk
+ * (see linPF_gram.c), so memory use is set by the chunk size and filter
+ * dimensions, not by the telemetry length. While a chunk is accumulated,
+ * the next one is read into a second buffer by a background thread.
+ *
+ * Consecutive chunks overlap by PForder+PFlatency+1 frames, so that every
+ * sample is complete within a single chunk. Samples spanning invalid
+ * frames (.segments, .validmask) are skipped, see linPF_valid.c.
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <fitsio.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "COREMOD_iofits/COREMOD_iofits.h"
+
+#include "linPF_gram.h"
+#include "linPF_valid.h"
+
+
+
+
+static char *infile;
+
+static uint32_t *rawxsize;
+static long      fpi_rawxsize;
+
+static uint32_t *rawysize;
+static long      fpi_rawysize;
+
+static uint32_t *PForder;
+static long      fpi_PForder;
+
+static float *PFlatency;
+static long   fpi_PFlatency;
+
+static double *SVDeps;
+static long    fpi_SVDeps;
+
+static double *reglambda;
+static long    fpi_reglambda;
+
+static uint64_t *DCmode;
+static long      fpi_DCmode;
+
+static uint32_t *chunksize;
+static long      fpi_chunksize;
+
+static char *validmask;
+
+static char *segments;
+
+static char *outPFname;
+
+static char *outfile;
+
+static uint64_t *NBsample;
+static long      fpi_NBsample;
+
+static double *trainres;
+static long    fpi_trainres;
+
+
+
+
+static CLICMDARGDEF farg[] =
+{
+    {
+        // input telemetry file
+        CLIARG_FILENAME,
+        ".infile",
+        "input telemetry file (FITS or raw float)",
+        "telemetry.fits",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &infile,
+        NULL
+    },
+    {
+        // raw file frame size, ignored for FITS file
+        CLIARG_UINT32,
+        ".raw.xsize",
+        "raw file x size",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &rawxsize,
+        &fpi_rawxsize
+    },
+    {
+        CLIARG_UINT32,
+        ".raw.ysize",
+        "raw file y size",
+        "1",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &rawysize,
+        &fpi_rawysize
+    },
+    {
+        // temporal order of filter: number of time steps in state
+        CLIARG_UINT32,
+        ".PForder",
+        "predictive filter order",
+        "10",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &PForder,
+        &fpi_PForder
+    },
+    {
+        // latency: how far ahead to predict
+        CLIARG_FLOAT32,
+        ".PFlatency",
+        "time latency [frame]",
+        "2.7",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &PFlatency,
+        &fpi_PFlatency
+    },
+    {
+        // SVD limit
+        CLIARG_FLOAT64,
+        ".SVDeps",
+        "SVD cutoff",
+        "0.001",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &SVDeps,
+        &fpi_SVDeps
+    },
+    {
+        // Regularization
+        CLIARG_FLOAT64,
+        ".reglambda",
+        "regularization coefficient",
+        "0.0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &reglambda,
+        &fpi_reglambda
+    },
+    {
+        // remove time-averaged value of each input and output variable
+        CLIARG_ONOFF,
+        ".DCmode",
+        "remove average",
+        "0",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &DCmode,
+        &fpi_DCmode
+    },
+    {
+        // number of samples per chunk
+        CLIARG_UINT32,
+        ".chunksize",
+        "samples per chunk",
+        "10000",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &chunksize,
+        &fpi_chunksize
+    },
+    {
+        // per-frame validity, frame is used if value > 0.5
+        CLIARG_STR,
+        ".validmask",
+        "frame validity mask image",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &validmask,
+        NULL
+    },
+    {
+        // list of valid frame ranges, end excluded
+        CLIARG_STR,
+        ".segments",
+        "valid segments start:end,start:end",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &segments,
+        NULL
+    },
+    {
+        CLIARG_STR,
+        ".outPFname",
+        "output filter",
+        "outPF",
+        CLIARG_VISIBLE_DEFAULT,
+        (void **) &outPFname,
+        NULL
+    },
+    {
+        // optional FITS output
+        CLIARG_STR,
+        ".outfile",
+        "output filter FITS file",
+        "none",
+        CLIARG_HIDDEN_DEFAULT,
+        (void **) &outfile,
+        NULL
+    },
+    {
+        CLIARG_UINT64,
+        ".NBsample",
+        "number of training samples",
+        "0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &NBsample,
+        &fpi_NBsample
+    },
+    {
+        CLIARG_FLOAT64,
+        ".trainres",
+        "training residual per sample",
+        "0.0",
+        CLIARG_OUTPUT_DEFAULT,
+        (void **) &trainres,
+        &fpi_trainres
+    }
+};
+
+
+
+
+// Optional custom configuration setup. comptbuff
+// Runs once at conf startup
+//
+static errno_t customCONFsetup()
+{
+    if(data.fpsptr != NULL)
+    {
+    }
+
+    return RETURN_SUCCESS;
+}
+
+// Optional custom configuration checks.
+// Runs at every configuration check loop iteration
+//
+static errno_t customCONFcheck()
+{
+
+    if(data.fpsptr != NULL)
+    {
+    }
+
+    return RETURN_SUCCESS;
+}
+
+static CLICMDDATA CLIcmddata =
+{
+    "mkPFooc",
+    "make linear predictive filter from telemetry file",
+    CLICMD_FIELDS_DEFAULTS
+};
+
+
+
+
+// detailed help
+static errno_t help_function()
+{
+    printf("Build predictive filter from FITS or raw float telemetry file\n");
+    printf("File is memory-mapped and processed in chunks\n");
+    printf("Input and output masks are read from images inmask and outmask\n");
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Memory-mapped telemetry file
+ */
+typedef struct
+{
+    int            fd;
+    unsigned char *map;
+    size_t         mapsize;
+    unsigned char *dataptr;  ///< first frame
+    int            byteswap; ///< 1 if data is big-endian (FITS)
+    uint32_t       xsize;
+    uint32_t       ysize;
+    uint64_t       xysize;
+    long           NBframe;
+} OOC_TELEMETRY;
+
+
+/**
+ * @brief Chunk read request, executed by the prefetch thread
+ */
+typedef struct
+{
+    OOC_TELEMETRY *tm;
+    float         *buff;
+    long           frame0;
+    long           NBframe;
+} OOC_CHUNK;
+
+
+
+
+static errno_t ooc_telemetry_open(const char    *fname,
+                                  uint32_t       xsize,
+                                  uint32_t       ysize,
+                                  OOC_TELEMETRY *tm)
+{
+    tm->fd = open(fname, O_RDONLY);
+    if(tm->fd == -1)
+    {
+        PRINT_ERROR("cannot open file %s", fname);
+        return RETURN_FAILURE;
+    }
+
+    struct stat st;
+    if(fstat(tm->fd, &st) == -1)
+    {
+        PRINT_ERROR("cannot stat file %s", fname);
+        close(tm->fd);
+        return RETURN_FAILURE;
+    }
+    tm->mapsize = st.st_size;
+
+    tm->map = (unsigned char *) mmap(NULL,
+                                     tm->mapsize,
+                                     PROT_READ,
+                                     MAP_SHARED,
+                                     tm->fd,
+                                     0);
+    if(tm->map == MAP_FAILED)
+    {
+        PRINT_ERROR("mmap failed on file %s", fname);
+        close(tm->fd);
+        return RETURN_FAILURE;
+    }
+    madvise(tm->map, tm->mapsize, MADV_SEQUENTIAL);
+
+    if((tm->mapsize > 6) && (strncmp((char *) tm->map, "SIMPLE", 6) == 0))
+    {
+        // FITS file: locate data unit of primary HDU
+        fitsfile *fptr;
+        int       status = 0;
+        int       bitpix = 0;
+        int       naxis  = 0;
+        long      naxes[3] = {1, 1, 1};
+        LONGLONG  headstart;
+        LONGLONG  datastart;
+        LONGLONG  dataend;
+
+        fits_open_file(&fptr, fname, READONLY, &status);
+        fits_get_img_param(fptr, 3, &bitpix, &naxis, naxes, &status);
+        fits_get_hduaddrll(fptr, &headstart, &datastart, &dataend, &status);
+        fits_close_file(fptr, &status);
+        if(status != 0)
+        {
+            char errmsg[FLEN_ERRMSG];
+            fits_get_errstatus(status, errmsg);
+            PRINT_ERROR("FITS error on file %s: %s", fname, errmsg);
+            munmap(tm->map, tm->mapsize);
+            close(tm->fd);
+            return RETURN_FAILURE;
+        }
+        if((bitpix != FLOAT_IMG) || (naxis < 2) || (naxis > 3))
+        {
+            PRINT_ERROR("file %s: expecting 2D or 3D 32-bit float image", fname);
+            munmap(tm->map, tm->mapsize);
+            close(tm->fd);
+            return RETURN_FAILURE;
+        }
+
+        tm->dataptr = tm->map + datastart;
+        if(naxis == 2)
+        {
+            tm->xsize   = naxes[0];
+            tm->ysize   = 1;
+            tm->NBframe = naxes[1];
+        }
+        else
+        {
+            tm->xsize   = naxes[0];
+            tm->ysize   = naxes[1];
+            tm->NBframe = naxes[2];
+        }
+
+        // header sizes must fit in file, truncated files fault on read
+        if((uint64_t) datastart + sizeof(float) * tm->xsize * tm->ysize *
+                tm->NBframe > (uint64_t) tm->mapsize)
+        {
+            PRINT_ERROR("file %s: truncated, data unit exceeds file size",
+                        fname);
+            munmap(tm->map, tm->mapsize);
+            close(tm->fd);
+            return RETURN_FAILURE;
+        }
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        tm->byteswap = 1;
+#else
+        tm->byteswap = 0;
+#endif
+    }
+    else
+    {
+        // raw float file, native byte order
+        if(xsize * ysize == 0)
+        {
+            PRINT_ERROR("raw file %s: frame size must be set", fname);
+            munmap(tm->map, tm->mapsize);
+            close(tm->fd);
+            return RETURN_FAILURE;
+        }
+        tm->dataptr  = tm->map;
+        tm->xsize    = xsize;
+        tm->ysize    = ysize;
+        tm->NBframe  = tm->mapsize / (sizeof(float) * xsize * ysize);
+        tm->byteswap = 0;
+    }
+    tm->xysize = (uint64_t) tm->xsize * tm->ysize;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static errno_t ooc_telemetry_close(OOC_TELEMETRY *tm)
+{
+    munmap(tm->map, tm->mapsize);
+    close(tm->fd);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Apply madvise to frames frame0 .. frame0+NBframe-1
+ *
+ * The range is extended to page boundaries, within the mapping.
+ */
+static void ooc_telemetry_advise(OOC_TELEMETRY *tm,
+                                 long           frame0,
+                                 long           NBframe,
+                                 int            advice)
+{
+    if(NBframe < 1)
+    {
+        return;
+    }
+
+    size_t         pagesize = sysconf(_SC_PAGESIZE);
+    unsigned char *pstart =
+        tm->dataptr + sizeof(float) * tm->xysize * frame0;
+    unsigned char *pend = pstart + sizeof(float) * tm->xysize * NBframe;
+
+    pstart = tm->map + ((pstart - tm->map) / pagesize) * pagesize;
+    if(pend > tm->map + tm->mapsize)
+    {
+        pend = tm->map + tm->mapsize;
+    }
+    madvise(pstart, pend - pstart, advice);
+}
+
+
+
+
+/**
+ * @brief Copy chunk of frames from file to float buffer
+ *
+ * Thread function. Converts from big-endian if needed.
+ */
+static void *ooc_chunk_read(void *ptr)
+{
+    OOC_CHUNK     *chunk = (OOC_CHUNK *) ptr;
+    OOC_TELEMETRY *tm    = chunk->tm;
+
+    ooc_telemetry_advise(tm, chunk->frame0, chunk->NBframe, MADV_WILLNEED);
+
+    uint64_t       nelem = tm->xysize * chunk->NBframe;
+    unsigned char *src   = tm->dataptr + sizeof(float) * tm->xysize * chunk->frame0;
+
+    if(tm->byteswap == 1)
+    {
+        uint32_t *dst = (uint32_t *) chunk->buff;
+        for(uint64_t ii = 0; ii < nelem; ii++)
+        {
+            uint32_t val;
+            memcpy(&val, src + sizeof(uint32_t) * ii, sizeof(uint32_t));
+            dst[ii] = __builtin_bswap32(val);
+        }
+    }
+    else
+    {
+        memcpy(chunk->buff, src, sizeof(float) * nelem);
+    }
+
+    return NULL;
+}
+
+
+
+
+static errno_t compute_function()
+{
+    DEBUG_TRACE_FSTART();
+
+
+    OOC_TELEMETRY tm;
+    if(ooc_telemetry_open(infile, *rawxsize, *rawysize, &tm) != RETURN_SUCCESS)
+    {
+        DEBUG_TRACE_FEXIT();
+        return RETURN_FAILURE;
+    }
+    uint32_t xsize  = tm.xsize;
+    uint32_t ysize  = tm.ysize;
+    uint64_t xysize = tm.xysize;
+    printf("Telemetry file %s : %u x %u x %ld\n",
+           infile,
+           xsize,
+           ysize,
+           tm.NBframe);
+
+
+    /// ## Select input and output variables
+    /// Images inmask and outmask select active variables, as in mkPF.
+
+    long *pixarray_xy    = (long *) malloc(sizeof(long) * xysize);
+    long *outpixarray_xy = (long *) malloc(sizeof(long) * xysize);
+    if((pixarray_xy == NULL) || (outpixarray_xy == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    imageID IDinmask  = image_ID("inmask");
+    imageID IDoutmask = image_ID("outmask");
+    if(((IDinmask != -1) &&
+            (data.image[IDinmask].md[0].nelement != xysize)) ||
+            ((IDoutmask != -1) &&
+             (data.image[IDoutmask].md[0].nelement != xysize)))
+    {
+        PRINT_ERROR("inmask and outmask must have %lu elements, frame size",
+                    xysize);
+        free(pixarray_xy);
+        free(outpixarray_xy);
+        ooc_telemetry_close(&tm);
+        DEBUG_TRACE_FEXIT();
+        return RETURN_FAILURE;
+    }
+
+    long NBpixin = 0;
+    for(uint32_t ii = 0; ii < xsize; ii++)
+        for(uint32_t jj = 0; jj < ysize; jj++)
+            if((IDinmask == -1) ||
+                    (data.image[IDinmask].array.F[jj * xsize + ii] > 0.5))
+            {
+                pixarray_xy[NBpixin] = jj * xsize + ii;
+                NBpixin++;
+            }
+
+    long NBpixout = 0;
+    for(uint32_t ii = 0; ii < xsize; ii++)
+        for(uint32_t jj = 0; jj < ysize; jj++)
+            if((IDoutmask == -1) ||
+                    (data.image[IDoutmask].array.F[jj * xsize + ii] > 0.5))
+            {
+                outpixarray_xy[NBpixout] = jj * xsize + ii;
+                NBpixout++;
+            }
+    printf("NBpixin  = %ld\n", NBpixin);
+    printf("NBpixout = %ld\n", NBpixout);
+
+
+    /// ## Accumulate normal equations chunk by chunk
+    ///
+    /// Sample m uses frames m .. m+PForder-1+PFlatency+1, so a chunk of
+    /// nrow samples starting at sample m0 needs frames m0 .. m0+nrow+overlap-1.
+
+    long NBmvec      = tm.NBframe - *PForder - (int)(*PFlatency) - 2;
+    long mvecsize    = NBpixin * (*PForder);
+    long overlap     = *PForder + (long)(*PFlatency) + 1;
+    long chunkNBmvec = *chunksize;
+    if(chunkNBmvec < 1)
+    {
+        chunkNBmvec = 1;
+    }
+    if(NBmvec < 1)
+    {
+        PRINT_ERROR("not enough frames (%ld) for order %u and latency %f",
+                    tm.NBframe,
+                    *PForder,
+                    *PFlatency);
+        free(pixarray_xy);
+        free(outpixarray_xy);
+        ooc_telemetry_close(&tm);
+        DEBUG_TRACE_FEXIT();
+        return RETURN_FAILURE;
+    }
+    uint8_t *framevalid  = (uint8_t *) malloc(sizeof(uint8_t) * tm.NBframe);
+    uint8_t *samplevalid = (uint8_t *) malloc(sizeof(uint8_t) * NBmvec);
+    long    *NBinvalid   = (long *) malloc(sizeof(long) * (tm.NBframe + 1));
+    if((framevalid == NULL) || (samplevalid == NULL) || (NBinvalid == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    long NBframevalid = linARfilterPred_valid_frames(tm.NBframe,
+                        segments,
+                        image_ID(validmask),
+                        framevalid);
+    long NBmvecvalid = linARfilterPred_valid_samples(tm.NBframe,
+                       framevalid,
+                       NBmvec,
+                       overlap,
+                       samplevalid,
+                       NBinvalid);
+    free(framevalid);
+    free(NBinvalid);
+    printf("Valid frames  : %ld / %ld\n", NBframevalid, tm.NBframe);
+    printf("Valid samples : %ld / %ld\n", NBmvecvalid, NBmvec);
+
+    // gram.NBsample is the number of valid samples: without any, the
+    // averages and residual are undefined, and a zero filter would be
+    // written over outPFname
+    if(NBmvecvalid == 0)
+    {
+        PRINT_ERROR("no valid sample, check .segments and .validmask");
+        free(samplevalid);
+        free(pixarray_xy);
+        free(outpixarray_xy);
+        ooc_telemetry_close(&tm);
+        DEBUG_TRACE_FEXIT();
+        return RETURN_FAILURE;
+    }
+
+    long NBchunk = (NBmvec + chunkNBmvec - 1) / chunkNBmvec;
+    printf("NBmvec = %ld in %ld chunks of %ld samples\n",
+           NBmvec,
+           NBchunk,
+           chunkNBmvec);
+
+    // double buffer: chunk being accumulated, and chunk being read
+    float *chunkbuff[2];
+    for(int b = 0; b < 2; b++)
+    {
+        chunkbuff[b] = (float *) malloc(sizeof(float) * xysize *
+                                        (chunkNBmvec + overlap));
+        if(chunkbuff[b] == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+    }
+
+    LINARFILTERPRED_GRAM gram;
+    linARfilterPred_gram_init(&gram, mvecsize, NBpixout);
+
+    double *W = (double *) malloc(sizeof(double) * NBpixout * mvecsize);
+    if(W == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_START
+
+    linARfilterPred_gram_reset(&gram);
+
+    OOC_CHUNK chunk[2];
+    chunk[0].tm      = &tm;
+    chunk[0].buff    = chunkbuff[0];
+    chunk[0].frame0  = 0;
+    chunk[0].NBframe = ((NBmvec < chunkNBmvec) ? NBmvec : chunkNBmvec) + overlap;
+    ooc_chunk_read(&chunk[0]);
+
+    for(long c = 0; c < NBchunk; c++)
+    {
+        int  b    = c % 2;
+        long m0   = c * chunkNBmvec;
+        long nrow = NBmvec - m0;
+        if(nrow > chunkNBmvec)
+        {
+            nrow = chunkNBmvec;
+        }
+
+        // start reading next chunk
+        pthread_t readthread;
+        int       readactive = 0;
+        if(c + 1 < NBchunk)
+        {
+            long m1    = m0 + chunkNBmvec;
+            long nrow1 = NBmvec - m1;
+            if(nrow1 > chunkNBmvec)
+            {
+                nrow1 = chunkNBmvec;
+            }
+            chunk[1 - b].tm      = &tm;
+            chunk[1 - b].buff    = chunkbuff[1 - b];
+            chunk[1 - b].frame0  = m1;
+            chunk[1 - b].NBframe = nrow1 + overlap;
+            if(pthread_create(&readthread, NULL, ooc_chunk_read, &chunk[1 - b]) ==
+                    0)
+            {
+                readactive = 1;
+            }
+            else
+            {
+                ooc_chunk_read(&chunk[1 - b]);
+            }
+        }
+
+        linARfilterPred_gram_accumulate_valid(&gram,
+                                              chunkbuff[b],
+                                              xysize,
+                                              NBpixin,
+                                              pixarray_xy,
+                                              NBpixout,
+                                              outpixarray_xy,
+                                              *PForder,
+                                              *PFlatency,
+                                              0,
+                                              nrow,
+                                              &samplevalid[m0]);
+
+        if(readactive == 1)
+        {
+            pthread_join(readthread, NULL);
+        }
+
+        // frames before next chunk are no longer needed
+        ooc_telemetry_advise(&tm, m0, chunkNBmvec, MADV_DONTNEED);
+
+        printf("\r chunk %6ld / %6ld  ", c + 1, NBchunk);
+        fflush(stdout);
+    }
+    printf("\n");
+
+
+    /// ## Solve normal equations
+    ///
+    /// Averages are the column means of the statistics, removed
+    /// analytically. Regularization adds reglambda^2 to the diagonal of G.
+
+    linARfilterPred_gram_symmetrize(&gram);
+    if(*DCmode == 1)
+    {
+        double *ave_inarray  = (double *) malloc(sizeof(double) * NBpixin);
+        double *ave_outarray = (double *) malloc(sizeof(double) * NBpixout);
+        if((ave_inarray == NULL) || (ave_outarray == NULL))
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        for(long pix = 0; pix < NBpixin; pix++)
+        {
+            ave_inarray[pix] = gram.sumx[pix] / gram.NBsample;
+        }
+        for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+        {
+            ave_outarray[PFpix] = gram.sumy[PFpix] / gram.NBsample;
+        }
+        linARfilterPred_gram_center(&gram, NBpixin, ave_inarray, ave_outarray);
+        free(ave_inarray);
+        free(ave_outarray);
+    }
+
+    double reg2 = (*reglambda) * (*reglambda);
+    for(long ii = 0; ii < mvecsize; ii++)
+    {
+        gram.G[ii * mvecsize + ii] += reg2;
+    }
+
+    long NBmodekept = linARfilterPred_gram_solve(gram.G,
+                      mvecsize,
+                      gram.C,
+                      NBpixout,
+                      *SVDeps,
+                      W);
+    printf("%ld / %ld modes kept\n", NBmodekept, mvecsize);
+
+    for(long ii = 0; ii < mvecsize; ii++)
+    {
+        gram.G[ii * mvecsize + ii] -= reg2;
+    }
+    *NBsample = gram.NBsample;
+    *trainres = linARfilterPred_gram_residual(&gram, W, mvecsize) / gram.NBsample;
+    printf("Training residual = %g\n", *trainres);
+
+
+    /// ## Write output filter
+    /// Same 2D format as mkPF output
+
+    imageID IDoutPF2D = image_ID(outPFname);
+    if(IDoutPF2D != -1)
+    {
+        if((data.image[IDoutPF2D].md[0].nelement != (uint64_t) mvecsize * NBpixout)
+                || (data.image[IDoutPF2D].md[0].datatype != _DATATYPE_FLOAT))
+        {
+            delete_image_ID(outPFname, DELETE_IMAGE_ERRMODE_WARNING);
+            IDoutPF2D = -1;
+        }
+    }
+    if(IDoutPF2D == -1)
+    {
+        uint32_t *imsizearray = (uint32_t *) malloc(sizeof(uint32_t) * 2);
+        if(imsizearray == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        imsizearray[0] = mvecsize;
+        imsizearray[1] = NBpixout;
+        create_image_ID(outPFname,
+                        2,
+                        imsizearray,
+                        _DATATYPE_FLOAT,
+                        1,
+                        1,
+                        0,
+                        &IDoutPF2D);
+        free(imsizearray);
+    }
+
+    data.image[IDoutPF2D].md[0].write = 1;
+    for(long ii = 0; ii < NBpixout * mvecsize; ii++)
+    {
+        data.image[IDoutPF2D].array.F[ii] = W[ii];
+    }
+    COREMOD_MEMORY_image_set_sempost_byID(IDoutPF2D, -1);
+    data.image[IDoutPF2D].md[0].cnt0++;
+    data.image[IDoutPF2D].md[0].write = 0;
+
+    if(strcmp(outfile, "none") != 0)
+    {
+        save_fits(outPFname, outfile);
+    }
+
+    INSERT_STD_PROCINFO_COMPUTEFUNC_END
+
+    free(W);
+    linARfilterPred_gram_free(&gram);
+    free(chunkbuff[0]);
+    free(chunkbuff[1]);
+    free(samplevalid);
+    ooc_telemetry_close(&tm);
+    free(pixarray_xy);
+    free(outpixarray_xy);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+INSERT_STD_FPSCLIfunctions
+
+
+
+// Register function in CLI
+errno_t
+CLIADDCMD_LinARfilterPred__build_linPF_ooc()
+{
+
+    CLIcmddata.FPS_customCONFsetup = customCONFsetup;
+    CLIcmddata.FPS_customCONFcheck = customCONFcheck;
+    INSERT_STD_CLIREGISTERFUNC
+
+    return RETURN_SUCCESS;
+}
@@ -61,6 +61,13 @@
 
 #include "build_linPF.h"
 #include "applyPF.h"
+#include "linPF_mvm.h"
+#include "linPF_rtpool.h"
+#include "linPF_runs.h"
+#include "linPF_sched.h"
+#include "linPF_sparse.h"
+#include "linPF_tfir.h"
+#include "linPF_wait.h"
 
 
 
@@ -351,6 +358,7 @@ static errno_t init_module_CLI()
 
 
     CLIADDCMD_LinARfilterPred__build_linPF();
+    CLIADDCMD_LinARfilterPred__build_linPF_ooc();
     CLIADDCMD_LinARfilterPred__applyPF();
 
     // add atexit functions here
@@ -943,6 +951,12 @@ imageID LINARFILTERPRED_Build_LinPredictor(const char *IDin_name,
         printf("PSINV_tol = %f\n", PSINV_tol);
     }
 
+    if((IDv = variable_ID("_PF_DCMODE")) != -1)
+    {
+        DC_MODE = (int)(data.variable[IDv].value.f + 0.1);
+        printf("DC_MODE = %d\n", DC_MODE);
+    }
+
     /// ## Reading Parameters from Image
 
     /// If image named <IDoutPF_name>_PFparam exists, the predictive filter
@@ -1247,6 +1261,10 @@ imageID LINARFILTERPRED_Build_LinPredictor(const char *IDin_name,
         COREMOD_MEMORY_image_set_semflush(IDin_name, semtrig);
     }
 
+    // Future measured data matrix, created once and re-used by all iterations
+    imageID IDfm;
+    create_2Dimage_ID("PFfmdat", NBmvec, NBpixout, &IDfm);
+
     for(iter = 0; iter < NBiter; iter++)
     {
 
@@ -1298,39 +1316,43 @@ imageID LINARFILTERPRED_Build_LinPredictor(const char *IDin_name,
         ///
         /// Necessary as input may be continuously changing between consecutive loop iterations.
         ///
+        /// If DC_MODE==1 (variable _PF_DCMODE), the average value of each
+        /// variable is updated frame by frame during the copy (running mean).
+        ///
         IDincp = image_ID("PFin_copy");
-        memcpy(data.image[IDincp].array.F,
-               data.image[IDin].array.F,
-               sizeof(float) * inNBelem);
-
-        //save_fits("PFin_copy", "test_PFin_copy.fits");
-        //save_fits(IDin_name, "test_PFin.fits");
-
-        clock_gettime(CLOCK_REALTIME, &t1);
-
-        /// *STEP: if DC_MODE==1, compute average value from each variable*
+        for(pix = 0; pix < NBpixin; pix++)
+        {
+            ave_inarray[pix] = 0.0;
+        }
         if(DC_MODE == 1)  // remove average
         {
-            for(pix = 0; pix < NBpixin; pix++)
+            for(m = 0; m < nbspl; m++)
             {
-                ave_inarray[pix] = 0.0;
-                for(m = 0; m < nbspl; m++)
+                float *frame = &data.image[IDincp].array.F[m * xysize];
+                memcpy(frame,
+                       &data.image[IDin].array.F[m * xysize],
+                       sizeof(float) * xysize);
+
+                double invcnt = 1.0 / (m + 1);
+                for(pix = 0; pix < NBpixin; pix++)
                 {
                     ave_inarray[pix] +=
-                        data.image[IDincp]
-                        .array.F[m * xysize + pixarray_xy[pix]];
+                        (frame[pixarray_xy[pix]] - ave_inarray[pix]) * invcnt;
                 }
-                ave_inarray[pix] /= nbspl;
             }
         }
         else
         {
-            for(pix = 0; pix < NBpixin; pix++)
-            {
-                ave_inarray[pix] = 0.0;
-            }
+            memcpy(data.image[IDincp].array.F,
+                   data.image[IDin].array.F,
+                   sizeof(float) * inNBelem);
         }
 
+        //save_fits("PFin_copy", "test_PFin_copy.fits");
+        //save_fits(IDin_name, "test_PFin.fits");
+
+        clock_gettime(CLOCK_REALTIME, &t1);
+
         ///
         /// *STEP: Fill up data matrix PFmatD from input telemetry*
         ///
@@ -1380,9 +1402,6 @@ imageID LINARFILTERPRED_Build_LinPredictor(const char *IDin_name,
         fflush(stdout);
 
         // Assemble future measured data matrix
-        imageID IDfm;
-        create_2Dimage_ID("PFfmdat", NBmvec, NBpixout, &IDfm);
-
         alpha = PFlag_run - ((long) PFlag_run);
         for(PFpix = 0; PFpix < NBpixout; PFpix++)
             for(m = 0; m < NBmvec; m++)
@@ -1556,7 +1575,6 @@ imageID LINARFILTERPRED_Build_LinPredictor(const char *IDin_name,
         {
             printf("------------------- Using GPU-computed PF matrix\n");
         }
-        delete_image_ID("PFfmdat", DELETE_IMAGE_ERRMODE_WARNING);
 
         if(LOOPmode == 1)
         {
@@ -1650,6 +1668,8 @@ imageID LINARFILTERPRED_Build_LinPredictor(const char *IDin_name,
 
     // free(valfarray);
 
+    delete_image_ID("PFfmdat", DELETE_IMAGE_ERRMODE_WARNING);
+
     free(pixarray_x);
     free(pixarray_y);
     free(pixarray_xy);
@@ -1692,6 +1712,8 @@ imageID LINARFILTERPRED_Apply_LinPredictor_RT(const char *IDfilt_name,
     int       semtrig = 7;
 
     float *inarray;
+    float *inhist;  // most recent input first, in inarray ring
+    long   inhead = 0;
     float *outarray;
 
     //    long ii; // input index
@@ -1740,7 +1762,11 @@ imageID LINARFILTERPRED_Apply_LinPredictor_RT(const char *IDfilt_name,
     printf("Done\n");
     fflush(stdout);
 
-    inarray = (float *) malloc(sizeof(float) * NBpix_in * PForder);
+    // input history ring of 2 x PForder time steps
+    // each input is written to slot inhead and to mirror slot
+    // inhead+PForder, so that the PForder most recent inputs are
+    // contiguous from slot inhead : no shift of older inputs is needed
+    inarray = (float *) calloc(NBpix_in * PForder * 2, sizeof(float));
     if(inarray == NULL)
     {
         PRINT_ERROR("malloc returns NULL pointer");
@@ -1765,12 +1791,10 @@ imageID LINARFILTERPRED_Apply_LinPredictor_RT(const char *IDfilt_name,
             outarray[jj] = 0.0;
         }
 
-        // shift input buffer entries back one time step
-        for(uint32_t kk = PForder - 1; kk > 0; kk--)
-            for(uint32_t ii = 0; ii < NBpix_in; ii++)
-            {
-                inarray[kk * NBpix_in + ii] = inarray[(kk - 1) * NBpix_in + ii];
-            }
+        // move ring head back one time step
+        // slot inhead now holds the oldest input, overwritten below
+        inhead = (inhead + PForder - 1) % PForder;
+        inhist = &inarray[inhead * NBpix_in];
 
         // multiply input by prediction matrix .. except for measurement yet to come
         for(uint32_t jj = 0; jj < NBpix_out; jj++)
@@ -1780,15 +1804,16 @@ imageID LINARFILTERPRED_Apply_LinPredictor_RT(const char *IDfilt_name,
                     outarray[jj] +=
                         data.image[IDfilt].array.F[kk * NBpix_in * NBpix_out +
                                                    jj * NBpix_in + ii] *
-                        inarray[kk * NBpix_in + ii];
+                        inhist[kk * NBpix_in + ii];
                 }
 
         sem_wait(data.image[IDin].semptr[semtrig]);
 
-        // write new input in inarray vector
+        // write new input in inarray ring, and its mirror slot
         for(uint32_t ii = 0; ii < NBpix_in; ii++)
         {
-            inarray[ii] = data.image[IDin].array.F[ii];
+            inhist[ii]                      = data.image[IDin].array.F[ii];
+            inhist[PForder * NBpix_in + ii] = inhist[ii];
         }
 
         // multiply input by prediction matrix
@@ -1796,7 +1821,7 @@ imageID LINARFILTERPRED_Apply_LinPredictor_RT(const char *IDfilt_name,
             for(uint32_t ii = 0; ii < NBpix_in; ii++)
             {
                 outarray[jj] += data.image[IDfilt].array.F[jj * NBpix_in + ii] *
-                                inarray[ii];
+                                inhist[ii];
             }
 
         data.image[IDout].md[0].write = 1;
@@ -2024,6 +2049,9 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
     imageID IDPFM;
 
     imageID   IDINbuff;
+    int       INbuffring; // 1 if INbuffer is a ring, see below
+    long      INbuffhead = 0;
+    float    *INhist;     // most recent input first
     long      tstep;
     uint32_t *sizearray;
     uint8_t   naxis;
@@ -2062,6 +2090,10 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
     imageID IDoutmask;
     long   *outmaskindex;
     long    NBoutmaskpix;
+
+    // masked input and output copies, see linPF_runs.c
+    LINARFILTERPRED_RUNS INruns;
+    LINARFILTERPRED_RUNS OUTruns = {0, NULL, NULL, NULL};
     long    kk0, kk1;
     float   val, val0, val1;
     long    ii0, ii1;
@@ -2072,8 +2104,55 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
     IDmodevalIN = image_ID(IDmodevalIN_name);
     NBmodeIN0   = data.image[IDmodevalIN].md[0].size[0];
 
+    // Sparse filter <IDPFM_name>_sp* (CSR, see linPF_sparse.c) is used
+    // instead of the 2D filter matrix if it exists : only the existing
+    // filter taps are applied
+    imageID IDPFMsprow;
+    imageID IDPFMspcol;
+    imageID IDPFMspval;
+    long    PFMncol;
+
+    // private copy of sparse filter, updated between frames
+    LINARFILTERPRED_SPARSESNAP PFMspsnap;
     IDPFM     = image_ID(IDPFM_name);
-    NBmodeOUT = data.image[IDPFM].md[0].size[1];
+    NBmodeOUT = linARfilterPred_sparse_connect(IDPFM_name,
+                &IDPFMsprow,
+                &IDPFMspcol,
+                &IDPFMspval);
+    if(NBmodeOUT > 0)
+    {
+        linARfilterPred_sparse_snapinit(&PFMspsnap,
+                                        NBmodeOUT,
+                                        IDPFMsprow,
+                                        IDPFMspcol,
+                                        IDPFMspval);
+
+        // number of time steps from the 2D filter if it exists, as the
+        // sparse filter support may change when it is updated
+        if(IDPFM != -1)
+        {
+            PFMncol = data.image[IDPFM].md[0].size[0];
+        }
+        else
+        {
+            PFMncol = linARfilterPred_sparse_ncol(NBmodeOUT,
+                                                  PFMspsnap.sprow,
+                                                  PFMspsnap.spcol);
+        }
+        printf("Using sparse filter %s_sp*\n", IDPFM_name);
+        if(nbGPU > 0)
+        {
+            printf("Sparse filter not supported on GPU -> using CPU\n");
+            nbGPU = 0;
+        }
+    }
+    else
+    {
+        // incomplete sparse filter is not used
+        IDPFMsprow = -1;
+        NBmodeOUT  = data.image[IDPFM].md[0].size[1];
+        PFMncol    = data.image[IDPFM].md[0].size[0];
+    }
 
     sprintf(imname, "aol%ld_modevalPF", loop);
     IDmasterout = image_ID(imname);
@@ -2123,12 +2202,32 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
 
         for(uint32_t ii = 0; ii < data.image[IDinmask].md[0].size[0]; ii++)
         {
-            inmaskindex[NBinmaskpix] = ii;
+            inmaskindex[ii] = ii;
         }
     }
     NBmodeIN = NBinmaskpix;
+    linARfilterPred_runs_init(&INruns, inmaskindex, NBmodeIN);
 
-    NBPFstep = data.image[IDPFM].md[0].size[0] / NBmodeIN;
+    // Packed filter columns may not fill the last time step. The dense
+    // filter is read NBmodeIN x NBPFstep columns per row, which must then
+    // be its row size.
+    if(IDPFMsprow != -1)
+    {
+        NBPFstep = (PFMncol + NBmodeIN - 1) / NBmodeIN;
+    }
+    else
+    {
+        if(PFMncol % NBmodeIN != 0)
+        {
+            PRINT_ERROR("filter %s row size %ld is not a multiple of the "
+                        "number of active input modes %ld",
+                        IDPFM_name,
+                        PFMncol,
+                        NBmodeIN);
+            return -1;
+        }
+        NBPFstep = PFMncol / NBmodeIN;
+    }
 
     printf("Number of input modes         = %ld\n", NBmodeIN0);
     printf("Number of active input modes  = %ld\n", NBmodeIN);
@@ -2178,9 +2277,21 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
             list_image_ID();
             exit(0);
         }
-    }
-
-    create_2Dimage_ID("INbuffer", NBmodeIN, NBPFstep, &IDINbuff);
+        linARfilterPred_runs_init(&OUTruns, outmaskindex, NBmodeOUT);
+    }
+
+    // Input history buffer
+    // On CPU, INbuffer is a ring of 2 x NBPFstep time steps: each input is
+    // written to slot INbuffhead and to mirror slot INbuffhead+NBPFstep, so
+    // that the NBPFstep most recent inputs are contiguous from INbuffhead,
+    // without shifting older inputs. INbuffhead is written to cnt1.
+    // GPU MVM reads the whole INbuffer stream, which is shifted instead.
+    INbuffring = (nbGPU == 0) ? 1 : 0;
+    create_2Dimage_ID("INbuffer",
+                      NBmodeIN,
+                      (1 + INbuffring) * NBPFstep,
+                      &IDINbuff);
+    INhist = data.image[IDINbuff].array.F;
 
     sizearray = (uint32_t *) malloc(sizeof(uint32_t) * 2);
     if(sizearray == NULL)
@@ -2246,6 +2357,67 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
         printf("Using CPU\n");
     }
 
+    // CPU MVM kernel, selected for this CPU, see linPF_mvm.c
+    const char              *mvmname;
+    LINARFILTERPRED_MVM_FUNC mvmfunc = linARfilterPred_mvm_select("auto", &mvmname);
+    printf("CPU MVM kernel : %s\n", mvmname);
+
+    // CPU device set, read from ./conf/param_PFb<PFindex>CPUset.txt,
+    // for example "2-5" : each CPU runs a pinned worker thread computing
+    // its slice of output modes, see linPF_rtpool.c
+    LINARFILTERPRED_RTPOOL rtpool;
+    rtpool.NBworker = 0;
+    if((nbGPU == 0) && (IDPFMsprow == -1))
+    {
+        char CPUsetfname[200];
+        sprintf(CPUsetfname, "./conf/param_PFb%ldCPUset.txt", PFindex);
+        fp = fopen(CPUsetfname, "r");
+        if(fp != NULL)
+        {
+            char CPUsetstr[200];
+            if(fscanf(fp, "%199s", CPUsetstr) == 1)
+            {
+                int  CPUset[LINPF_SCHED_NBCPUMAX];
+                long NBCPU = linARfilterPred_sched_cpuset_parse(CPUsetstr,
+                             CPUset,
+                             LINPF_SCHED_NBCPUMAX);
+                if(NBCPU > 0)
+                {
+                    linARfilterPred_rtpool_create(&rtpool,
+                                                  CPUset,
+                                                  NBCPU,
+                                                  mvmfunc,
+                                                  NBmodeOUT,
+                                                  NBmodeIN,
+                                                  NBmodeIN * NBPFstep,
+                                                  data.image[IDPFM].md[0].size[0],
+                                                  data.image[IDPFM].array.F,
+                                                  &data.image[IDPFM].md[0].cnt0,
+                                                  data.image[IDPFout].array.F);
+                    printf("Using %ld CPU workers\n", NBCPU);
+                }
+            }
+            fclose(fp);
+        }
+    }
+
+    // Single CPU thread: split apply, the older inputs contribution is
+    // computed after each output, see linPF_tfir.c
+    LINARFILTERPRED_TFIR tfir;
+    int                  tfiron = 0;
+    if((nbGPU == 0) && (IDPFMsprow == -1) && (rtpool.NBworker == 0))
+    {
+        linARfilterPred_tfir_init(&tfir,
+                                  mvmfunc,
+                                  NBmodeOUT,
+                                  NBmodeIN,
+                                  NBmodeIN * NBPFstep,
+                                  data.image[IDPFM].md[0].size[0],
+                                  data.image[IDPFM].array.F,
+                                  &data.image[IDPFM].md[0].cnt0);
+        tfiron = 1;
+    }
+
     iter = 0;
     if(SAVEMODE > 0)
         if(NBiter > 50000)
@@ -2270,25 +2442,77 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
     //	clock_gettime(CLOCK_REALTIME, &timenow);
     //	timesec0 = 3600.0*uttime->tm_hour  + 60.0*uttime->tm_min + 1.0*(timenow.tv_sec % 60) + 1.0e-9*timenow.tv_nsec;
 
-    printf("Running on semaphore trigger %d of image %s\n",
+    // Input wait strategy
+    // If ./conf/param_PFb<PFindex>waitspinus.txt exists, the loop polls
+    // the input cnt0 instead of sleeping on the semaphore, for up to the
+    // spin budget [us] written in the file (0: no limit), see linPF_wait.c
+    LINARFILTERPRED_WAIT waitctrl;
+    {
+        int    waitmode     = LINPF_WAIT_SEM;
+        double spinbudgetus = 0.0;
+        char   waitfname[200];
+        sprintf(waitfname, "./conf/param_PFb%ldwaitspinus.txt", PFindex);
+        fp = fopen(waitfname, "r");
+        if(fp != NULL)
+        {
+            if(fscanf(fp, "%lf", &spinbudgetus) == 1)
+            {
+                waitmode = LINPF_WAIT_SPIN;
+            }
+            fclose(fp);
+        }
+        linARfilterPred_wait_init(&waitctrl,
+                                  waitmode,
+                                  spinbudgetus,
+                                  data.image[IDmodevalIN].md[0].cnt0);
+    }
+
+    printf("Running on semaphore trigger %d of image %s, wait mode %s\n",
            semtrig,
-           data.image[IDmodevalIN].md[0].name);
+           data.image[IDmodevalIN].md[0].name,
+           linARfilterPred_wait_modename(waitctrl.mode));
 
     while(iter != NBiter)
     {
         //	printf("iter %5ld / %5ld", iter, NBiter);
         //	fflush(stdout);
 
-        sem_wait(data.image[IDmodevalIN].semptr[semtrig]);
+        if(waitctrl.mode == LINPF_WAIT_SPIN)
+        {
+            linARfilterPred_wait_frame(&waitctrl,
+                                       data.image[IDmodevalIN].md,
+                                       data.image[IDmodevalIN].semptr[semtrig]);
+        }
+        else
+        {
+            sem_wait(data.image[IDmodevalIN].semptr[semtrig]);
+            linARfilterPred_wait_latency(&waitctrl,
+                                         LINPF_WAIT_SEM,
+                                         data.image[IDmodevalIN].md);
+        }
         //	printf("\n");
         //	fflush(stdout);
 
         // fill in buffer
-        for(mode = 0; mode < NBmodeIN; mode++)
+        if(INbuffring == 1)
+        {
+            INbuffhead = (INbuffhead + NBPFstep - 1) % NBPFstep;
+            INhist     = &data.image[IDINbuff].array.F[NBmodeIN * INbuffhead];
+            linARfilterPred_runs_gather(
+                &INruns,
+                &data.image[IDmodevalIN].array.F[IndexOffset],
+                INhist);
+            memcpy(&INhist[NBmodeIN * NBPFstep],
+                   INhist,
+                   sizeof(float) * NBmodeIN);
+            data.image[IDINbuff].md[0].cnt1 = INbuffhead;
+        }
+        else
         {
-            data.image[IDINbuff].array.F[mode] =
-                data.image[IDmodevalIN]
-                .array.F[IndexOffset + inmaskindex[mode]];
+            linARfilterPred_runs_gather(
+                &INruns,
+                &data.image[IDmodevalIN].array.F[IndexOffset],
+                INhist);
         }
 
         //
@@ -2332,23 +2556,51 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
         {
             // compute output : matrix vector mult with a CPU-based loop
             data.image[IDPFout].md[0].write = 1;
-            for(mode = 0; mode < NBmodeOUT; mode++)
+            if(IDPFMsprow != -1)
             {
-                data.image[IDPFout].array.F[mode] = 0.0;
-                for(uint32_t ii = 0; ii < NBmodeIN * NBPFstep; ii++)
-                {
-                    data.image[IDPFout].array.F[mode] +=
-                        data.image[IDINbuff].array.F[ii] *
-                        data.image[IDPFM]
-                        .array
-                        .F[mode * data.image[IDPFM].md[0].size[0] + ii];
-                }
+                linARfilterPred_sparse_mvm(NBmodeOUT,
+                                           PFMspsnap.sprow,
+                                           PFMspsnap.spcol,
+                                           PFMspsnap.spval,
+                                           INhist,
+                                           data.image[IDPFout].array.F);
+            }
+            else if(rtpool.NBworker > 0)
+            {
+                linARfilterPred_rtpool_run(&rtpool, INhist);
+            }
+            else
+            {
+                linARfilterPred_tfir_output(&tfir,
+                                            INhist,
+                                            data.image[IDPFout].array.F);
             }
             COREMOD_MEMORY_image_set_sempost_byID(IDPFout, -1);
             data.image[IDPFout].md[0].write = 0;
             data.image[IDPFout].md[0].cnt0++;
         }
 
+        // master output is written and posted once, right after the MVM
+        if(IDmasterout != -1)
+        {
+            data.image[IDmasterout].md[0].write = 1;
+            linARfilterPred_runs_scatter(&OUTruns,
+                                         data.image[IDPFout].array.F,
+                                         data.image[IDmasterout].array.F);
+            COREMOD_MEMORY_image_set_sempost_byID(IDmasterout, -1);
+            data.image[IDmasterout].md[0].write = 0;
+            data.image[IDmasterout].md[0].cnt0++;
+        }
+
+        if(tfiron == 1)
+        {
+            linARfilterPred_tfir_prepare(&tfir, INhist);
+        }
+        if(IDPFMsprow != -1)
+        {
+            linARfilterPred_sparse_snapupdate(&PFMspsnap);
+        }
+
         if(iter == 0)
         {
             /// measure time
@@ -2412,22 +2664,9 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
             //	fflush(stdout);
         }
 
-        if(IDmasterout != -1)
-        {
-            data.image[IDmasterout].md[0].write = 1;
-            for(mode = 0; mode < NBmodeOUT; mode++)
-            {
-                data.image[IDmasterout].array.F[outmaskindex[mode]] =
-                    data.image[IDPFout].array.F[mode];
-            }
-            COREMOD_MEMORY_image_set_sempost_byID(IDmasterout, -1);
-            data.image[IDmasterout].md[0].write = 0;
-            data.image[IDmasterout].md[0].cnt0++;
-        }
-
         iter++;
 
-        if(iter != NBiter)
+        if((iter != NBiter) && (INbuffring == 0))
         {
             // do this now to save time when semaphore is posted
             for(tstep = NBPFstep - 1; tstep > 0; tstep--)
@@ -2443,8 +2682,33 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
         }
     }
     printf("LOOP done\n");
+    for(int mode = 0; mode < LINPF_WAIT_NBMODE; mode++)
+    {
+        if(waitctrl.NBwake[mode] > 0)
+        {
+            printf("wake by %-4s : %8lu frames, "
+                   "latency ave %8.2f us, max %8.2f us\n",
+                   linARfilterPred_wait_modename(mode),
+                   waitctrl.NBwake[mode],
+                   waitctrl.latsum[mode] / waitctrl.NBwake[mode],
+                   waitctrl.latmax[mode]);
+        }
+    }
     fflush(stdout);
 
+    if(rtpool.NBworker > 0)
+    {
+        linARfilterPred_rtpool_destroy(&rtpool);
+    }
+    if(tfiron == 1)
+    {
+        linARfilterPred_tfir_free(&tfir);
+    }
+    if(IDPFMsprow != -1)
+    {
+        linARfilterPred_sparse_snapfree(&PFMspsnap);
+    }
+
     // output ASCII file
     if(SAVEMODE == 1)
     {
@@ -2501,6 +2765,8 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
     }
 
     free(inmaskindex);
+    linARfilterPred_runs_free(&INruns);
+    linARfilterPred_runs_free(&OUTruns);
 
     if(SAVEMODE == 2)  // time shift predicted output into FITS output
     {
@@ -2527,7 +2793,7 @@ imageID LINARFILTERPRED_PF_RealTimeApply(const char *IDmodevalIN_name,
         save_fits("testPFTout", "testPFTout.fits");
     }
 
-    if(SAVEMODE > 0)
+    if((SAVEMODE > 0) || (IDmasterout != -1))
     {
         free(outmaskindex);
     }
@@ -0,0 +1,158 @@
+/**
+ * @file    linPF_arena.c
+ * @brief   Preallocated workspace arena for filter builds
+ *
+ * Build workspace arrays are carved out of a single memory block,
+ * allocated once before the compute loop. This covers the arrays of the
+ * Gram (1) solver, held-out scoring, local mode, order scan and monitor
+ * residual, whose iterations then do not allocate memory. See mkPF for
+ * the remaining allocations.
+ *
+ * The footprint is computed exactly by running the same sequence of
+ * linARfilterPred_arena_alloc() calls on a sizing arena (size 0), which
+ * only accumulates offsets, before allocating the real arena.
+ *
+ * The block is mapped anonymously, optionally with huge pages, and
+ * touched by the calling thread, so that pages are placed on its NUMA
+ * node (first-touch policy).
+ */
+
+#include <sys/mman.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_arena.h"
+
+
+// alignment of each allocation, in bytes (cache line, AVX-512 vector)
+#define ARENA_ALIGN 64
+
+// huge page size assumed for MAP_HUGETLB mappings
+#define ARENA_HUGEPAGESIZE (2UL * 1024 * 1024)
+
+
+
+
+/**
+ * @brief Initialize arena of size bytes
+ *
+ * If size is 0, the arena is a sizing arena: allocations return NULL and
+ * only advance the offset, which then holds the exact footprint.
+ *
+ * If hugepage is 1, explicit huge pages (MAP_HUGETLB) are tried first,
+ * then transparent huge pages are requested on a regular mapping.
+ */
+errno_t linARfilterPred_arena_init(LINARFILTERPRED_ARENA *arena,
+                                   size_t                 size,
+                                   int                    hugepage)
+{
+    DEBUG_TRACE_FSTART();
+
+    arena->base     = NULL;
+    arena->size     = 0;
+    arena->offset   = 0;
+    arena->hugepage = 0;
+
+    if(size == 0)
+    {
+        DEBUG_TRACE_FEXIT();
+        return RETURN_SUCCESS;
+    }
+
+    void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    if(hugepage == 1)
+    {
+        size_t sizehp = ((size + ARENA_HUGEPAGESIZE - 1) / ARENA_HUGEPAGESIZE) *
+                        ARENA_HUGEPAGESIZE;
+        ptr = mmap(NULL,
+                   sizehp,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                   -1,
+                   0);
+        if(ptr != MAP_FAILED)
+        {
+            size            = sizehp;
+            arena->hugepage = 1;
+        }
+        else
+        {
+            printf("Huge pages not available, using regular pages\n");
+        }
+    }
+#endif
+    if(ptr == MAP_FAILED)
+    {
+        ptr = mmap(NULL,
+                   size,
+                   PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS,
+                   -1,
+                   0);
+        if(ptr == MAP_FAILED)
+        {
+            PRINT_ERROR("mmap failed for %zu bytes", size);
+            abort();
+        }
+#ifdef MADV_HUGEPAGE
+        if(hugepage == 1)
+        {
+            madvise(ptr, size, MADV_HUGEPAGE);
+        }
+#endif
+    }
+
+    // first touch from calling thread
+    memset(ptr, 0, size);
+
+    arena->base = (char *) ptr;
+    arena->size = size;
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t linARfilterPred_arena_free(LINARFILTERPRED_ARENA *arena)
+{
+    if(arena->base != NULL)
+    {
+        munmap(arena->base, arena->size);
+    }
+    arena->base   = NULL;
+    arena->size   = 0;
+    arena->offset = 0;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Allocate nbytes from arena, aligned to ARENA_ALIGN
+ *
+ * Memory is released with the arena. Returns NULL for a sizing arena.
+ */
+void *linARfilterPred_arena_alloc(LINARFILTERPRED_ARENA *arena,
+                                  size_t                 nbytes)
+{
+    size_t offset = arena->offset;
+
+    arena->offset += ((nbytes + ARENA_ALIGN - 1) / ARENA_ALIGN) * ARENA_ALIGN;
+
+    if(arena->base == NULL)
+    {
+        return NULL;
+    }
+    if(arena->offset > arena->size)
+    {
+        PRINT_ERROR("arena overflow: %zu / %zu bytes", arena->offset, arena->size);
+        abort();
+    }
+
+    return (void *)(arena->base + offset);
+}
@@ -0,0 +1,30 @@
+/**
+ * @file    linPF_arena.h
+ * @brief   Preallocated workspace arena for filter builds
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_ARENA_H
+#define LINARFILTERPRED_LINPF_ARENA_H
+
+/** @brief Memory block from which workspace arrays are allocated
+ */
+typedef struct
+{
+    char  *base;     ///< start of block, NULL for sizing arena
+    size_t size;     ///< block size [byte]
+    size_t offset;   ///< bytes allocated so far
+    int    hugepage; ///< 1 if backed by explicit huge pages
+} LINARFILTERPRED_ARENA;
+
+errno_t linARfilterPred_arena_init(LINARFILTERPRED_ARENA *arena,
+                                   size_t                 size,
+                                   int                    hugepage);
+
+errno_t linARfilterPred_arena_free(LINARFILTERPRED_ARENA *arena);
+
+void *linARfilterPred_arena_alloc(LINARFILTERPRED_ARENA *arena,
+                                  size_t                 nbytes);
+
+#endif
@@ -0,0 +1,165 @@
+/**
+ * @file    linPF_frac.c
+ * @brief   Fractional prediction horizon, interpolated between horizons
+ *
+ * A filter is built for a fixed prediction latency, an integer number of
+ * frames. The actual delay between the input measurement and actuation
+ * varies by a fraction of a frame, with WFS exposure timing and
+ * computation jitter.
+ *
+ * With a multi-horizon filter cube, horizon h predicting lat0 + h x dlat
+ * frames ahead, the horizon needed by each frame is estimated as :
+ *
+ *   tau = (tnow - tin) / Tframe + actlat
+ *
+ * where tin is the input stream acquisition time (write time if not set
+ * by the writer), tnow the time at which the output is computed, Tframe
+ * the frame period, estimated from successive input time stamps, and
+ * actlat the fixed delay from output to actuation. The output is
+ * interpolated between the two horizons bracketing tau :
+ *
+ *   y = (1 - alpha) y[h] + alpha y[h+1]
+ *
+ * With the filter split in linPF_tfir.c, contributions of older time
+ * steps to all horizons are computed ahead of the frame, so that the
+ * cost of each additional horizon on the critical path is one MVM on
+ * the newest time step only.
+ *
+ * Outside of the cube horizons, tau is clamped to the nearest horizon,
+ * and the frame is counted.
+ */
+
+#include <math.h>
+#include <time.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_frac.h"
+
+
+// frame period estimate smoothing gain
+#define FRAC_TFRAMEGAIN 0.01
+
+
+
+
+/**
+ * @brief Initialize for cube of NBhorizon filters
+ */
+errno_t linARfilterPred_frac_init(LINARFILTERPRED_FRAC *frac,
+                                  long                  NBhorizon,
+                                  double                lat0,
+                                  double                dlat,
+                                  double                actlat)
+{
+    frac->NBhorizon = NBhorizon;
+    frac->lat0      = lat0;
+    frac->dlat      = dlat;
+    frac->actlat    = actlat;
+
+    frac->Tframe   = 0.0;
+    frac->tinprev  = 0.0;
+    frac->cnt0prev = 0;
+
+    frac->tau     = lat0;
+    frac->h       = 0;
+    frac->alpha   = 0.0;
+    frac->NBclamp = 0;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Estimate horizon of current frame from input stream metadata
+ *
+ * Until the frame period is known, the first horizon is used.
+ *
+ * @return interpolation weight alpha of horizon frac->h + 1
+ */
+double linARfilterPred_frac_update(LINARFILTERPRED_FRAC *frac,
+                                   IMAGE_METADATA       *md)
+{
+    struct timespec tnow;
+    clock_gettime(CLOCK_REALTIME, &tnow);
+
+    struct timespec tinspec = md->atime;
+    if(tinspec.tv_sec == 0)
+    {
+        tinspec = md->writetime;
+    }
+    double tin = 1.0 * tinspec.tv_sec + 1.0e-9 * tinspec.tv_nsec;
+    uint64_t cnt0 = md->cnt0;
+
+    // frame period, from time stamps of successive frames
+    if((frac->tinprev > 0.0) && (cnt0 > frac->cnt0prev))
+    {
+        double dt = (tin - frac->tinprev) / (cnt0 - frac->cnt0prev);
+        if((dt > 0.0) && (dt < 1.0))
+        {
+            if(frac->Tframe > 0.0)
+            {
+                frac->Tframe += FRAC_TFRAMEGAIN * (dt - frac->Tframe);
+            }
+            else
+            {
+                frac->Tframe = dt;
+            }
+        }
+    }
+    frac->tinprev  = tin;
+    frac->cnt0prev = cnt0;
+
+    if(frac->Tframe <= 0.0)
+    {
+        frac->h     = 0;
+        frac->alpha = 0.0;
+        return frac->alpha;
+    }
+
+    double delay = 1.0 * (tnow.tv_sec - tinspec.tv_sec) +
+                   1.0e-9 * (tnow.tv_nsec - tinspec.tv_nsec);
+    frac->tau = delay / frac->Tframe + frac->actlat;
+
+    // position in cube, in horizon units
+    double p = (frac->tau - frac->lat0) / frac->dlat;
+    if((p < 0.0) || (p > frac->NBhorizon - 1) || isnan(p))
+    {
+        frac->NBclamp++;
+        p = (p > 0.0) ? frac->NBhorizon - 1 : 0.0;
+    }
+
+    frac->h = (long) p;
+    if(frac->h > frac->NBhorizon - 2)
+    {
+        frac->h = frac->NBhorizon - 2;
+    }
+    frac->alpha = p - frac->h;
+
+    return frac->alpha;
+}
+
+
+
+
+/**
+ * @brief Interpolate output between bracketing horizons
+ *
+ * yMH holds NBhorizon consecutive output vectors of size NBmodeOUT
+ */
+void linARfilterPred_frac_blend(LINARFILTERPRED_FRAC *frac,
+                                long                  NBmodeOUT,
+                                const float          *yMH,
+                                float                *y)
+{
+    const float *y0    = yMH + NBmodeOUT * frac->h;
+    const float *y1    = y0 + NBmodeOUT;
+    float        alpha = (float) frac->alpha;
+
+    for(long mi = 0; mi < NBmodeOUT; mi++)
+    {
+        y[mi] = y0[mi] + alpha * (y1[mi] - y0[mi]);
+    }
+}
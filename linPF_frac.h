@@ -0,0 +1,48 @@
+/**
+ * @file    linPF_frac.h
+ * @brief   Fractional prediction horizon, interpolated between horizons
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_FRAC_H
+#define LINARFILTERPRED_LINPF_FRAC_H
+
+#include <stdint.h>
+
+/** @brief Horizon estimate and interpolation state
+ *
+ * Filter horizon h predicts lat0 + h x dlat frames after the input.
+ */
+typedef struct
+{
+    long   NBhorizon;
+    double lat0;      ///< horizon 0 prediction latency [frame]
+    double dlat;      ///< latency step between horizons [frame]
+    double actlat;    ///< output to actuation delay [frame]
+
+    double   Tframe;  ///< frame period estimate [s], 0 if unknown
+    double   tinprev; ///< input time stamp of previous frame [s]
+    uint64_t cnt0prev;
+
+    double   tau;     ///< horizon needed by current frame [frame]
+    long     h;       ///< lower bracketing horizon
+    double   alpha;   ///< interpolation weight of horizon h+1
+    uint64_t NBclamp; ///< frames with tau outside of filter horizons
+} LINARFILTERPRED_FRAC;
+
+errno_t linARfilterPred_frac_init(LINARFILTERPRED_FRAC *frac,
+                                  long                  NBhorizon,
+                                  double                lat0,
+                                  double                dlat,
+                                  double                actlat);
+
+double linARfilterPred_frac_update(LINARFILTERPRED_FRAC *frac,
+                                   IMAGE_METADATA       *md);
+
+void linARfilterPred_frac_blend(LINARFILTERPRED_FRAC *frac,
+                                long                  NBmodeOUT,
+                                const float          *yMH,
+                                float                *y);
+
+#endif
@@ -0,0 +1,718 @@
+/**
+ * @file    linPF_gram.c
+ * @brief   Normal-equation (Gram matrix) solver for predictive filters
+ *
+ * The least-squares filter W minimizing | X W^T - Y |^2 is computed
+ * from the Gram matrix G = X^T X and cross-product C = Y^T X.
+ *
+ * Conventions (all arrays row-major, double precision):
+ * - G : n x n, symmetric, full storage
+ * - C : nrhs x n, row j is X^T y_j
+ * - W : nrhs x n, row j is the filter for output j
+ *
+ * W rows are laid out as the 2D predictive filter rows, so that
+ * output j coefficients are directly W[j*n .. j*n+n-1].
+ *
+ * When X is built from telemetry, column dt*NBpixin+pix holds input pixel
+ * pix delayed by dt frames. The statistics of a lower order filter are
+ * then the leading sub-blocks of G and C.
+ */
+
+#include <math.h>
+
+#include <gsl/gsl_cblas.h>
+#include <gsl/gsl_eigen.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_gram.h"
+
+
+// number of samples processed per block when accumulating telemetry
+#define GRAM_BLOCKSIZE 256
+
+
+
+
+errno_t linARfilterPred_gram_init(LINARFILTERPRED_GRAM *gram, long n, long nout)
+{
+    gram->n    = n;
+    gram->nout = nout;
+
+    gram->G    = (double *) calloc(n * n, sizeof(double));
+    gram->C    = (double *) calloc(nout * n, sizeof(double));
+    gram->yty  = (double *) calloc(nout, sizeof(double));
+    gram->sumx = (double *) calloc(n, sizeof(double));
+    gram->sumy = (double *) calloc(nout, sizeof(double));
+    gram->Xb   = (double *) malloc(sizeof(double) * GRAM_BLOCKSIZE * n);
+    gram->Yb   = (double *) malloc(sizeof(double) * GRAM_BLOCKSIZE * nout);
+    if((gram->G == NULL) || (gram->C == NULL) || (gram->yty == NULL) ||
+            (gram->sumx == NULL) || (gram->sumy == NULL) ||
+            (gram->Xb == NULL) || (gram->Yb == NULL))
+    {
+        PRINT_ERROR("calloc returns NULL pointer");
+        abort();
+    }
+    gram->NBsample = 0;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Number of doubles used by statistics of size n x nout
+ *
+ * Includes the telemetry sample blocks, so that accumulation does not
+ * allocate memory.
+ */
+long linARfilterPred_gram_bufsize(long n, long nout)
+{
+    return n * n + nout * n + nout + n + nout + GRAM_BLOCKSIZE * (n + nout);
+}
+
+
+
+
+/**
+ * @brief Initialize statistics in caller-provided buffer
+ *
+ * buf holds linARfilterPred_gram_bufsize(n, nout) doubles, and is owned
+ * by the caller: linARfilterPred_gram_free() must not be called.
+ */
+errno_t linARfilterPred_gram_init_buffer(LINARFILTERPRED_GRAM *gram,
+        long                  n,
+        long                  nout,
+        double               *buf)
+{
+    gram->n    = n;
+    gram->nout = nout;
+
+    gram->G    = buf;
+    gram->C    = gram->G + n * n;
+    gram->yty  = gram->C + nout * n;
+    gram->sumx = gram->yty + nout;
+    gram->sumy = gram->sumx + n;
+    gram->Xb   = gram->sumy + nout;
+    gram->Yb   = gram->Xb + GRAM_BLOCKSIZE * n;
+    linARfilterPred_gram_reset(gram);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t linARfilterPred_gram_free(LINARFILTERPRED_GRAM *gram)
+{
+    free(gram->G);
+    free(gram->C);
+    free(gram->yty);
+    free(gram->sumx);
+    free(gram->sumy);
+    free(gram->Xb);
+    free(gram->Yb);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t linARfilterPred_gram_reset(LINARFILTERPRED_GRAM *gram)
+{
+    long n    = gram->n;
+    long nout = gram->nout;
+
+    memset(gram->G, 0, sizeof(double) * n * n);
+    memset(gram->C, 0, sizeof(double) * nout * n);
+    memset(gram->yty, 0, sizeof(double) * nout);
+    memset(gram->sumx, 0, sizeof(double) * n);
+    memset(gram->sumy, 0, sizeof(double) * nout);
+    gram->NBsample = 0;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Add samples to normal-equation statistics
+ *
+ * X is nrow x n, Y is nrow x nout, both row-major.
+ * Only the upper triangle of G is updated.
+ */
+errno_t linARfilterPred_gram_accumulate_rows(LINARFILTERPRED_GRAM *gram,
+        const double         *X,
+        const double         *Y,
+        long                  nrow)
+{
+    long n    = gram->n;
+    long nout = gram->nout;
+
+    if(nrow == 0)
+    {
+        return RETURN_SUCCESS;
+    }
+
+    cblas_dsyrk(CblasRowMajor,
+                CblasUpper,
+                CblasTrans,
+                n,
+                nrow,
+                1.0,
+                X,
+                n,
+                1.0,
+                gram->G,
+                n);
+
+    cblas_dgemm(CblasRowMajor,
+                CblasTrans,
+                CblasNoTrans,
+                nout,
+                n,
+                nrow,
+                1.0,
+                Y,
+                nout,
+                X,
+                n,
+                1.0,
+                gram->C,
+                n);
+
+    for(long r = 0; r < nrow; r++)
+    {
+        for(long i = 0; i < n; i++)
+        {
+            gram->sumx[i] += X[r * n + i];
+        }
+        for(long j = 0; j < nout; j++)
+        {
+            double y = Y[r * nout + j];
+            gram->yty[j] += y * y;
+            gram->sumy[j] += y;
+        }
+    }
+    gram->NBsample += nrow;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Add telemetry samples mstart to mend-1 to normal-equation statistics
+ *
+ * Follows the data matrix convention of mkPF: sample m uses frames
+ * m .. m+PForder-1 as input and predicts frame m+PForder-1+PFlag,
+ * linearly interpolated between frames for fractional PFlag.
+ */
+errno_t linARfilterPred_gram_accumulate_telemetry(LINARFILTERPRED_GRAM *gram,
+        const float          *incp,
+        uint64_t              xysize,
+        long                  NBpixin,
+        const long           *pixarray_xy,
+        long                  NBpixout,
+        const long           *outpixarray_xy,
+        long                  PForder,
+        float                 PFlag,
+        long                  mstart,
+        long                  mend)
+{
+    DEBUG_TRACE_FSTART();
+
+    long n    = gram->n;
+    long nout = gram->nout;
+
+    long  PFlagl = (long) PFlag;
+    float alpha  = PFlag - PFlagl;
+
+    double *Xb = gram->Xb;
+    double *Yb = gram->Yb;
+
+    for(long m0 = mstart; m0 < mend; m0 += GRAM_BLOCKSIZE)
+    {
+        long nrow = mend - m0;
+        if(nrow > GRAM_BLOCKSIZE)
+        {
+            nrow = GRAM_BLOCKSIZE;
+        }
+
+        for(long r = 0; r < nrow; r++)
+        {
+            long k0 = m0 + r + PForder - 1; // dt=0 index
+            for(long dt = 0; dt < PForder; dt++)
+            {
+                const float *frame = &incp[(k0 - dt) * xysize];
+                for(long pix = 0; pix < NBpixin; pix++)
+                {
+                    Xb[r * n + dt * NBpixin + pix] = frame[pixarray_xy[pix]];
+                }
+            }
+
+            k0 += PFlagl;
+            for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+            {
+                Yb[r * nout + PFpix] =
+                    (1.0 - alpha) * incp[k0 * xysize + outpixarray_xy[PFpix]] +
+                    alpha * incp[(k0 + 1) * xysize + outpixarray_xy[PFpix]];
+            }
+        }
+
+        linARfilterPred_gram_accumulate_rows(gram, Xb, Yb, nrow);
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Add valid telemetry samples mstart to mend-1 to statistics
+ *
+ * Same as linARfilterPred_gram_accumulate_telemetry, skipping samples
+ * with samplevalid[m] = 0. Contiguous runs of valid samples are
+ * accumulated in blocks. All samples are valid if samplevalid is NULL.
+ */
+errno_t linARfilterPred_gram_accumulate_valid(LINARFILTERPRED_GRAM *gram,
+        const float          *incp,
+        uint64_t              xysize,
+        long                  NBpixin,
+        const long           *pixarray_xy,
+        long                  NBpixout,
+        const long           *outpixarray_xy,
+        long                  PForder,
+        float                 PFlag,
+        long                  mstart,
+        long                  mend,
+        const uint8_t        *samplevalid)
+{
+    long m = mstart;
+    while(m < mend)
+    {
+        long m1 = m;
+        if(samplevalid == NULL)
+        {
+            m1 = mend;
+        }
+        else
+        {
+            while((m1 < mend) && (samplevalid[m1] == 1))
+            {
+                m1++;
+            }
+        }
+
+        if(m1 > m)
+        {
+            linARfilterPred_gram_accumulate_telemetry(gram,
+                    incp,
+                    xysize,
+                    NBpixin,
+                    pixarray_xy,
+                    NBpixout,
+                    outpixarray_xy,
+                    PForder,
+                    PFlag,
+                    m,
+                    m1);
+        }
+
+        // skip invalid samples
+        m = m1;
+        while((m < mend) && (samplevalid[m] == 0))
+        {
+            m++;
+        }
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Copy upper triangle of G to lower triangle
+ */
+errno_t linARfilterPred_gram_symmetrize(LINARFILTERPRED_GRAM *gram)
+{
+    long n = gram->n;
+
+    for(long i = 0; i < n; i++)
+        for(long j = 0; j < i; j++)
+        {
+            gram->G[i * n + j] = gram->G[j * n + i];
+        }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Remove constant offsets from normal-equation statistics
+ *
+ * Transforms the statistics into those of X - mux and Y - muy without
+ * another pass over the samples, using the column sums:
+ *   G' = G - sx mux^T - mux sx^T + N mux mux^T
+ *   C' = C - sy mux^T - muy sx^T + N muy mux^T
+ * Regressor i is telemetry input pixel i % NBpixin, so mux[i] is
+ * ave_inarray[i % NBpixin]. G must be symmetrized.
+ */
+errno_t linARfilterPred_gram_center(LINARFILTERPRED_GRAM *gram,
+                                    long                  NBpixin,
+                                    const double         *ave_inarray,
+                                    const double         *ave_outarray)
+{
+    long   n    = gram->n;
+    long   nout = gram->nout;
+    double N    = gram->NBsample;
+
+    for(long i = 0; i < n; i++)
+    {
+        double mui = ave_inarray[i % NBpixin];
+        for(long l = 0; l < n; l++)
+        {
+            double mul = ave_inarray[l % NBpixin];
+            gram->G[i * n + l] += -gram->sumx[i] * mul - mui * gram->sumx[l] +
+                                  N * mui * mul;
+        }
+    }
+
+    for(long j = 0; j < nout; j++)
+    {
+        double muy = ave_outarray[j];
+        for(long i = 0; i < n; i++)
+        {
+            double mui = ave_inarray[i % NBpixin];
+            gram->C[j * n + i] += -gram->sumy[j] * mui - muy * gram->sumx[i] +
+                                  N * muy * mui;
+        }
+        gram->yty[j] += -2.0 * muy * gram->sumy[j] + N * muy * muy;
+    }
+
+    for(long i = 0; i < n; i++)
+    {
+        gram->sumx[i] -= N * ave_inarray[i % NBpixin];
+    }
+    for(long j = 0; j < nout; j++)
+    {
+        gram->sumy[j] -= N * ave_outarray[j];
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Sum of squared prediction residuals of filter W
+ *
+ * W is nout x nsub, using the leading nsub regressors.
+ * Computed from the statistics only: tr(YtY) - 2 tr(W C) + tr(W G W^T).
+ * G must be symmetrized.
+ */
+double linARfilterPred_gram_residual(const LINARFILTERPRED_GRAM *gram,
+                                     const double               *W,
+                                     long                        nsub)
+{
+    long n = gram->n;
+
+    double res = 0.0;
+    for(long j = 0; j < gram->nout; j++)
+    {
+        const double *Wj = &W[j * nsub];
+        const double *Cj = &gram->C[j * n];
+
+        double resj = gram->yty[j];
+        for(long i = 0; i < nsub; i++)
+        {
+            double GWi = 0.0;
+            for(long l = 0; l < nsub; l++)
+            {
+                GWi += gram->G[i * n + l] * Wj[l];
+            }
+            resj += Wj[i] * (GWi - 2.0 * Cj[i]);
+        }
+        res += resj;
+    }
+
+    return res;
+}
+
+
+
+
+/**
+ * @brief Sums of squared residuals of filters A, B and of their blend
+ *
+ * A and B are nout x n float filters (2D filter layout). The blend is
+ * (1-gain) A + gain B. Its residual is obtained from the trace terms of
+ * A and B, including the cross term tr(A G B^T), without forming it:
+ *
+ * res(blend) = tr(YtY) - 2 tr(Wmix C)
+ *              + (1-gain)^2 tr(A G A^T) + 2 gain (1-gain) tr(A G B^T)
+ *              + gain^2 tr(B G B^T)
+ *
+ * The cost is 2 x nout x n^2, plus n^2 per sample to accumulate G.
+ * Replaying the samples directly, see linARfilterPred_monitor_blendres(),
+ * costs 2 x nout x n per sample: it is cheaper for fewer than about n
+ * samples.
+ *
+ * G must be symmetrized.
+ */
+errno_t linARfilterPred_gram_residual_blend(const LINARFILTERPRED_GRAM *gram,
+        const float                *A,
+        const float                *B,
+        double                      gain,
+        double                     *resA,
+        double                     *resB,
+        double                     *resmix)
+{
+    long n = gram->n;
+
+    double yty = 0.0; // tr(YtY)
+    double AC  = 0.0; // tr(A C)
+    double BC  = 0.0; // tr(B C)
+    double AGA = 0.0; // tr(A G A^T)
+    double AGB = 0.0; // tr(A G B^T)
+    double BGB = 0.0; // tr(B G B^T)
+
+    #pragma omp parallel for reduction(+:yty,AC,BC,AGA,AGB,BGB)
+    for(long j = 0; j < gram->nout; j++)
+    {
+        const float  *Aj = &A[j * n];
+        const float  *Bj = &B[j * n];
+        const double *Cj = &gram->C[j * n];
+
+        yty += gram->yty[j];
+        for(long i = 0; i < n; i++)
+        {
+            const double *Gi  = &gram->G[i * n];
+            double        GAi = 0.0;
+            double        GBi = 0.0;
+            for(long l = 0; l < n; l++)
+            {
+                GAi += Gi[l] * Aj[l];
+                GBi += Gi[l] * Bj[l];
+            }
+            AC += Aj[i] * Cj[i];
+            BC += Bj[i] * Cj[i];
+            AGA += Aj[i] * GAi;
+            AGB += Aj[i] * GBi;
+            BGB += Bj[i] * GBi;
+        }
+    }
+
+    double g1 = 1.0 - gain;
+
+    *resA   = yty - 2.0 * AC + AGA;
+    *resB   = yty - 2.0 * BC + BGB;
+    *resmix = yty - 2.0 * (g1 * AC + gain * BC) + g1 * g1 * AGA +
+              2.0 * gain * g1 * AGB + gain * gain * BGB;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Number of doubles of work buffer used to solve n x n system
+ */
+long linARfilterPred_gram_solve_bufsize(long n)
+{
+    // G copy, eigen vectors, eigen values, projections
+    return 2 * n * n + 2 * n;
+}
+
+
+
+
+/**
+ * @brief Allocate NBcopy sets of gsl eigen workspaces of sizes step,
+ * 2 step .. NBws step
+ *
+ * Workspace c x NBws + k-1 solves systems of size k x step, see
+ * linARfilterPred_gram_solve_buffer(). Allocated at setup, so that
+ * solves do not allocate memory.
+ */
+gsl_eigen_symmv_workspace **linARfilterPred_gram_eigen_alloc(long NBcopy,
+        long NBws,
+        long step)
+{
+    gsl_eigen_symmv_workspace **eigws =
+        (gsl_eigen_symmv_workspace **) malloc(
+            sizeof(gsl_eigen_symmv_workspace *) * NBcopy * NBws);
+    if(eigws == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    for(long c = 0; c < NBcopy; c++)
+        for(long k = 0; k < NBws; k++)
+        {
+            eigws[c * NBws + k] = gsl_eigen_symmv_alloc((k + 1) * step);
+        }
+
+    return eigws;
+}
+
+
+
+
+/**
+ * @brief Free NBws workspaces, in total, and array
+ */
+errno_t linARfilterPred_gram_eigen_free(gsl_eigen_symmv_workspace **eigws,
+                                        long                        NBws)
+{
+    if(eigws == NULL)
+    {
+        return RETURN_SUCCESS;
+    }
+    for(long k = 0; k < NBws; k++)
+    {
+        gsl_eigen_symmv_free(eigws[k]);
+    }
+    free(eigws);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Solve normal equations with truncated eigen decomposition
+ *
+ * Eigenvalues of G smaller than SVDeps^2 times the largest eigenvalue
+ * are discarded. Since the eigenvalues of G are the squared singular
+ * values of X, the solution is the same as the one obtained with the
+ * SVD pseudo-inverse of X truncated at SVDeps.
+ *
+ * eigws is a gsl eigen workspace of size n, and buf holds
+ * linARfilterPred_gram_solve_bufsize(n) doubles, so that the solve does
+ * not allocate memory.
+ *
+ * @return number of eigen modes kept
+ */
+long linARfilterPred_gram_solve_buffer(const double              *G,
+                                       long                       n,
+                                       const double              *C,
+                                       long                       nrhs,
+                                       double                     SVDeps,
+                                       double                    *W,
+                                       gsl_eigen_symmv_workspace *eigws,
+                                       double                    *buf)
+{
+    if(n == 0)
+    {
+        return 0;
+    }
+
+    gsl_matrix_view Gv    = gsl_matrix_view_array(buf, n, n);
+    gsl_matrix_view evecv = gsl_matrix_view_array(buf + n * n, n, n);
+    gsl_vector_view evalv = gsl_vector_view_array(buf + 2 * n * n, n);
+    double         *proj  = buf + 2 * n * n + n;
+
+    gsl_matrix *Gm   = &Gv.matrix;
+    gsl_matrix *evec = &evecv.matrix;
+    gsl_vector *eval = &evalv.vector;
+
+    memcpy(Gm->data, G, sizeof(double) * n * n);
+    gsl_eigen_symmv(Gm, eval, evec, eigws);
+    gsl_eigen_symmv_sort(eval, evec, GSL_EIGEN_SORT_VAL_DESC);
+
+    double evalmax = gsl_vector_get(eval, 0);
+    double evallim = SVDeps * SVDeps * evalmax;
+
+    long NBmodekept = 0;
+    while((NBmodekept < n) &&
+            (gsl_vector_get(eval, NBmodekept) > evallim) &&
+            (gsl_vector_get(eval, NBmodekept) > 0.0))
+    {
+        NBmodekept++;
+    }
+
+    // projection of right hand side onto retained eigen vectors,
+    // scaled by inverse eigen value
+    //
+    for(long j = 0; j < nrhs; j++)
+    {
+        const double *Cj = &C[j * n];
+        double       *Wj = &W[j * n];
+
+        for(long k = 0; k < NBmodekept; k++)
+        {
+            double val = 0.0;
+            for(long i = 0; i < n; i++)
+            {
+                val += evec->data[i * evec->tda + k] * Cj[i];
+            }
+            proj[k] = val / gsl_vector_get(eval, k);
+        }
+
+        for(long i = 0; i < n; i++)
+        {
+            double val = 0.0;
+            for(long k = 0; k < NBmodekept; k++)
+            {
+                val += evec->data[i * evec->tda + k] * proj[k];
+            }
+            Wj[i] = val;
+        }
+    }
+
+    return NBmodekept;
+}
+
+
+
+
+/**
+ * @brief Solve normal equations, allocating the work buffer
+ *
+ * @return number of eigen modes kept
+ */
+long linARfilterPred_gram_solve(const double *G,
+                                long          n,
+                                const double *C,
+                                long          nrhs,
+                                double        SVDeps,
+                                double       *W)
+{
+    if(n == 0)
+    {
+        return 0;
+    }
+
+    double *buf = (double *) malloc(sizeof(double) *
+                                    linARfilterPred_gram_solve_bufsize(n));
+    if(buf == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    gsl_eigen_symmv_workspace *eigws = gsl_eigen_symmv_alloc(n);
+
+    long NBmodekept =
+        linARfilterPred_gram_solve_buffer(G, n, C, nrhs, SVDeps, W, eigws, buf);
+
+    gsl_eigen_symmv_free(eigws);
+    free(buf);
+
+    return NBmodekept;
+}
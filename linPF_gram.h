@@ -0,0 +1,118 @@
+/**
+ * @file    linPF_gram.h
+ * @brief   Normal-equation (Gram matrix) solver for predictive filters
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_GRAM_H
+#define LINARFILTERPRED_LINPF_GRAM_H
+
+#include <gsl/gsl_eigen.h>
+
+/** @brief Normal-equation statistics of a linear prediction problem
+ *
+ * Accumulated over samples (rows) x of regressors and y of outputs.
+ */
+typedef struct
+{
+    long    n;        ///< number of regressors (columns of X)
+    long    nout;     ///< number of outputs (columns of Y)
+    long    NBsample; ///< number of samples accumulated
+    double *G;        ///< n x n      : X^T X (upper triangle until symmetrized)
+    double *C;        ///< nout x n   : Y^T X
+    double *yty;      ///< nout       : diagonal of Y^T Y
+    double *sumx;     ///< n          : column sums of X
+    double *sumy;     ///< nout       : column sums of Y
+    double *Xb;       ///< block x n  : telemetry regressor block
+    double *Yb;       ///< block x nout : telemetry output block
+} LINARFILTERPRED_GRAM;
+
+errno_t linARfilterPred_gram_init(LINARFILTERPRED_GRAM *gram, long n, long nout);
+
+long linARfilterPred_gram_bufsize(long n, long nout);
+
+errno_t linARfilterPred_gram_init_buffer(LINARFILTERPRED_GRAM *gram,
+        long                  n,
+        long                  nout,
+        double               *buf);
+
+errno_t linARfilterPred_gram_free(LINARFILTERPRED_GRAM *gram);
+
+errno_t linARfilterPred_gram_reset(LINARFILTERPRED_GRAM *gram);
+
+errno_t linARfilterPred_gram_accumulate_rows(LINARFILTERPRED_GRAM *gram,
+        const double         *X,
+        const double         *Y,
+        long                  nrow);
+
+errno_t linARfilterPred_gram_accumulate_telemetry(LINARFILTERPRED_GRAM *gram,
+        const float          *incp,
+        uint64_t              xysize,
+        long                  NBpixin,
+        const long           *pixarray_xy,
+        long                  NBpixout,
+        const long           *outpixarray_xy,
+        long                  PForder,
+        float                 PFlag,
+        long                  mstart,
+        long                  mend);
+
+errno_t linARfilterPred_gram_accumulate_valid(LINARFILTERPRED_GRAM *gram,
+        const float          *incp,
+        uint64_t              xysize,
+        long                  NBpixin,
+        const long           *pixarray_xy,
+        long                  NBpixout,
+        const long           *outpixarray_xy,
+        long                  PForder,
+        float                 PFlag,
+        long                  mstart,
+        long                  mend,
+        const uint8_t        *samplevalid);
+
+errno_t linARfilterPred_gram_symmetrize(LINARFILTERPRED_GRAM *gram);
+
+errno_t linARfilterPred_gram_center(LINARFILTERPRED_GRAM *gram,
+                                    long                  NBpixin,
+                                    const double         *ave_inarray,
+                                    const double         *ave_outarray);
+
+double linARfilterPred_gram_residual(const LINARFILTERPRED_GRAM *gram,
+                                     const double               *W,
+                                     long                        nsub);
+
+errno_t linARfilterPred_gram_residual_blend(const LINARFILTERPRED_GRAM *gram,
+        const float                *A,
+        const float                *B,
+        double                      gain,
+        double                     *resA,
+        double                     *resB,
+        double                     *resmix);
+
+long linARfilterPred_gram_solve_bufsize(long n);
+
+gsl_eigen_symmv_workspace **linARfilterPred_gram_eigen_alloc(long NBcopy,
+        long NBws,
+        long step);
+
+errno_t linARfilterPred_gram_eigen_free(gsl_eigen_symmv_workspace **eigws,
+                                        long                        NBws);
+
+long linARfilterPred_gram_solve_buffer(const double              *G,
+                                       long                       n,
+                                       const double              *C,
+                                       long                       nrhs,
+                                       double                     SVDeps,
+                                       double                    *W,
+                                       gsl_eigen_symmv_workspace *eigws,
+                                       double                    *buf);
+
+long linARfilterPred_gram_solve(const double *G,
+                                long          n,
+                                const double *C,
+                                long          nrhs,
+                                double        SVDeps,
+                                double       *W);
+
+#endif
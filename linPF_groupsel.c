@@ -0,0 +1,246 @@
+/**
+ * @file    linPF_groupsel.c
+ * @brief   Group-sparse predictive filter by greedy forward selection
+ *
+ * Most output modes only benefit from a small set of correlated input
+ * modes. Regressors are grouped by input mode (all time steps of an
+ * input form one group), and groups are selected independently for each
+ * output by group orthogonal matching pursuit:
+ *
+ * - the gradient of the residual, r = C_j - G w, is computed for all
+ *   regressors, and each candidate group is scored by sum r_c^2 / G_cc
+ * - the best group is added, and the filter is solved again on the
+ *   selected regressors only
+ * - selection stops when the residual reduction is below tol times the
+ *   current residual, or when maxgroups groups are selected
+ *
+ * Everything is computed from the normal-equation statistics (see
+ * linPF_gram.c), so each solve only involves the selected regressors.
+ */
+
+#include <math.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_gram.h"
+#include "linPF_groupsel.h"
+
+
+
+
+/**
+ * @brief Select input groups and solve filter of each output
+ *
+ * G is n x n (symmetric), C is nout x n, yty the squared norm of each
+ * output, as in LINARFILTERPRED_GRAM. Regressor c belongs to group
+ * group[c], 0 <= group[c] < NBgroup.
+ *
+ * W is nout x n, zero outside the selected groups.
+ *
+ * @return total number of selected groups, summed over outputs
+ */
+long linARfilterPred_groupsel_solve(const double *G,
+                                    long          n,
+                                    const double *C,
+                                    const double *yty,
+                                    long          nout,
+                                    const long   *group,
+                                    long          NBgroup,
+                                    long          maxgroups,
+                                    double        tol,
+                                    double        SVDeps,
+                                    double       *W)
+{
+    DEBUG_TRACE_FSTART();
+
+    if(maxgroups > NBgroup)
+    {
+        maxgroups = NBgroup;
+    }
+
+    // regressors of each group
+    long *grpptr = (long *) calloc(NBgroup + 1, sizeof(long));
+    long *grpcol = (long *) malloc(sizeof(long) * n);
+    if((grpptr == NULL) || (grpcol == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    for(long c = 0; c < n; c++)
+    {
+        grpptr[group[c] + 1]++;
+    }
+    for(long g = 0; g < NBgroup; g++)
+    {
+        grpptr[g + 1] += grpptr[g];
+    }
+    {
+        long *fill = (long *) malloc(sizeof(long) * NBgroup);
+        if(fill == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        memcpy(fill, grpptr, sizeof(long) * NBgroup);
+        for(long c = 0; c < n; c++)
+        {
+            grpcol[fill[group[c]]] = c;
+            fill[group[c]]++;
+        }
+        free(fill);
+    }
+
+    // largest number of selected regressors
+    long grpsizemax = 0;
+    for(long g = 0; g < NBgroup; g++)
+    {
+        if(grpptr[g + 1] - grpptr[g] > grpsizemax)
+        {
+            grpsizemax = grpptr[g + 1] - grpptr[g];
+        }
+    }
+    long nsmax = maxgroups * grpsizemax;
+    if(nsmax < 1)
+    {
+        nsmax = 1;
+    }
+
+    memset(W, 0, sizeof(double) * nout * n);
+
+    long NBselect = 0;
+
+    #pragma omp parallel reduction(+:NBselect)
+    {
+        long    *selcol = (long *) malloc(sizeof(long) * nsmax);
+        double  *r      = (double *) malloc(sizeof(double) * n);
+        double  *w      = (double *) malloc(sizeof(double) * nsmax);
+        double  *wnew   = (double *) malloc(sizeof(double) * nsmax);
+        double  *Gs     = (double *) malloc(sizeof(double) * nsmax * nsmax);
+        double  *Cs     = (double *) malloc(sizeof(double) * nsmax);
+        uint8_t *insel  = (uint8_t *) malloc(sizeof(uint8_t) * NBgroup);
+        if((selcol == NULL) || (r == NULL) || (w == NULL) || (wnew == NULL) ||
+                (Gs == NULL) || (Cs == NULL) || (insel == NULL))
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+
+        #pragma omp for schedule(dynamic)
+        for(long j = 0; j < nout; j++)
+        {
+            const double *Cj = &C[j * n];
+
+            memset(insel, 0, sizeof(uint8_t) * NBgroup);
+            long   ns   = 0; // number of selected regressors
+            long   nsel = 0; // number of selected groups
+            double res  = yty[j];
+
+            while(nsel < maxgroups)
+            {
+                // residual gradient
+                for(long c = 0; c < n; c++)
+                {
+                    double val = Cj[c];
+                    for(long s = 0; s < ns; s++)
+                    {
+                        val -= G[c * n + selcol[s]] * w[s];
+                    }
+                    r[c] = val;
+                }
+
+                // best candidate group
+                long   gbest     = -1;
+                double scorebest = 0.0;
+                for(long g = 0; g < NBgroup; g++)
+                {
+                    if(insel[g] == 1)
+                    {
+                        continue;
+                    }
+                    double score = 0.0;
+                    for(long e = grpptr[g]; e < grpptr[g + 1]; e++)
+                    {
+                        long c = grpcol[e];
+                        if(G[c * n + c] > 0.0)
+                        {
+                            score += r[c] * r[c] / G[c * n + c];
+                        }
+                    }
+                    if(score > scorebest)
+                    {
+                        scorebest = score;
+                        gbest     = g;
+                    }
+                }
+                if(gbest == -1)
+                {
+                    break;
+                }
+
+                // solve on selected regressors + candidate group
+                long ns1 = ns;
+                for(long e = grpptr[gbest]; e < grpptr[gbest + 1]; e++)
+                {
+                    selcol[ns1] = grpcol[e];
+                    ns1++;
+                }
+                for(long s = 0; s < ns1; s++)
+                {
+                    Cs[s] = Cj[selcol[s]];
+                    for(long s1 = 0; s1 < ns1; s1++)
+                    {
+                        Gs[s * ns1 + s1] = G[selcol[s] * n + selcol[s1]];
+                    }
+                }
+                linARfilterPred_gram_solve(Gs, ns1, Cs, 1, SVDeps, wnew);
+
+                // residual: yty - 2 w.c + w^T G w
+                double resnew = yty[j];
+                for(long s = 0; s < ns1; s++)
+                {
+                    double Gw = 0.0;
+                    for(long s1 = 0; s1 < ns1; s1++)
+                    {
+                        Gw += Gs[s * ns1 + s1] * wnew[s1];
+                    }
+                    resnew += wnew[s] * (Gw - 2.0 * Cs[s]);
+                }
+
+                if(res - resnew < tol * res)
+                {
+                    break;
+                }
+
+                insel[gbest] = 1;
+                nsel++;
+                ns  = ns1;
+                res = resnew;
+                memcpy(w, wnew, sizeof(double) * ns);
+            }
+
+            for(long s = 0; s < ns; s++)
+            {
+                W[j * n + selcol[s]] = w[s];
+            }
+            NBselect += nsel;
+        }
+
+        free(selcol);
+        free(r);
+        free(w);
+        free(wnew);
+        free(Gs);
+        free(Cs);
+        free(insel);
+    }
+
+    free(grpptr);
+    free(grpcol);
+
+    DEBUG_TRACE_FEXIT();
+    return NBselect;
+}
@@ -0,0 +1,23 @@
+/**
+ * @file    linPF_groupsel.h
+ * @brief   Group-sparse predictive filter by greedy forward selection
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_GROUPSEL_H
+#define LINARFILTERPRED_LINPF_GROUPSEL_H
+
+long linARfilterPred_groupsel_solve(const double *G,
+                                    long          n,
+                                    const double *C,
+                                    const double *yty,
+                                    long          nout,
+                                    const long   *group,
+                                    long          NBgroup,
+                                    long          maxgroups,
+                                    double        tol,
+                                    double        SVDeps,
+                                    double       *W);
+
+#endif
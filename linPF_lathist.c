@@ -0,0 +1,384 @@
+/**
+ * @file    linPF_lathist.c
+ * @brief   Per-frame latency histograms of real-time filter apply
+ *
+ * The real-time loop time stamps each frame at input semaphore wake,
+ * filter output computed (input gather and MVM) and output posted. Time
+ * stamps are read from the CPU time stamp counter on x86 CPUs with
+ * invariant TSC (~10 ns, calibrated against CLOCK_MONOTONIC at init),
+ * otherwise from CLOCK_MONOTONIC (vDSO, ~20-50 ns).
+ *
+ * Each frame adds 4 intervals to log-linear histograms of raw ticks: the
+ * two stage intervals between time stamps, the total latency as their
+ * sum and the period since previous wake. The bin index is computed from
+ * the position of the most significant bit and the next
+ * LINPF_LAT_SUBBITS bits, so that the bin width is at most 1/8 of the
+ * value and binning takes a few integer instructions. Ticks are not
+ * converted to ns and no min, max or sum is kept per frame: statistics
+ * are derived from histograms when published, outside of the frame
+ * critical path.
+ *
+ * Bin b < 8 holds b ticks. Bin b >= 8 holds values from
+ * (8 + b%8) << (b/8 - 1) to (9 + b%8) << (b/8 - 1) ticks, excluded.
+ * Min and max are the lower and upper edges of the lowest and highest
+ * non-empty bins, mean is computed from bin centers: all are within one
+ * bin width of the exact value.
+ *
+ * Frames missed by the loop are counted from the input stream cnt0 at
+ * wake.
+ *
+ * Measurement is on by default (.lat.enable in applyPF): it adds 3 time
+ * stamps and 4 histogram increments to each frame.
+ *
+ * Results are written to a shared memory stream of size
+ * (NBSTAT + NBBIN) x NBSTAGE, one row per interval:
+ * - col 0 : number of frames
+ * - col 1 : number of missed frames
+ * - col 2 : min [us]
+ * - col 3 : mean [us]
+ * - col 4 : 50% percentile [us]
+ * - col 5 : 90% percentile [us]
+ * - col 6 : 99% percentile [us]
+ * - col 7 : 99.9% percentile [us]
+ * - col 8 : max [us]
+ * - col 9 : tick duration [us]
+ * - col NBSTAT + b : histogram bin b count
+ *
+ * Statistics are reset after each publication.
+ */
+
+#include <math.h>
+#include <time.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINPF_LAT_TSC
+#include <cpuid.h>
+#include <x86intrin.h>
+#endif
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "linPF_lathist.h"
+
+
+
+
+static const char *stagename[LINPF_LAT_NBSTAGE] =
+{
+    "compute",
+    "post",
+    "total",
+    "period"
+};
+
+
+
+
+const char *linARfilterPred_lathist_stagename(int stage)
+{
+    if((stage < 0) || (stage >= LINPF_LAT_NBSTAGE))
+    {
+        return "unknown";
+    }
+    return stagename[stage];
+}
+
+
+
+
+static inline int lathist_bin(uint64_t v)
+{
+    if(v < (1 << LINPF_LAT_SUBBITS))
+    {
+        return (int) v;
+    }
+    int e = 63 - __builtin_clzll(v);
+    return ((e - LINPF_LAT_SUBBITS + 1) << LINPF_LAT_SUBBITS) +
+           (int)((v >> (e - LINPF_LAT_SUBBITS)) &
+                 ((1 << LINPF_LAT_SUBBITS) - 1));
+}
+
+
+
+
+/**
+ * @brief Lower edge of histogram bin [tick]
+ */
+static double lathist_binmin(int bin)
+{
+    if(bin < (1 << LINPF_LAT_SUBBITS))
+    {
+        return bin;
+    }
+    int octave = bin >> LINPF_LAT_SUBBITS;
+    int sub    = bin & ((1 << LINPF_LAT_SUBBITS) - 1);
+    return ldexp((1 << LINPF_LAT_SUBBITS) + sub, octave - 1);
+}
+
+
+
+
+/**
+ * @brief Upper edge of histogram bin [tick]
+ */
+static double lathist_binmax(int bin)
+{
+    if(bin < (1 << LINPF_LAT_SUBBITS))
+    {
+        return bin + 1.0;
+    }
+    int octave = bin >> LINPF_LAT_SUBBITS;
+    int sub    = bin & ((1 << LINPF_LAT_SUBBITS) - 1);
+    return ldexp((1 << LINPF_LAT_SUBBITS) + sub + 1.0, octave - 1);
+}
+
+
+
+
+static inline uint64_t lathist_clock_ns()
+{
+    struct timespec tnow;
+    clock_gettime(CLOCK_MONOTONIC, &tnow);
+    return (uint64_t) tnow.tv_sec * 1000000000 + tnow.tv_nsec;
+}
+
+
+
+
+/**
+ * @brief Initialize before first frame
+ *
+ * Calibrates the time stamp counter, if used (20 ms).
+ */
+errno_t linARfilterPred_lathist_init(LINARFILTERPRED_LATHIST *lh)
+{
+    lh->usetsc    = 0;
+    lh->nspertick = 1.0;
+#ifdef LINPF_LAT_TSC
+    unsigned int eax, ebx, ecx, edx;
+    if((__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) == 1) &&
+            ((edx & (1 << 8)) != 0))
+    {
+        struct timespec tsleep = {0, 20000000};
+        uint64_t        ns0    = lathist_clock_ns();
+        uint64_t        tick0  = __rdtsc();
+        nanosleep(&tsleep, NULL);
+        uint64_t ns1   = lathist_clock_ns();
+        uint64_t tick1 = __rdtsc();
+        if(tick1 > tick0)
+        {
+            lh->usetsc    = 1;
+            lh->nspertick = 1.0 * (ns1 - ns0) / (tick1 - tick0);
+        }
+    }
+#endif
+
+    lh->twakeprev   = 0;
+    lh->cnt0prev    = 0;
+    lh->NBmissedtot = 0;
+    linARfilterPred_lathist_reset(lh);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Reset statistics, after publication
+ */
+errno_t linARfilterPred_lathist_reset(LINARFILTERPRED_LATHIST *lh)
+{
+    lh->NBframe  = 0;
+    lh->NBmissed = 0;
+    memset(lh->hist, 0, sizeof(lh->hist));
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Time stamp point of current frame
+ */
+void linARfilterPred_lathist_mark(LINARFILTERPRED_LATHIST *lh, int point)
+{
+#ifdef LINPF_LAT_TSC
+    if(lh->usetsc == 1)
+    {
+        lh->t[point] = __rdtsc();
+        return;
+    }
+#endif
+    lh->t[point] = lathist_clock_ns();
+}
+
+
+
+
+/**
+ * @brief Add current frame time stamps to histograms
+ *
+ * cnt0 is the input stream counter read at wake.
+ */
+void linARfilterPred_lathist_frame(LINARFILTERPRED_LATHIST *lh,
+                                   uint64_t                 cnt0)
+{
+    const uint64_t *t = lh->t; // time stamps, TSC ticks or ns
+
+    uint64_t dtcompute = t[LINPF_LAT_T_MVM] - t[LINPF_LAT_T_WAKE];
+    uint64_t dtpost    = t[LINPF_LAT_T_POST] - t[LINPF_LAT_T_MVM];
+
+    lh->hist[LINPF_LAT_COMPUTE][lathist_bin(dtcompute)]++;
+    lh->hist[LINPF_LAT_POST][lathist_bin(dtpost)]++;
+    lh->hist[LINPF_LAT_TOTAL][lathist_bin(dtcompute + dtpost)]++;
+
+    // first frame has no previous frame
+    if(lh->twakeprev != 0)
+    {
+        lh->hist[LINPF_LAT_PERIOD][lathist_bin(t[LINPF_LAT_T_WAKE] -
+                                               lh->twakeprev)]++;
+        if(cnt0 > lh->cnt0prev + 1)
+        {
+            lh->NBmissed += cnt0 - lh->cnt0prev - 1;
+            lh->NBmissedtot += cnt0 - lh->cnt0prev - 1;
+        }
+    }
+    lh->twakeprev = t[LINPF_LAT_T_WAKE];
+    lh->cnt0prev  = cnt0;
+    lh->NBframe++;
+}
+
+
+
+
+/**
+ * @brief Percentile q (0 to 1) of interval stage [ns]
+ *
+ * Upper edge of the histogram bin holding the percentile.
+ */
+double linARfilterPred_lathist_percentile(LINARFILTERPRED_LATHIST *lh,
+        int                      stage,
+        double                   q)
+{
+    uint64_t NBval = 0;
+    for(int bin = 0; bin < LINPF_LAT_NBBIN; bin++)
+    {
+        NBval += lh->hist[stage][bin];
+    }
+    if(NBval == 0)
+    {
+        return 0.0;
+    }
+
+    uint64_t cnt    = 0;
+    uint64_t target = (uint64_t)(q * NBval);
+    for(int bin = 0; bin < LINPF_LAT_NBBIN; bin++)
+    {
+        cnt += lh->hist[stage][bin];
+        if(cnt > target)
+        {
+            return lh->nspertick * lathist_binmax(bin);
+        }
+    }
+    return linARfilterPred_lathist_max(lh, stage);
+}
+
+
+
+
+/**
+ * @brief Max of interval stage [ns]
+ *
+ * Upper edge of the highest non-empty histogram bin, 0 if empty.
+ */
+double linARfilterPred_lathist_max(LINARFILTERPRED_LATHIST *lh, int stage)
+{
+    for(int bin = LINPF_LAT_NBBIN - 1; bin >= 0; bin--)
+    {
+        if(lh->hist[stage][bin] > 0)
+        {
+            return lh->nspertick * lathist_binmax(bin);
+        }
+    }
+    return 0.0;
+}
+
+
+
+
+/**
+ * @brief Write statistics to stream name, created if *IDlat is -1
+ */
+errno_t linARfilterPred_lathist_stream(LINARFILTERPRED_LATHIST *lh,
+                                       const char              *name,
+                                       imageID                 *IDlat)
+{
+    DEBUG_TRACE_FSTART();
+
+    long ncol = LINPF_LAT_NBSTAT + LINPF_LAT_NBBIN;
+
+    if(*IDlat == -1)
+    {
+        *IDlat = image_ID(name);
+    }
+    if(*IDlat == -1)
+    {
+        uint32_t *imsizearray = (uint32_t *) malloc(sizeof(uint32_t) * 2);
+        if(imsizearray == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        imsizearray[0] = ncol;
+        imsizearray[1] = LINPF_LAT_NBSTAGE;
+        create_image_ID(name,
+                        2,
+                        imsizearray,
+                        _DATATYPE_FLOAT,
+                        1,
+                        1,
+                        0,
+                        IDlat);
+        free(imsizearray);
+    }
+
+    data.image[*IDlat].md[0].write = 1;
+    for(int stage = 0; stage < LINPF_LAT_NBSTAGE; stage++)
+    {
+        float   *row   = &data.image[*IDlat].array.F[ncol * stage];
+        uint64_t NBval = 0;
+        double   tmin  = 0.0;
+        double   tsum  = 0.0; // bin centers [tick]
+        for(int bin = 0; bin < LINPF_LAT_NBBIN; bin++)
+        {
+            uint32_t cnt = lh->hist[stage][bin];
+            if((cnt > 0) && (NBval == 0))
+            {
+                tmin = lathist_binmin(bin);
+            }
+            NBval += cnt;
+            tsum += 0.5 * cnt * (lathist_binmin(bin) + lathist_binmax(bin));
+            row[LINPF_LAT_NBSTAT + bin] = cnt;
+        }
+        row[0] = lh->NBframe;
+        row[1] = lh->NBmissed;
+        row[2] = 1.0e-3 * lh->nspertick * tmin;
+        row[3] = (NBval > 0) ? 1.0e-3 * lh->nspertick * tsum / NBval : 0.0;
+        row[4] = 1.0e-3 * linARfilterPred_lathist_percentile(lh, stage, 0.5);
+        row[5] = 1.0e-3 * linARfilterPred_lathist_percentile(lh, stage, 0.9);
+        row[6] = 1.0e-3 * linARfilterPred_lathist_percentile(lh, stage, 0.99);
+        row[7] = 1.0e-3 * linARfilterPred_lathist_percentile(lh, stage, 0.999);
+        row[8] = 1.0e-3 * linARfilterPred_lathist_max(lh, stage);
+        row[9] = 1.0e-3 * lh->nspertick;
+    }
+    COREMOD_MEMORY_image_set_sempost_byID(*IDlat, -1);
+    data.image[*IDlat].md[0].cnt0++;
+    data.image[*IDlat].md[0].write = 0;
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,74 @@
+/**
+ * @file    linPF_lathist.h
+ * @brief   Per-frame latency histograms of real-time filter apply
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_LATHIST_H
+#define LINARFILTERPRED_LINPF_LATHIST_H
+
+#include <stdint.h>
+
+// time stamps within a frame
+#define LINPF_LAT_T_WAKE 0 // input semaphore wake
+#define LINPF_LAT_T_MVM  1 // input gathered and filter output computed
+#define LINPF_LAT_T_POST 2 // output stream posted
+#define LINPF_LAT_NBT    3
+
+// measured intervals
+#define LINPF_LAT_COMPUTE 0 // wake -> MVM, including input gather
+#define LINPF_LAT_POST    1 // MVM -> post
+#define LINPF_LAT_TOTAL   2 // wake -> post, compute + post
+#define LINPF_LAT_PERIOD  3 // wake -> next wake
+#define LINPF_LAT_NBSTAGE 4
+
+// log-linear histogram: 2^SUBBITS bins per octave of ticks
+#define LINPF_LAT_SUBBITS 3
+#define LINPF_LAT_NBBIN   ((64 - LINPF_LAT_SUBBITS + 1) << LINPF_LAT_SUBBITS)
+
+// statistics published per interval, see linPF_lathist.c
+#define LINPF_LAT_NBSTAT 10
+
+/** @brief Latency statistics since last publication
+ *
+ * Written by the real-time loop only, read when published by the same
+ * thread : no lock needed.
+ */
+typedef struct
+{
+    int      usetsc;               ///< 1 if time stamps are TSC ticks
+    double   nspertick;            ///< tick duration [ns]
+    uint64_t t[LINPF_LAT_NBT];     ///< time stamps of current frame
+    uint64_t twakeprev;            ///< wake time of previous frame
+    uint64_t cnt0prev;             ///< input cnt0 of previous frame
+
+    uint64_t NBframe;
+    uint64_t NBmissed;             ///< since last publication
+    uint64_t NBmissedtot;          ///< since start
+
+    uint32_t hist[LINPF_LAT_NBSTAGE][LINPF_LAT_NBBIN];
+} LINARFILTERPRED_LATHIST;
+
+const char *linARfilterPred_lathist_stagename(int stage);
+
+errno_t linARfilterPred_lathist_init(LINARFILTERPRED_LATHIST *lh);
+
+errno_t linARfilterPred_lathist_reset(LINARFILTERPRED_LATHIST *lh);
+
+void linARfilterPred_lathist_mark(LINARFILTERPRED_LATHIST *lh, int point);
+
+void linARfilterPred_lathist_frame(LINARFILTERPRED_LATHIST *lh,
+                                   uint64_t                 cnt0);
+
+double linARfilterPred_lathist_percentile(LINARFILTERPRED_LATHIST *lh,
+        int                      stage,
+        double                   q);
+
+double linARfilterPred_lathist_max(LINARFILTERPRED_LATHIST *lh, int stage);
+
+errno_t linARfilterPred_lathist_stream(LINARFILTERPRED_LATHIST *lh,
+                                       const char              *name,
+                                       imageID                 *IDlat);
+
+#endif
@@ -0,0 +1,416 @@
+/**
+ * @file    linPF_local.c
+ * @brief   Spatially local predictive filters
+ *
+ * Each output pixel is predicted from the input pixels within its
+ * neighbourhood only, defined either by a radius or by a stencil image.
+ * The neighbourhood filters are independent small least-squares
+ * problems, solved in parallel from their Gram matrices.
+ *
+ * Stencil image convention: pixel (ii,jj) > 0.5 selects offset
+ * (ii - xsize/2, jj - ysize/2) relative to the output pixel.
+ */
+
+#include <math.h>
+
+#include <gsl/gsl_cblas.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_gram.h"
+#include "linPF_local.h"
+
+
+
+
+/**
+ * @brief Number of neighbourhood offsets of radius or stencil
+ *
+ * Upper bound of the number of neighbours of any output pixel, available
+ * before the neighbourhood lists are built.
+ */
+long linARfilterPred_local_nboffset(float radius, imageID IDstencil)
+{
+    long NBoffset = 0;
+    if(IDstencil != -1)
+    {
+        uint64_t nelement = data.image[IDstencil].md[0].nelement;
+        for(uint64_t ii = 0; ii < nelement; ii++)
+            if(data.image[IDstencil].array.F[ii] > 0.5)
+            {
+                NBoffset++;
+            }
+    }
+    else
+    {
+        long R = (long) radius;
+        for(long dy = -R; dy <= R; dy++)
+            for(long dx = -R; dx <= R; dx++)
+                if(dx * dx + dy * dy <= radius * radius)
+                {
+                    NBoffset++;
+                }
+    }
+
+    return NBoffset;
+}
+
+
+
+
+/**
+ * @brief Number of doubles of per-thread work buffer of local solve
+ *
+ * qmax is the largest number of coefficients of a local filter.
+ */
+long linARfilterPred_local_worksize(long qmax, long NBmvec)
+{
+    // data matrix, target, normal equations, filter, solver
+    return NBmvec * qmax + NBmvec + qmax * qmax + 2 * qmax +
+           linARfilterPred_gram_solve_bufsize(qmax);
+}
+
+
+
+
+/**
+ * @brief Build neighbourhood lists of active input pixels
+ *
+ * Neighbours of output pixel PFpix are nbpix[nbrowptr[PFpix]] to
+ * nbpix[nbrowptr[PFpix+1]-1], as indices in the active input pixel list.
+ * nbrowptr must hold NBpixout+1 entries, nbpix is allocated here.
+ *
+ * @return total number of neighbours
+ */
+long linARfilterPred_local_neighbours(uint32_t    xsize,
+                                      uint32_t    ysize,
+                                      long        NBpixin,
+                                      const long *pixarray_x,
+                                      const long *pixarray_y,
+                                      long        NBpixout,
+                                      const long *outpixarray_x,
+                                      const long *outpixarray_y,
+                                      float       radius,
+                                      imageID     IDstencil,
+                                      uint32_t   *nbrowptr,
+                                      uint32_t  **nbpix)
+{
+    // map pixel coordinates to active input index (-1 if inactive)
+    long *pixmap = (long *) malloc(sizeof(long) * xsize * ysize);
+    if(pixmap == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    for(uint64_t ii = 0; ii < (uint64_t) xsize * ysize; ii++)
+    {
+        pixmap[ii] = -1;
+    }
+    for(long pix = 0; pix < NBpixin; pix++)
+    {
+        pixmap[pixarray_y[pix] * xsize + pixarray_x[pix]] = pix;
+    }
+
+    // list of offsets
+    long  NBoffset = 0;
+    long *offsetx;
+    long *offsety;
+    if(IDstencil != -1)
+    {
+        long sxsize = data.image[IDstencil].md[0].size[0];
+        long sysize = 1;
+        if(data.image[IDstencil].md[0].naxis > 1)
+        {
+            sysize = data.image[IDstencil].md[0].size[1];
+        }
+
+        offsetx = (long *) malloc(sizeof(long) * sxsize * sysize);
+        offsety = (long *) malloc(sizeof(long) * sxsize * sysize);
+        if((offsetx == NULL) || (offsety == NULL))
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        for(long jj = 0; jj < sysize; jj++)
+            for(long ii = 0; ii < sxsize; ii++)
+                if(data.image[IDstencil].array.F[jj * sxsize + ii] > 0.5)
+                {
+                    offsetx[NBoffset] = ii - sxsize / 2;
+                    offsety[NBoffset] = jj - sysize / 2;
+                    NBoffset++;
+                }
+    }
+    else
+    {
+        long R = (long) radius;
+
+        offsetx = (long *) malloc(sizeof(long) * (2 * R + 1) * (2 * R + 1));
+        offsety = (long *) malloc(sizeof(long) * (2 * R + 1) * (2 * R + 1));
+        if((offsetx == NULL) || (offsety == NULL))
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        for(long dy = -R; dy <= R; dy++)
+            for(long dx = -R; dx <= R; dx++)
+                if(dx * dx + dy * dy <= radius * radius)
+                {
+                    offsetx[NBoffset] = dx;
+                    offsety[NBoffset] = dy;
+                    NBoffset++;
+                }
+    }
+
+    *nbpix = (uint32_t *) malloc(sizeof(uint32_t) * (NBpixout * NBoffset + 1));
+    if(*nbpix == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    long nnz = 0;
+    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+    {
+        nbrowptr[PFpix] = nnz;
+        for(long off = 0; off < NBoffset; off++)
+        {
+            long x = outpixarray_x[PFpix] + offsetx[off];
+            long y = outpixarray_y[PFpix] + offsety[off];
+            if((x < 0) || (x >= xsize) || (y < 0) || (y >= ysize))
+            {
+                continue;
+            }
+            long pix = pixmap[y * xsize + x];
+            if(pix != -1)
+            {
+                (*nbpix)[nnz] = pix;
+                nnz++;
+            }
+        }
+    }
+    nbrowptr[NBpixout] = nnz;
+
+    free(offsetx);
+    free(offsety);
+    free(pixmap);
+
+    return nnz;
+}
+
+
+
+
+/**
+ * @brief CSR row offsets and column indices of local filter
+ *
+ * Within each row, coefficients are ordered by time step, then by
+ * neighbour, matching the layout written by linARfilterPred_local_solve().
+ */
+errno_t linARfilterPred_local_sparseindex(long            NBpixin,
+        long            NBpixout,
+        const uint32_t *nbrowptr,
+        const uint32_t *nbpix,
+        long            PForder,
+        uint32_t       *sprow,
+        uint32_t       *spcol)
+{
+    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+    {
+        long nl = nbrowptr[PFpix + 1] - nbrowptr[PFpix];
+        long e0 = nbrowptr[PFpix] * PForder;
+
+        sprow[PFpix] = e0;
+        for(long dt = 0; dt < PForder; dt++)
+            for(long k = 0; k < nl; k++)
+            {
+                spcol[e0 + dt * nl + k] =
+                    dt * NBpixin + nbpix[nbrowptr[PFpix] + k];
+            }
+    }
+    sprow[NBpixout] = nbrowptr[NBpixout] * PForder;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Solve all local filters
+ *
+ * incp is the telemetry cube (xysize x nbspl), sample vector m uses
+ * frames m .. m+PForder-1 as input and predicts frame m+PForder-1+PFlag.
+ * Offsets ave_inarray and ave_outarray are subtracted from inputs and
+ * outputs. Samples with samplevalid[m] = 0 are skipped.
+ *
+ * Coefficients are written to spval in CSR order.
+ *
+ * work holds NBthread slices of linARfilterPred_local_worksize(qmaxw,
+ * NBmvec) doubles, one per thread, and eigws NBthread x qmaxw/PForder
+ * gsl eigen workspaces, of sizes PForder, 2 PForder .. qmaxw for each
+ * thread (see linARfilterPred_gram_eigen_alloc()), so that the solve
+ * does not allocate memory. Local filters must not have more than qmaxw
+ * coefficients.
+ */
+errno_t linARfilterPred_local_solve(const float                *incp,
+                                    uint64_t                    xysize,
+                                    const long                 *pixarray_xy,
+                                    const double               *ave_inarray,
+                                    long                        NBpixout,
+                                    const long                 *outpixarray_xy,
+                                    const double               *ave_outarray,
+                                    const uint32_t             *nbrowptr,
+                                    const uint32_t             *nbpix,
+                                    long                        PForder,
+                                    float                       PFlag,
+                                    long                        NBmvec,
+                                    const uint8_t              *samplevalid,
+                                    double                      SVDeps,
+                                    float                      *spval,
+                                    int                         NBthread,
+                                    long                        qmaxw,
+                                    double                     *work,
+                                    gsl_eigen_symmv_workspace **eigws)
+{
+    DEBUG_TRACE_FSTART();
+
+    long nlmax = 0;
+    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+    {
+        long nl = nbrowptr[PFpix + 1] - nbrowptr[PFpix];
+        if(nl > nlmax)
+        {
+            nlmax = nl;
+        }
+    }
+    long qmax = nlmax * PForder;
+    if(qmax == 0)
+    {
+        DEBUG_TRACE_FEXIT();
+        return RETURN_SUCCESS;
+    }
+    if(qmax > qmaxw)
+    {
+        PRINT_ERROR("local filter size %ld exceeds work buffer size %ld",
+                    qmax,
+                    qmaxw);
+        DEBUG_TRACE_FEXIT();
+        return RETURN_FAILURE;
+    }
+    long worksize = linARfilterPred_local_worksize(qmaxw, NBmvec);
+    long nlmaxw   = qmaxw / PForder;
+
+    long  PFlagl = (long) PFlag;
+    float alpha  = PFlag - PFlagl;
+
+    #pragma omp parallel num_threads(NBthread)
+    {
+        int thread = 0;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+#endif
+
+        // per-thread local data matrix, target and normal equations
+        double *Xl = work + thread * worksize;
+        double *yl = Xl + NBmvec * qmaxw;
+        double *Gl = yl + NBmvec;
+        double *Cl = Gl + qmaxw * qmaxw;
+        double *Wl = Cl + qmaxw;
+        double *sb = Wl + qmaxw;
+
+        #pragma omp for schedule(dynamic, 1)
+        for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+        {
+            const uint32_t *nb = &nbpix[nbrowptr[PFpix]];
+            long            nl = nbrowptr[PFpix + 1] - nbrowptr[PFpix];
+            long            q  = nl * PForder;
+
+            if(q == 0)
+            {
+                continue;
+            }
+
+            // local data matrix, row m = sample, col dt*nl+k
+            // invalid samples are zero rows
+            for(long m = 0; m < NBmvec; m++)
+            {
+                if((samplevalid != NULL) && (samplevalid[m] == 0))
+                {
+                    for(long i = 0; i < q; i++)
+                    {
+                        Xl[m * q + i] = 0.0;
+                    }
+                    yl[m] = 0.0;
+                    continue;
+                }
+
+                long k0 = m + PForder - 1; // dt=0 index
+                for(long dt = 0; dt < PForder; dt++)
+                {
+                    const float *frame = &incp[(k0 - dt) * xysize];
+                    for(long k = 0; k < nl; k++)
+                    {
+                        Xl[m * q + dt * nl + k] =
+                            frame[pixarray_xy[nb[k]]] - ave_inarray[nb[k]];
+                    }
+                }
+                k0 += PFlagl;
+                yl[m] = (1.0 - alpha) * incp[k0 * xysize + outpixarray_xy[PFpix]] +
+                        alpha * incp[(k0 + 1) * xysize + outpixarray_xy[PFpix]] -
+                        ave_outarray[PFpix];
+            }
+
+            cblas_dsyrk(CblasRowMajor,
+                        CblasUpper,
+                        CblasTrans,
+                        q,
+                        NBmvec,
+                        1.0,
+                        Xl,
+                        q,
+                        0.0,
+                        Gl,
+                        q);
+            for(long i = 0; i < q; i++)
+                for(long j = 0; j < i; j++)
+                {
+                    Gl[i * q + j] = Gl[j * q + i];
+                }
+
+            cblas_dgemv(CblasRowMajor,
+                        CblasTrans,
+                        NBmvec,
+                        q,
+                        1.0,
+                        Xl,
+                        q,
+                        yl,
+                        1,
+                        0.0,
+                        Cl,
+                        1);
+
+            linARfilterPred_gram_solve_buffer(Gl,
+                                              q,
+                                              Cl,
+                                              1,
+                                              SVDeps,
+                                              Wl,
+                                              eigws[thread * nlmaxw + nl - 1],
+                                              sb);
+
+            float *val = &spval[nbrowptr[PFpix] * PForder];
+            for(long i = 0; i < q; i++)
+            {
+                val[i] = Wl[i];
+            }
+        }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
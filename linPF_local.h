@@ -0,0 +1,58 @@
+/**
+ * @file    linPF_local.h
+ * @brief   Spatially local predictive filters
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_LOCAL_H
+#define LINARFILTERPRED_LINPF_LOCAL_H
+
+#include <gsl/gsl_eigen.h>
+
+long linARfilterPred_local_nboffset(float radius, imageID IDstencil);
+
+long linARfilterPred_local_worksize(long qmax, long NBmvec);
+
+long linARfilterPred_local_neighbours(uint32_t    xsize,
+                                      uint32_t    ysize,
+                                      long        NBpixin,
+                                      const long *pixarray_x,
+                                      const long *pixarray_y,
+                                      long        NBpixout,
+                                      const long *outpixarray_x,
+                                      const long *outpixarray_y,
+                                      float       radius,
+                                      imageID     IDstencil,
+                                      uint32_t   *nbrowptr,
+                                      uint32_t  **nbpix);
+
+errno_t linARfilterPred_local_sparseindex(long            NBpixin,
+        long            NBpixout,
+        const uint32_t *nbrowptr,
+        const uint32_t *nbpix,
+        long            PForder,
+        uint32_t       *sprow,
+        uint32_t       *spcol);
+
+errno_t linARfilterPred_local_solve(const float                *incp,
+                                    uint64_t                    xysize,
+                                    const long                 *pixarray_xy,
+                                    const double               *ave_inarray,
+                                    long                        NBpixout,
+                                    const long                 *outpixarray_xy,
+                                    const double               *ave_outarray,
+                                    const uint32_t             *nbrowptr,
+                                    const uint32_t             *nbpix,
+                                    long                        PForder,
+                                    float                       PFlag,
+                                    long                        NBmvec,
+                                    const uint8_t              *samplevalid,
+                                    double                      SVDeps,
+                                    float                      *spval,
+                                    int                         NBthread,
+                                    long                        qmaxw,
+                                    double                     *work,
+                                    gsl_eigen_symmv_workspace **eigws);
+
+#endif
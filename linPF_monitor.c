@@ -0,0 +1,209 @@
+/**
+ * @file    linPF_monitor.c
+ * @brief   Predictive filter performance monitoring
+ *
+ * The expected residual of a filter is its mean squared prediction error
+ * (summed over outputs) on the training telemetry. It is compared by mkPF
+ * to the residual measured by applyPF on live data, published in stream
+ * <outdata>_PFres, to decide when the filter needs to be rebuilt.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_monitor.h"
+
+
+
+
+/**
+ * @brief Expected residual of filter on training telemetry
+ *
+ * Evaluated on NBsample samples evenly spaced among the NBmvec training
+ * samples. The filter is either a 2D filter PFmat (NBpixout rows of
+ * NBpixin*PForder coefficients) if sprow is NULL, or a sparse filter
+ * in CSR format (sprow, spcol, PFmat as values).
+ * Samples with samplevalid[m] = 0 are skipped.
+ * xvec is a work vector of NBpixin*PForder floats.
+ *
+ * @return mean squared prediction residual per sample
+ */
+double linARfilterPred_monitor_expres(const float    *incp,
+                                      uint64_t        xysize,
+                                      long            NBpixin,
+                                      const long     *pixarray_xy,
+                                      const double   *ave_inarray,
+                                      long            NBpixout,
+                                      const long     *outpixarray_xy,
+                                      const double   *ave_outarray,
+                                      long            PForder,
+                                      float           PFlag,
+                                      long            NBmvec,
+                                      const uint8_t  *samplevalid,
+                                      const float    *PFmat,
+                                      const uint32_t *sprow,
+                                      const uint32_t *spcol,
+                                      long            NBsample,
+                                      float          *xvec)
+{
+    long mvecsize = NBpixin * PForder;
+
+    long  PFlagl = (long) PFlag;
+    float alpha  = PFlag - PFlagl;
+
+    if(NBsample > NBmvec)
+    {
+        NBsample = NBmvec;
+    }
+    if(NBsample < 1)
+    {
+        return 0.0;
+    }
+
+    double res        = 0.0;
+    long   NBsampleOK = 0;
+    for(long spl = 0; spl < NBsample; spl++)
+    {
+        long m  = spl * NBmvec / NBsample;
+        long k0 = m + PForder - 1; // dt=0 index
+
+        if((samplevalid != NULL) && (samplevalid[m] == 0))
+        {
+            continue;
+        }
+        NBsampleOK++;
+
+        for(long dt = 0; dt < PForder; dt++)
+            for(long pix = 0; pix < NBpixin; pix++)
+            {
+                xvec[dt * NBpixin + pix] =
+                    incp[(k0 - dt) * xysize + pixarray_xy[pix]] -
+                    ave_inarray[pix];
+            }
+
+        k0 += PFlagl;
+        for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+        {
+            double val = 0.0;
+            if(sprow == NULL)
+            {
+                const float *PFrow = &PFmat[PFpix * mvecsize];
+                for(long ii = 0; ii < mvecsize; ii++)
+                {
+                    val += PFrow[ii] * xvec[ii];
+                }
+            }
+            else
+            {
+                for(uint32_t e = sprow[PFpix]; e < sprow[PFpix + 1]; e++)
+                {
+                    val += PFmat[e] * xvec[spcol[e]];
+                }
+            }
+
+            double vdiff =
+                (1.0 - alpha) * incp[k0 * xysize + outpixarray_xy[PFpix]] +
+                alpha * incp[(k0 + 1) * xysize + outpixarray_xy[PFpix]] -
+                ave_outarray[PFpix] - val;
+            res += vdiff * vdiff;
+        }
+    }
+
+    if(NBsampleOK == 0)
+    {
+        return 0.0;
+    }
+    return res / NBsampleOK;
+}
+
+
+
+
+/**
+ * @brief Sums of squared residuals of filters A, B and of their blend,
+ * replayed on telemetry samples mstart to mend-1
+ *
+ * A and B are NBpixout x NBpixin*PForder filters (2D filter layout), the
+ * blend is (1-gain) A + gain B. Same sample convention and outputs as
+ * linARfilterPred_gram_residual_blend(), at a cost of
+ * 2 x Nsample x NBpixout x NBpixin*PForder, with no setup cost.
+ * Samples with samplevalid[m] = 0 are skipped.
+ * xvec is a work vector of NBpixin*PForder floats.
+ *
+ * @return number of samples replayed
+ */
+long linARfilterPred_monitor_blendres(const float   *incp,
+                                      uint64_t       xysize,
+                                      long           NBpixin,
+                                      const long    *pixarray_xy,
+                                      const double  *ave_inarray,
+                                      long           NBpixout,
+                                      const long    *outpixarray_xy,
+                                      const double  *ave_outarray,
+                                      long           PForder,
+                                      float          PFlag,
+                                      long           mstart,
+                                      long           mend,
+                                      const uint8_t *samplevalid,
+                                      const float   *A,
+                                      const float   *B,
+                                      double         gain,
+                                      float         *xvec,
+                                      double        *resA,
+                                      double        *resB,
+                                      double        *resmix)
+{
+    long mvecsize = NBpixin * PForder;
+
+    long  PFlagl = (long) PFlag;
+    float alpha  = PFlag - PFlagl;
+
+    *resA   = 0.0;
+    *resB   = 0.0;
+    *resmix = 0.0;
+
+    long NBsampleOK = 0;
+    for(long m = mstart; m < mend; m++)
+    {
+        if((samplevalid != NULL) && (samplevalid[m] == 0))
+        {
+            continue;
+        }
+        NBsampleOK++;
+
+        long k0 = m + PForder - 1; // dt=0 index
+        for(long dt = 0; dt < PForder; dt++)
+            for(long pix = 0; pix < NBpixin; pix++)
+            {
+                xvec[dt * NBpixin + pix] =
+                    incp[(k0 - dt) * xysize + pixarray_xy[pix]] -
+                    ave_inarray[pix];
+            }
+
+        k0 += PFlagl;
+        for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+        {
+            const float *Arow = &A[PFpix * mvecsize];
+            const float *Brow = &B[PFpix * mvecsize];
+            double       valA = 0.0;
+            double       valB = 0.0;
+            for(long ii = 0; ii < mvecsize; ii++)
+            {
+                valA += Arow[ii] * xvec[ii];
+                valB += Brow[ii] * xvec[ii];
+            }
+
+            double y =
+                (1.0 - alpha) * incp[k0 * xysize + outpixarray_xy[PFpix]] +
+                alpha * incp[(k0 + 1) * xysize + outpixarray_xy[PFpix]] -
+                ave_outarray[PFpix];
+            double dA   = y - valA;
+            double dB   = y - valB;
+            double dmix = (1.0 - gain) * dA + gain * dB;
+            *resA += dA * dA;
+            *resB += dB * dB;
+            *resmix += dmix * dmix;
+        }
+    }
+
+    return NBsampleOK;
+}
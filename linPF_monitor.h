@@ -0,0 +1,50 @@
+/**
+ * @file    linPF_monitor.h
+ * @brief   Predictive filter performance monitoring
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_MONITOR_H
+#define LINARFILTERPRED_LINPF_MONITOR_H
+
+double linARfilterPred_monitor_expres(const float    *incp,
+                                      uint64_t        xysize,
+                                      long            NBpixin,
+                                      const long     *pixarray_xy,
+                                      const double   *ave_inarray,
+                                      long            NBpixout,
+                                      const long     *outpixarray_xy,
+                                      const double   *ave_outarray,
+                                      long            PForder,
+                                      float           PFlag,
+                                      long            NBmvec,
+                                      const uint8_t  *samplevalid,
+                                      const float    *PFmat,
+                                      const uint32_t *sprow,
+                                      const uint32_t *spcol,
+                                      long            NBsample,
+                                      float          *xvec);
+
+long linARfilterPred_monitor_blendres(const float   *incp,
+                                      uint64_t       xysize,
+                                      long           NBpixin,
+                                      const long    *pixarray_xy,
+                                      const double  *ave_inarray,
+                                      long           NBpixout,
+                                      const long    *outpixarray_xy,
+                                      const double  *ave_outarray,
+                                      long           PForder,
+                                      float          PFlag,
+                                      long           mstart,
+                                      long           mend,
+                                      const uint8_t *samplevalid,
+                                      const float   *A,
+                                      const float   *B,
+                                      double         gain,
+                                      float         *xvec,
+                                      double        *resA,
+                                      double        *resB,
+                                      double        *resmix);
+
+#endif
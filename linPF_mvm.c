@@ -0,0 +1,385 @@
+/**
+ * @file    linPF_mvm.c
+ * @brief   Matrix-vector multiplication kernels for real-time filter apply
+ *
+ * y = M x, with M nrow x ncol, row-major with leading dimension ldm.
+ *
+ * Kernels process 4 output rows per pass, so that each input vector load
+ * is shared by 4 rows, and accumulate in registers: y is only written
+ * once per row. Input and output must not overlap (restrict), so that
+ * the compiler does not reload or store through shared memory in the
+ * inner loop.
+ *
+ * Instruction set specific kernels (x86-64: SSE, AVX2 + FMA, AVX-512)
+ * are compiled with function target attributes and selected at startup
+ * by CPU feature detection, so that the library does not need to be
+ * built for a specific CPU. The generic kernel is portable C.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_mvm.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LINPF_MVM_X86
+#include <immintrin.h>
+#endif
+
+
+// number of output rows per pass
+#define MVM_NBROW 4
+
+
+
+
+/**
+ * @brief Portable kernel
+ */
+static void mvm_generic(long                  nrow,
+                        long                  ncol,
+                        long                  ldm,
+                        const float *restrict M,
+                        const float *restrict x,
+                        float *restrict       y)
+{
+    long r = 0;
+    for(; r + MVM_NBROW <= nrow; r += MVM_NBROW)
+    {
+        const float *M0 = &M[r * ldm];
+        const float *M1 = M0 + ldm;
+        const float *M2 = M1 + ldm;
+        const float *M3 = M2 + ldm;
+
+        float acc0 = 0.0;
+        float acc1 = 0.0;
+        float acc2 = 0.0;
+        float acc3 = 0.0;
+        for(long c = 0; c < ncol; c++)
+        {
+            float xc = x[c];
+            acc0 += M0[c] * xc;
+            acc1 += M1[c] * xc;
+            acc2 += M2[c] * xc;
+            acc3 += M3[c] * xc;
+        }
+        y[r]     = acc0;
+        y[r + 1] = acc1;
+        y[r + 2] = acc2;
+        y[r + 3] = acc3;
+    }
+    for(; r < nrow; r++)
+    {
+        const float *Mr  = &M[r * ldm];
+        float        acc = 0.0;
+        for(long c = 0; c < ncol; c++)
+        {
+            acc += Mr[c] * x[c];
+        }
+        y[r] = acc;
+    }
+}
+
+
+
+
+#ifdef LINPF_MVM_X86
+
+__attribute__((target("sse3")))
+static inline float mvm_hsum128(__m128 v)
+{
+    v = _mm_hadd_ps(v, v);
+    v = _mm_hadd_ps(v, v);
+    return _mm_cvtss_f32(v);
+}
+
+
+/**
+ * @brief SSE kernel, 4 lanes
+ */
+__attribute__((target("sse3")))
+static void mvm_sse(long                  nrow,
+                    long                  ncol,
+                    long                  ldm,
+                    const float *restrict M,
+                    const float *restrict x,
+                    float *restrict       y)
+{
+    long ncol4 = ncol & ~3L;
+
+    long r = 0;
+    for(; r + MVM_NBROW <= nrow; r += MVM_NBROW)
+    {
+        const float *M0 = &M[r * ldm];
+        const float *M1 = M0 + ldm;
+        const float *M2 = M1 + ldm;
+        const float *M3 = M2 + ldm;
+
+        __m128 acc0 = _mm_setzero_ps();
+        __m128 acc1 = _mm_setzero_ps();
+        __m128 acc2 = _mm_setzero_ps();
+        __m128 acc3 = _mm_setzero_ps();
+        for(long c = 0; c < ncol4; c += 4)
+        {
+            __m128 xc = _mm_loadu_ps(&x[c]);
+            acc0      = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(&M0[c]), xc));
+            acc1      = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(&M1[c]), xc));
+            acc2      = _mm_add_ps(acc2, _mm_mul_ps(_mm_loadu_ps(&M2[c]), xc));
+            acc3      = _mm_add_ps(acc3, _mm_mul_ps(_mm_loadu_ps(&M3[c]), xc));
+        }
+        float s0 = mvm_hsum128(acc0);
+        float s1 = mvm_hsum128(acc1);
+        float s2 = mvm_hsum128(acc2);
+        float s3 = mvm_hsum128(acc3);
+        for(long c = ncol4; c < ncol; c++)
+        {
+            s0 += M0[c] * x[c];
+            s1 += M1[c] * x[c];
+            s2 += M2[c] * x[c];
+            s3 += M3[c] * x[c];
+        }
+        y[r]     = s0;
+        y[r + 1] = s1;
+        y[r + 2] = s2;
+        y[r + 3] = s3;
+    }
+    for(; r < nrow; r++)
+    {
+        const float *Mr  = &M[r * ldm];
+        __m128       acc = _mm_setzero_ps();
+        for(long c = 0; c < ncol4; c += 4)
+        {
+            acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(&Mr[c]), _mm_loadu_ps(&x[c])));
+        }
+        float s = mvm_hsum128(acc);
+        for(long c = ncol4; c < ncol; c++)
+        {
+            s += Mr[c] * x[c];
+        }
+        y[r] = s;
+    }
+}
+
+
+
+
+__attribute__((target("avx2,fma")))
+static inline float mvm_hsum256(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s        = _mm_hadd_ps(s, s);
+    s        = _mm_hadd_ps(s, s);
+    return _mm_cvtss_f32(s);
+}
+
+
+/**
+ * @brief AVX2 + FMA kernel, 8 lanes
+ */
+__attribute__((target("avx2,fma")))
+static void mvm_avx2(long                  nrow,
+                     long                  ncol,
+                     long                  ldm,
+                     const float *restrict M,
+                     const float *restrict x,
+                     float *restrict       y)
+{
+    long ncol8 = ncol & ~7L;
+
+    long r = 0;
+    for(; r + MVM_NBROW <= nrow; r += MVM_NBROW)
+    {
+        const float *M0 = &M[r * ldm];
+        const float *M1 = M0 + ldm;
+        const float *M2 = M1 + ldm;
+        const float *M3 = M2 + ldm;
+
+        __m256 acc0 = _mm256_setzero_ps();
+        __m256 acc1 = _mm256_setzero_ps();
+        __m256 acc2 = _mm256_setzero_ps();
+        __m256 acc3 = _mm256_setzero_ps();
+        for(long c = 0; c < ncol8; c += 8)
+        {
+            __m256 xc = _mm256_loadu_ps(&x[c]);
+            acc0      = _mm256_fmadd_ps(_mm256_loadu_ps(&M0[c]), xc, acc0);
+            acc1      = _mm256_fmadd_ps(_mm256_loadu_ps(&M1[c]), xc, acc1);
+            acc2      = _mm256_fmadd_ps(_mm256_loadu_ps(&M2[c]), xc, acc2);
+            acc3      = _mm256_fmadd_ps(_mm256_loadu_ps(&M3[c]), xc, acc3);
+        }
+        float s0 = mvm_hsum256(acc0);
+        float s1 = mvm_hsum256(acc1);
+        float s2 = mvm_hsum256(acc2);
+        float s3 = mvm_hsum256(acc3);
+        for(long c = ncol8; c < ncol; c++)
+        {
+            s0 += M0[c] * x[c];
+            s1 += M1[c] * x[c];
+            s2 += M2[c] * x[c];
+            s3 += M3[c] * x[c];
+        }
+        y[r]     = s0;
+        y[r + 1] = s1;
+        y[r + 2] = s2;
+        y[r + 3] = s3;
+    }
+    for(; r < nrow; r++)
+    {
+        const float *Mr  = &M[r * ldm];
+        __m256       acc = _mm256_setzero_ps();
+        for(long c = 0; c < ncol8; c += 8)
+        {
+            acc = _mm256_fmadd_ps(_mm256_loadu_ps(&Mr[c]), _mm256_loadu_ps(&x[c]), acc);
+        }
+        float s = mvm_hsum256(acc);
+        for(long c = ncol8; c < ncol; c++)
+        {
+            s += Mr[c] * x[c];
+        }
+        y[r] = s;
+    }
+}
+
+
+
+
+/**
+ * @brief AVX-512 kernel, 16 lanes, masked tail
+ */
+__attribute__((target("avx512f")))
+static void mvm_avx512(long                  nrow,
+                       long                  ncol,
+                       long                  ldm,
+                       const float *restrict M,
+                       const float *restrict x,
+                       float *restrict       y)
+{
+    long      ncol16 = ncol & ~15L;
+    __mmask16 tail   = (__mmask16)((1U << (ncol - ncol16)) - 1);
+
+    long r = 0;
+    for(; r + MVM_NBROW <= nrow; r += MVM_NBROW)
+    {
+        const float *M0 = &M[r * ldm];
+        const float *M1 = M0 + ldm;
+        const float *M2 = M1 + ldm;
+        const float *M3 = M2 + ldm;
+
+        __m512 acc0 = _mm512_setzero_ps();
+        __m512 acc1 = _mm512_setzero_ps();
+        __m512 acc2 = _mm512_setzero_ps();
+        __m512 acc3 = _mm512_setzero_ps();
+        for(long c = 0; c < ncol16; c += 16)
+        {
+            __m512 xc = _mm512_loadu_ps(&x[c]);
+            acc0      = _mm512_fmadd_ps(_mm512_loadu_ps(&M0[c]), xc, acc0);
+            acc1      = _mm512_fmadd_ps(_mm512_loadu_ps(&M1[c]), xc, acc1);
+            acc2      = _mm512_fmadd_ps(_mm512_loadu_ps(&M2[c]), xc, acc2);
+            acc3      = _mm512_fmadd_ps(_mm512_loadu_ps(&M3[c]), xc, acc3);
+        }
+        if(tail != 0)
+        {
+            __m512 xc = _mm512_maskz_loadu_ps(tail, &x[ncol16]);
+            acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, &M0[ncol16]), xc, acc0);
+            acc1 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, &M1[ncol16]), xc, acc1);
+            acc2 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, &M2[ncol16]), xc, acc2);
+            acc3 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, &M3[ncol16]), xc, acc3);
+        }
+        y[r]     = _mm512_reduce_add_ps(acc0);
+        y[r + 1] = _mm512_reduce_add_ps(acc1);
+        y[r + 2] = _mm512_reduce_add_ps(acc2);
+        y[r + 3] = _mm512_reduce_add_ps(acc3);
+    }
+    for(; r < nrow; r++)
+    {
+        const float *Mr  = &M[r * ldm];
+        __m512       acc = _mm512_setzero_ps();
+        for(long c = 0; c < ncol16; c += 16)
+        {
+            acc = _mm512_fmadd_ps(_mm512_loadu_ps(&Mr[c]), _mm512_loadu_ps(&x[c]), acc);
+        }
+        if(tail != 0)
+        {
+            acc = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(tail, &Mr[ncol16]),
+                                  _mm512_maskz_loadu_ps(tail, &x[ncol16]),
+                                  acc);
+        }
+        y[r] = _mm512_reduce_add_ps(acc);
+    }
+}
+
+#endif
+
+
+
+
+/**
+ * @brief Select MVM kernel
+ *
+ * kernel is "auto" (or NULL) for the fastest kernel supported by the
+ * CPU, or one of "generic", "sse", "avx2", "avx512". A kernel not
+ * supported by the CPU falls back to automatic selection.
+ *
+ * @return kernel function, name of selected kernel in *name
+ */
+LINARFILTERPRED_MVM_FUNC linARfilterPred_mvm_select(const char  *kernel,
+        const char **name)
+{
+    int auto_select = ((kernel == NULL) || (strcmp(kernel, "auto") == 0));
+
+    if((auto_select == 0) && (strcmp(kernel, "generic") == 0))
+    {
+        *name = "generic";
+        return mvm_generic;
+    }
+
+#ifdef LINPF_MVM_X86
+    __builtin_cpu_init();
+    int has_avx512 = __builtin_cpu_supports("avx512f");
+    int has_avx2 =
+        __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+    int has_sse = __builtin_cpu_supports("sse3");
+
+    if(auto_select == 0)
+    {
+        if((strcmp(kernel, "avx512") == 0) && has_avx512)
+        {
+            *name = "avx512";
+            return mvm_avx512;
+        }
+        if((strcmp(kernel, "avx2") == 0) && has_avx2)
+        {
+            *name = "avx2";
+            return mvm_avx2;
+        }
+        if((strcmp(kernel, "sse") == 0) && has_sse)
+        {
+            *name = "sse";
+            return mvm_sse;
+        }
+        PRINT_WARNING("MVM kernel %s not available - automatic selection", kernel);
+    }
+
+    if(has_avx512)
+    {
+        *name = "avx512";
+        return mvm_avx512;
+    }
+    if(has_avx2)
+    {
+        *name = "avx2";
+        return mvm_avx2;
+    }
+    if(has_sse)
+    {
+        *name = "sse";
+        return mvm_sse;
+    }
+#else
+    if(auto_select == 0)
+    {
+        PRINT_WARNING("MVM kernel %s not available - automatic selection", kernel);
+    }
+#endif
+
+    *name = "generic";
+    return mvm_generic;
+}
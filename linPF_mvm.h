@@ -0,0 +1,25 @@
+/**
+ * @file    linPF_mvm.h
+ * @brief   Matrix-vector multiplication kernels for real-time filter apply
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_MVM_H
+#define LINARFILTERPRED_LINPF_MVM_H
+
+/** @brief y = M x, M nrow x ncol with leading dimension ldm
+ *
+ * M, x and y must not overlap.
+ */
+typedef void (*LINARFILTERPRED_MVM_FUNC)(long                  nrow,
+        long                  ncol,
+        long                  ldm,
+        const float *restrict M,
+        const float *restrict x,
+        float *restrict       y);
+
+LINARFILTERPRED_MVM_FUNC linARfilterPred_mvm_select(const char  *kernel,
+        const char **name);
+
+#endif
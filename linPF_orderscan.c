@@ -0,0 +1,273 @@
+/**
+ * @file    linPF_orderscan.c
+ * @brief   Filter order selection by cross-validation
+ *
+ * Normal-equation statistics are accumulated once for the maximum order,
+ * separately for NBfold contiguous time segments. Since the statistics of
+ * a lower order filter are leading sub-blocks of the maximum order ones,
+ * all orders are solved and scored from the same accumulation: for each
+ * fold, the filter is solved on the other folds (total minus fold
+ * statistics) and its residual evaluated on the fold.
+ *
+ * Statistics and solver work arrays are carved out of an arena by
+ * linARfilterPred_orderscan_carve(), so that the scan does not allocate
+ * memory.
+ */
+
+#include <math.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_arena.h"
+#include "linPF_gram.h"
+#include "linPF_orderscan.h"
+
+
+
+
+/**
+ * @brief Carve order scan workspace for NBfold folds out of arena
+ *
+ * Called first on a sizing arena to measure the footprint, then on the
+ * allocated arena. NBfold is raised to 2 if smaller.
+ */
+void linARfilterPred_orderscan_carve(LINARFILTERPRED_ARENA        *arena,
+                                     LINARFILTERPRED_ORDERSCAN_WS *ws,
+                                     long                          NBpixin,
+                                     long                          NBpixout,
+                                     long                          PFordermax,
+                                     long                          NBfold)
+{
+    long n = NBpixin * PFordermax;
+
+    if(NBfold < 2)
+    {
+        NBfold = 2;
+    }
+    ws->NBfold = NBfold;
+
+    long    gramsize = linARfilterPred_gram_bufsize(n, NBpixout);
+    double *grambuf;
+
+    ws->gramfold = linARfilterPred_arena_alloc(arena,
+                   sizeof(LINARFILTERPRED_GRAM) * NBfold);
+    for(long fold = 0; fold < NBfold; fold++)
+    {
+        grambuf = linARfilterPred_arena_alloc(arena, sizeof(double) * gramsize);
+        if(grambuf != NULL)
+        {
+            linARfilterPred_gram_init_buffer(&ws->gramfold[fold],
+                                             n,
+                                             NBpixout,
+                                             grambuf);
+        }
+    }
+    grambuf = linARfilterPred_arena_alloc(arena, sizeof(double) * gramsize);
+    if(grambuf != NULL)
+    {
+        linARfilterPred_gram_init_buffer(&ws->gramtot, n, NBpixout, grambuf);
+    }
+
+    ws->Gsub = linARfilterPred_arena_alloc(arena, sizeof(double) * n * n);
+    ws->Csub = linARfilterPred_arena_alloc(arena, sizeof(double) * NBpixout * n);
+    ws->Wsub = linARfilterPred_arena_alloc(arena, sizeof(double) * NBpixout * n);
+    ws->solvebuf = linARfilterPred_arena_alloc(arena,
+                   sizeof(double) * linARfilterPred_gram_solve_bufsize(n));
+    ws->errcurve = linARfilterPred_arena_alloc(arena,
+                   sizeof(double) * PFordermax);
+    ws->Wbest = linARfilterPred_arena_alloc(arena,
+                                            sizeof(double) * NBpixout * n);
+}
+
+
+
+
+/**
+ * @brief Cross-validated prediction error as a function of filter order
+ *
+ * Uses ws->NBfold folds. ws->errcurve[p-1] is the mean squared
+ * prediction residual (summed over outputs, per sample) of the order p
+ * filter on held-out samples.
+ *
+ * The selected order is the smallest one whose error is within a
+ * fraction kneetol of the minimum error. Its filter, solved from all
+ * samples, is written in ws->Wbest (NBpixout x NBpixin*PFordermax, same
+ * layout as the 2D filter), with zero coefficients for time steps
+ * beyond the selected order.
+ *
+ * If ave_inarray is not NULL, input and output offsets ave_inarray and
+ * ave_outarray are removed from the statistics. Samples with
+ * samplevalid[m] = 0 are skipped (none if samplevalid is NULL).
+ * eigws holds PFordermax gsl eigen workspaces, of sizes NBpixin x
+ * order, see linARfilterPred_gram_eigen_alloc().
+ *
+ * @return selected order
+ */
+long linARfilterPred_orderscan(const float                   *incp,
+                               uint64_t                       xysize,
+                               long                           NBpixin,
+                               const long                    *pixarray_xy,
+                               const double                  *ave_inarray,
+                               long                           NBpixout,
+                               const long                    *outpixarray_xy,
+                               const double                  *ave_outarray,
+                               long                           PFordermax,
+                               float                          PFlag,
+                               long                           NBmvec,
+                               const uint8_t                 *samplevalid,
+                               double                         SVDeps,
+                               float                          kneetol,
+                               LINARFILTERPRED_ORDERSCAN_WS  *ws,
+                               gsl_eigen_symmv_workspace    **eigws)
+{
+    DEBUG_TRACE_FSTART();
+
+    long                  n        = NBpixin * PFordermax;
+    long                  NBfold   = ws->NBfold;
+    LINARFILTERPRED_GRAM *gramfold = ws->gramfold;
+    double               *errcurve = ws->errcurve;
+    double               *Wbest    = ws->Wbest;
+    double               *Gsub     = ws->Gsub;
+    double               *Csub     = ws->Csub;
+    double               *Wsub     = ws->Wsub;
+
+    // Accumulate per-fold statistics, and total
+    //
+    LINARFILTERPRED_GRAM *gramtot = &ws->gramtot;
+    linARfilterPred_gram_reset(gramtot);
+
+    for(long fold = 0; fold < NBfold; fold++)
+    {
+        long mstart = NBmvec * fold / NBfold;
+        long mend   = NBmvec * (fold + 1) / NBfold;
+
+        linARfilterPred_gram_reset(&gramfold[fold]);
+        linARfilterPred_gram_accumulate_valid(&gramfold[fold],
+                                              incp,
+                                              xysize,
+                                              NBpixin,
+                                              pixarray_xy,
+                                              NBpixout,
+                                              outpixarray_xy,
+                                              PFordermax,
+                                              PFlag,
+                                              mstart,
+                                              mend,
+                                              samplevalid);
+        linARfilterPred_gram_symmetrize(&gramfold[fold]);
+        if(ave_inarray != NULL)
+        {
+            linARfilterPred_gram_center(&gramfold[fold],
+                                        NBpixin,
+                                        ave_inarray,
+                                        ave_outarray);
+        }
+
+        for(long i = 0; i < n * n; i++)
+        {
+            gramtot->G[i] += gramfold[fold].G[i];
+        }
+        for(long i = 0; i < NBpixout * n; i++)
+        {
+            gramtot->C[i] += gramfold[fold].C[i];
+        }
+        for(long j = 0; j < NBpixout; j++)
+        {
+            gramtot->yty[j] += gramfold[fold].yty[j];
+        }
+        gramtot->NBsample += gramfold[fold].NBsample;
+    }
+
+    // Score each order
+    //
+    for(long order = 1; order <= PFordermax; order++)
+    {
+        long nsub = NBpixin * order;
+
+        double err = 0.0;
+        for(long fold = 0; fold < NBfold; fold++)
+        {
+            // training statistics = total - fold
+            for(long i = 0; i < nsub; i++)
+                for(long l = 0; l < nsub; l++)
+                {
+                    Gsub[i * nsub + l] =
+                        gramtot->G[i * n + l] - gramfold[fold].G[i * n + l];
+                }
+            for(long j = 0; j < NBpixout; j++)
+                for(long i = 0; i < nsub; i++)
+                {
+                    Csub[j * nsub + i] =
+                        gramtot->C[j * n + i] - gramfold[fold].C[j * n + i];
+                }
+
+            linARfilterPred_gram_solve_buffer(Gsub,
+                                              nsub,
+                                              Csub,
+                                              NBpixout,
+                                              SVDeps,
+                                              Wsub,
+                                              eigws[order - 1],
+                                              ws->solvebuf);
+            err += linARfilterPred_gram_residual(&gramfold[fold], Wsub, nsub);
+        }
+        errcurve[order - 1] = err / gramtot->NBsample;
+
+        printf("    order %3ld   cross-validated residual = %g\n",
+               order,
+               errcurve[order - 1]);
+    }
+
+    // Select order at knee of error curve
+    //
+    double errmin = errcurve[0];
+    for(long order = 1; order <= PFordermax; order++)
+    {
+        if(errcurve[order - 1] < errmin)
+        {
+            errmin = errcurve[order - 1];
+        }
+    }
+    long bestorder = PFordermax;
+    for(long order = PFordermax; order >= 1; order--)
+    {
+        if(errcurve[order - 1] <= errmin * (1.0 + kneetol))
+        {
+            bestorder = order;
+        }
+    }
+
+    // Solve selected order from all samples
+    //
+    {
+        long nsub = NBpixin * bestorder;
+        for(long i = 0; i < nsub; i++)
+            for(long l = 0; l < nsub; l++)
+            {
+                Gsub[i * nsub + l] = gramtot->G[i * n + l];
+            }
+        for(long j = 0; j < NBpixout; j++)
+            for(long i = 0; i < nsub; i++)
+            {
+                Csub[j * nsub + i] = gramtot->C[j * n + i];
+            }
+
+        linARfilterPred_gram_solve_buffer(Gsub,
+                                          nsub,
+                                          Csub,
+                                          NBpixout,
+                                          SVDeps,
+                                          Wsub,
+                                          eigws[bestorder - 1],
+                                          ws->solvebuf);
+
+        for(long j = 0; j < NBpixout; j++)
+            for(long i = 0; i < n; i++)
+            {
+                Wbest[j * n + i] = (i < nsub) ? Wsub[j * nsub + i] : 0.0;
+            }
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return bestorder;
+}
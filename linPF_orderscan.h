@@ -0,0 +1,53 @@
+/**
+ * @file    linPF_orderscan.h
+ * @brief   Filter order selection by cross-validation
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_ORDERSCAN_H
+#define LINARFILTERPRED_LINPF_ORDERSCAN_H
+
+#include "linPF_arena.h"
+#include "linPF_gram.h"
+
+/** @brief Order scan workspace, carved out of an arena
+ */
+typedef struct
+{
+    long                  NBfold;
+    LINARFILTERPRED_GRAM *gramfold; ///< NBfold, n x NBpixout each
+    LINARFILTERPRED_GRAM  gramtot;  ///< n x NBpixout
+    double               *Gsub;     ///< n x n
+    double               *Csub;     ///< NBpixout x n
+    double               *Wsub;     ///< NBpixout x n
+    double               *solvebuf; ///< gram_solve_bufsize(n)
+    double               *errcurve; ///< PFordermax
+    double               *Wbest;    ///< NBpixout x n
+} LINARFILTERPRED_ORDERSCAN_WS;
+
+void linARfilterPred_orderscan_carve(LINARFILTERPRED_ARENA        *arena,
+                                     LINARFILTERPRED_ORDERSCAN_WS *ws,
+                                     long                          NBpixin,
+                                     long                          NBpixout,
+                                     long                          PFordermax,
+                                     long                          NBfold);
+
+long linARfilterPred_orderscan(const float                   *incp,
+                               uint64_t                       xysize,
+                               long                           NBpixin,
+                               const long                    *pixarray_xy,
+                               const double                  *ave_inarray,
+                               long                           NBpixout,
+                               const long                    *outpixarray_xy,
+                               const double                  *ave_outarray,
+                               long                           PFordermax,
+                               float                          PFlag,
+                               long                           NBmvec,
+                               const uint8_t                 *samplevalid,
+                               double                         SVDeps,
+                               float                          kneetol,
+                               LINARFILTERPRED_ORDERSCAN_WS  *ws,
+                               gsl_eigen_symmv_workspace    **eigws);
+
+#endif
@@ -0,0 +1,261 @@
+/**
+ * @file    linPF_place.c
+ * @brief   CPU, NUMA memory and real-time scheduling placement
+ *
+ * The real-time apply loop reads the whole filter every frame. On
+ * multi-socket servers, pages allocated on another NUMA node are read
+ * across the socket interconnect, at lower bandwidth and higher latency.
+ *
+ * Placement is done in this order:
+ * - pin the loop thread to its CPU set, so that buffers it creates are
+ *   first touched, and placed, on the local node
+ * - migrate pages of existing streams to the node of the loop CPU
+ * - optionally keep a local copy of the filter, allocated by the pinned
+ *   thread, refreshed by the caller when the filter stream is updated
+ *
+ * Pages are migrated and queried with the move_pages system call, so
+ * that no NUMA library is needed. Pages are moved with MPOL_MF_MOVE_ALL,
+ * which also moves pages of shared memory streams mapped by other
+ * processes, and needs CAP_SYS_NICE. Without it, move_pages fails with
+ * EPERM and MPOL_MF_MOVE is used instead: shared pages then stay in
+ * place, which is why the fraction of pages actually on the local node
+ * is returned.
+ *
+ * SCHED_FIFO and memory locking need CAP_SYS_NICE and CAP_IPC_LOCK (or
+ * matching rlimits). Failures are reported and not fatal.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <errno.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_place.h"
+#include "linPF_sched.h"
+
+
+// move_pages flags, from numaif.h
+#define PLACE_MPOL_MF_MOVE     (1 << 1)
+#define PLACE_MPOL_MF_MOVE_ALL (1 << 2)
+
+// pages per move_pages call
+#define PLACE_NBPAGECHUNK 1024
+
+
+static const char *policyname[LINPF_NUMA_NBPOLICY] =
+{
+    "none",
+    "local",
+    "replicate"
+};
+
+
+
+
+/**
+ * @brief NUMA policy from name, -1 if unknown
+ */
+int linARfilterPred_place_parsepolicy(const char *str)
+{
+    for(int policy = 0; policy < LINPF_NUMA_NBPOLICY; policy++)
+    {
+        if(strcmp(str, policyname[policy]) == 0)
+        {
+            return policy;
+        }
+    }
+    return -1;
+}
+
+
+
+
+const char *linARfilterPred_place_policyname(int policy)
+{
+    if((policy < 0) || (policy >= LINPF_NUMA_NBPOLICY))
+    {
+        return "unknown";
+    }
+    return policyname[policy];
+}
+
+
+
+
+/**
+ * @brief Restrict calling thread to CPU set, for example "4" or "4-5"
+ *
+ * @return number of CPUs in set, 0 if cpuset is "none", -1 on error
+ */
+long linARfilterPred_place_thread(const char *cpuset)
+{
+    int  cpulist[LINPF_SCHED_NBCPUMAX];
+    long NBcpu = linARfilterPred_sched_cpuset_parse(cpuset,
+                 cpulist,
+                 LINPF_SCHED_NBCPUMAX);
+    if(NBcpu < 1)
+    {
+        return NBcpu;
+    }
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for(long i = 0; i < NBcpu; i++)
+    {
+        CPU_SET(cpulist[i], &mask);
+    }
+    if(sched_setaffinity(0, sizeof(cpu_set_t), &mask) != 0)
+    {
+        PRINT_WARNING("cannot set CPU set \"%s\"", cpuset);
+        return -1;
+    }
+    // move now, not at next scheduling event
+    sched_yield();
+
+    return NBcpu;
+}
+
+
+
+
+/**
+ * @brief NUMA node of CPU running the calling thread
+ */
+int linARfilterPred_place_node(int *cpu)
+{
+    unsigned int cpuval  = 0;
+    unsigned int nodeval = 0;
+    if(syscall(SYS_getcpu, &cpuval, &nodeval, NULL) != 0)
+    {
+        return -1;
+    }
+    if(cpu != NULL)
+    {
+        *cpu = (int) cpuval;
+    }
+    return (int) nodeval;
+}
+
+
+
+
+/**
+ * @brief Set SCHED_FIFO priority of calling thread
+ *
+ * @return 0 if set, -1 otherwise
+ */
+int linARfilterPred_place_fifo(int priority)
+{
+    struct sched_param schedpar;
+    schedpar.sched_priority = priority;
+    if(sched_setscheduler(0, SCHED_FIFO, &schedpar) != 0)
+    {
+        PRINT_WARNING("cannot set SCHED_FIFO priority %d", priority);
+        return -1;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * @brief Lock current and future pages of process in memory
+ *
+ * @return 0 if locked, -1 otherwise
+ */
+int linARfilterPred_place_mlock()
+{
+    if(mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        PRINT_WARNING("cannot lock memory");
+        return -1;
+    }
+    return 0;
+}
+
+
+
+
+/**
+ * @brief Migrate pages of memory range to node (if move is 1)
+ *
+ * @return fraction of pages on node, -1 if unknown
+ */
+double linARfilterPred_place_pages(const void *ptr,
+                                   size_t      nbytes,
+                                   int         node,
+                                   int         move)
+{
+    long      pagesize = sysconf(_SC_PAGESIZE);
+    uintptr_t start    = ((uintptr_t) ptr) & ~((uintptr_t) pagesize - 1);
+    uintptr_t end      = (uintptr_t) ptr + nbytes;
+    long      NBpage   = (end - start + pagesize - 1) / pagesize;
+    if((NBpage < 1) || (node < 0))
+    {
+        return -1.0;
+    }
+
+    void *pages[PLACE_NBPAGECHUNK];
+    int   nodes[PLACE_NBPAGECHUNK];
+    int   status[PLACE_NBPAGECHUNK];
+    long  NBpagenode = 0;
+    int   moveflag   = PLACE_MPOL_MF_MOVE_ALL;
+    for(long page0 = 0; page0 < NBpage; page0 += PLACE_NBPAGECHUNK)
+    {
+        long NBp = NBpage - page0;
+        if(NBp > PLACE_NBPAGECHUNK)
+        {
+            NBp = PLACE_NBPAGECHUNK;
+        }
+        for(long p = 0; p < NBp; p++)
+        {
+            pages[p] = (void *)(start + (page0 + p) * pagesize);
+            nodes[p] = node;
+        }
+
+        if(move == 1)
+        {
+            // pages which cannot be moved keep their node, reported below
+            if((syscall(SYS_move_pages,
+                        0,
+                        NBp,
+                        pages,
+                        nodes,
+                        status,
+                        moveflag) != 0) &&
+                    (errno == EPERM) && (moveflag == PLACE_MPOL_MF_MOVE_ALL))
+            {
+                // no CAP_SYS_NICE: move pages not shared with others only
+                moveflag = PLACE_MPOL_MF_MOVE;
+                syscall(SYS_move_pages,
+                        0,
+                        NBp,
+                        pages,
+                        nodes,
+                        status,
+                        moveflag);
+            }
+        }
+        if(syscall(SYS_move_pages, 0, NBp, pages, NULL, status, 0) != 0)
+        {
+            return -1.0;
+        }
+        for(long p = 0; p < NBp; p++)
+        {
+            if(status[p] == node)
+            {
+                NBpagenode++;
+            }
+        }
+    }
+
+    return 1.0 * NBpagenode / NBpage;
+}
@@ -0,0 +1,36 @@
+/**
+ * @file    linPF_place.h
+ * @brief   CPU, NUMA memory and real-time scheduling placement
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_PLACE_H
+#define LINARFILTERPRED_LINPF_PLACE_H
+
+#include <stddef.h>
+
+// NUMA memory policies
+#define LINPF_NUMA_NONE      0 // leave pages where they are
+#define LINPF_NUMA_LOCAL     1 // migrate pages to local node
+#define LINPF_NUMA_REPLICATE 2 // migrate, and use local copy of filter
+#define LINPF_NUMA_NBPOLICY  3
+
+int linARfilterPred_place_parsepolicy(const char *str);
+
+const char *linARfilterPred_place_policyname(int policy);
+
+long linARfilterPred_place_thread(const char *cpuset);
+
+int linARfilterPred_place_node(int *cpu);
+
+int linARfilterPred_place_fifo(int priority);
+
+int linARfilterPred_place_mlock();
+
+double linARfilterPred_place_pages(const void *ptr,
+                                   size_t      nbytes,
+                                   int         node,
+                                   int         move);
+
+#endif
@@ -0,0 +1,140 @@
+/**
+ * @file    linPF_plan.c
+ * @brief   Memory and runtime estimates of filter build strategies
+ *
+ * Peak memory and runtime of each build strategy are estimated from the
+ * problem sizes, so that a strategy fitting the memory budget can be
+ * selected before running out of memory.
+ *
+ * With n = NBpixin x PForder regressors, N = NBmvec samples and
+ * nout = NBpixout outputs, dominant terms are:
+ *
+ * | strategy | memory                      | operations                |
+ * |----------|-----------------------------|---------------------------|
+ * | SVD      | 3 N n (float) + 3 n^2       | N n^2 + 10 n^3 + N n nout |
+ * | Gram     | n^2 + 2 n nout + 2 n^2      | N n (n/2 + nout) + 10 n^3 |
+ * | SVDwarm  | N n (float) + N rank        | 4 NBsweep N n rank        |
+ * | TSQR     | NBthread (p + block) p      | 2 N p^2 + 10 n^3          |
+ * | OOC      | Gram + 2 chunk buffers      | Gram + telemetry read     |
+ *
+ * with p = n + nout. All but out-of-core also hold a copy of the
+ * telemetry. Runtimes assume a sustained rate of GFLOPS, and 1 GB/s
+ * file read for out-of-core. These are estimates for planning, not
+ * measurements.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_plan.h"
+
+
+// sustained read rate for out-of-core telemetry [byte/s]
+#define PLAN_READRATE 1.0e9
+
+
+
+
+/**
+ * @brief Estimate peak memory and runtime of strategy
+ *
+ * @return RETURN_SUCCESS, RETURN_FAILURE if strategy is unknown
+ */
+errno_t linARfilterPred_plan_estimate(const LINARFILTERPRED_PLANSIZE *ps,
+                                      int                             strategy,
+                                      double                         *memGB,
+                                      double                         *tsec)
+{
+    double N    = ps->NBmvec;
+    double n    = 1.0 * ps->NBpixin * ps->PForder;
+    double nout = ps->NBpixout;
+    double p    = n + nout;
+    double k    = (ps->rank < n) ? ps->rank : n;
+
+    // telemetry copy, and 2D filters (new, raw, mixed)
+    double memtelem  = 4.0 * ps->nbspl * ps->xysize;
+    double memfilter = 3.0 * 4.0 * nout * n;
+
+    double mem   = 0.0;
+    double flops = 0.0;
+    double tread = 0.0;
+
+    double memgram   = 8.0 * (n * n + 2.0 * n * nout) + 8.0 * 2.0 * n * n;
+    double flopsgram = 2.0 * N * n * (0.5 * n + nout) + 10.0 * n * n * n;
+
+    switch(strategy)
+    {
+        case LINPF_PLAN_SVD:
+            mem   = memtelem + 4.0 * (3.0 * N * n + N * nout) + 8.0 * 3.0 * n * n;
+            flops = 2.0 * N * n * n + 10.0 * n * n * n + 2.0 * N * n * nout;
+            break;
+
+        case LINPF_PLAN_GRAM:
+            mem   = memtelem + memgram;
+            flops = flopsgram;
+            break;
+
+        case LINPF_PLAN_SVDWARM:
+            mem = memtelem + 4.0 * (N * n + N * nout) + 12.0 * N * k +
+                  8.0 * (2.0 * n * k + nout * n);
+            flops = 4.0 * ps->NBsweep * N * n * k + 2.0 * N * k * (k + nout);
+            break;
+
+        case LINPF_PLAN_TSQR:
+            mem = memtelem + 8.0 * ps->NBthread * (2.0 * p + ps->blocksize) * p +
+                  8.0 * 3.0 * n * n;
+            flops = 2.0 * N * p * p + 10.0 * n * n * n;
+            break;
+
+        case LINPF_PLAN_OOC:
+            mem   = memgram + 2.0 * 4.0 * ps->chunksize * ps->xysize;
+            flops = flopsgram;
+            tread = memtelem / PLAN_READRATE;
+            break;
+
+        default:
+            return RETURN_FAILURE;
+    }
+
+    *memGB = (mem + memfilter) / 1024.0 / 1024.0 / 1024.0;
+    *tsec  = flops / (ps->GFLOPS * 1.0e9) + tread;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Select fastest strategy fitting memory budget
+ *
+ * Strategies are considered in the order listed in strategylist.
+ * memGB and tsec receive the estimates, indexed as strategylist.
+ *
+ * @return selected strategy, -1 if none fits
+ */
+int linARfilterPred_plan_select(const LINARFILTERPRED_PLANSIZE *ps,
+                                const int                      *strategylist,
+                                int                             NBstrategy,
+                                double                          budgetGB,
+                                double                         *memGB,
+                                double                         *tsec)
+{
+    int    strategy = -1;
+    double tbest    = 0.0;
+
+    for(int i = 0; i < NBstrategy; i++)
+    {
+        linARfilterPred_plan_estimate(ps, strategylist[i], &memGB[i], &tsec[i]);
+        if(memGB[i] > budgetGB)
+        {
+            continue;
+        }
+        if((strategy == -1) || (tsec[i] < tbest))
+        {
+            strategy = strategylist[i];
+            tbest    = tsec[i];
+        }
+    }
+
+    return strategy;
+}
@@ -0,0 +1,49 @@
+/**
+ * @file    linPF_plan.h
+ * @brief   Memory and runtime estimates of filter build strategies
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_PLAN_H
+#define LINARFILTERPRED_LINPF_PLAN_H
+
+// build strategies, same values as mkPF .solver
+#define LINPF_PLAN_SVD     0
+#define LINPF_PLAN_GRAM    1
+#define LINPF_PLAN_SVDWARM 2
+#define LINPF_PLAN_TSQR    3
+// out-of-core build, command mkPFooc
+#define LINPF_PLAN_OOC     5
+
+/** @brief Problem sizes and settings used for estimates
+ */
+typedef struct
+{
+    long   nbspl;     ///< number of telemetry frames
+    long   xysize;    ///< telemetry frame size
+    long   NBpixin;   ///< number of input variables
+    long   NBpixout;  ///< number of output variables
+    long   PForder;   ///< filter order
+    long   NBmvec;    ///< number of training samples
+    long   rank;      ///< subspace rank (SVDwarm)
+    long   NBsweep;   ///< sweeps per iteration (SVDwarm)
+    long   blocksize; ///< row block size (TSQR)
+    long   chunksize; ///< frames per chunk (OOC)
+    long   NBthread;  ///< number of threads
+    double GFLOPS;    ///< sustained computing rate [GFLOP/s]
+} LINARFILTERPRED_PLANSIZE;
+
+errno_t linARfilterPred_plan_estimate(const LINARFILTERPRED_PLANSIZE *ps,
+                                      int                             strategy,
+                                      double                         *memGB,
+                                      double                         *tsec);
+
+int linARfilterPred_plan_select(const LINARFILTERPRED_PLANSIZE *ps,
+                                const int                      *strategylist,
+                                int                             NBstrategy,
+                                double                          budgetGB,
+                                double                         *memGB,
+                                double                         *tsec);
+
+#endif
@@ -0,0 +1,279 @@
+/**
+ * @file    linPF_rtpool.c
+ * @brief   Pinned spinning worker threads for real-time filter MVM
+ *
+ * The filter rows are split into one slice per worker. Each worker is
+ * pinned to its CPU, and keeps a copy of its slice allocated from that
+ * CPU (first touch), so that the slice stays in the CPU's cache between
+ * frames. The copy is refreshed when the filter stream counter changes.
+ *
+ * Workers spin on a shared frame counter instead of waiting on a
+ * semaphore, to avoid wake-up latency. When the counter is incremented,
+ * each worker computes its slice of the output and increments the
+ * completion counter. The caller spins until all workers are done
+ * (lock-free barrier), and then publishes the output.
+ *
+ * Counters only increase, so that no reset is needed between frames:
+ * after frame k, the completion counter is NBworker x (k+1), including
+ * the initial ready signal of each worker.
+ *
+ * Slices are multiples of 16 rows, so that workers do not write to the
+ * same output cache line.
+ *
+ * With split apply (ncol0 > 0), each worker computes the older inputs
+ * contribution of its slice for the next frame right after signaling
+ * completion, while the caller publishes the output: on the next frame,
+ * only the most recent input columns are multiplied, see linPF_tfir.c.
+ * The caller only writes the next input outside of the part of x read
+ * by this computation (ring buffer head slot).
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sched.h>
+#include <stdlib.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_rtpool.h"
+
+
+// rows per slice are a multiple of RTPOOL_ROWALIGN
+#define RTPOOL_ROWALIGN 16
+
+
+static inline void rtpool_cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    __asm__ volatile("" ::: "memory");
+#endif
+}
+
+
+
+
+/**
+ * @brief Copy worker rows of filter to local buffer
+ */
+static void rtpool_worker_copy(LINARFILTERPRED_RTWORKER *worker)
+{
+    LINARFILTERPRED_RTPOOL *pool = worker->pool;
+
+    if(pool->Mcnt != NULL)
+    {
+        worker->Mcnt0 = *pool->Mcnt;
+    }
+    for(long r = worker->rowstart; r < worker->rowend; r++)
+    {
+        memcpy(&worker->Mloc[(r - worker->rowstart) * pool->ncol],
+               &pool->M[r * pool->ldm],
+               sizeof(float) * pool->ncol);
+    }
+}
+
+
+
+
+static void *rtpool_worker(void *ptr)
+{
+    LINARFILTERPRED_RTWORKER *worker = (LINARFILTERPRED_RTWORKER *) ptr;
+    LINARFILTERPRED_RTPOOL   *pool   = worker->pool;
+
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    CPU_SET(worker->cpu, &mask);
+    if(sched_setaffinity(0, sizeof(cpu_set_t), &mask) != 0)
+    {
+        PRINT_WARNING("cannot pin MVM worker to CPU %d", worker->cpu);
+    }
+
+    long nrow = worker->rowend - worker->rowstart;
+    if(nrow > 0)
+    {
+        // allocated and touched from pinned thread: local memory
+        worker->Mloc = (float *) aligned_alloc(64,
+                                               ((sizeof(float) * nrow * pool->ncol + 63) / 64) * 64);
+        if(worker->Mloc == NULL)
+        {
+            PRINT_ERROR("aligned_alloc returns NULL pointer");
+            abort();
+        }
+        rtpool_worker_copy(worker);
+        linARfilterPred_tfir_init(&worker->tfir,
+                                  pool->mvmfunc,
+                                  nrow,
+                                  (pool->ncol0 > 0) ? pool->ncol0 : pool->ncol,
+                                  pool->ncol,
+                                  pool->ncol,
+                                  worker->Mloc,
+                                  NULL);
+    }
+
+    // ready
+    atomic_fetch_add_explicit(&pool->donecnt, 1, memory_order_release);
+
+    uint64_t frame = 0;
+    while(1)
+    {
+        uint64_t framenew;
+        while((framenew = atomic_load_explicit(&pool->framecnt,
+                                               memory_order_acquire)) == frame)
+        {
+            if(atomic_load_explicit(&pool->stop, memory_order_relaxed) == 1)
+            {
+                return NULL;
+            }
+            rtpool_cpu_relax();
+        }
+        frame = framenew;
+
+        const float *x = pool->x;
+        if(nrow > 0)
+        {
+            if((pool->Mcnt != NULL) && (*pool->Mcnt != worker->Mcnt0))
+            {
+                rtpool_worker_copy(worker);
+                worker->tfir.prevalid = 0;
+            }
+            linARfilterPred_tfir_output(&worker->tfir,
+                                        x,
+                                        &pool->y[worker->rowstart]);
+        }
+
+        atomic_fetch_add_explicit(&pool->donecnt, 1, memory_order_release);
+
+        if((nrow > 0) && (pool->ncol0 > 0))
+        {
+            linARfilterPred_tfir_prepare(&worker->tfir, x);
+        }
+    }
+
+    return NULL;
+}
+
+
+
+
+/**
+ * @brief Start one worker per CPU of cpulist
+ *
+ * Returns once all workers are running and hold their filter slice.
+ * Mcnt is the update counter of M (stream cnt0), NULL if M is fixed.
+ */
+errno_t linARfilterPred_rtpool_create(LINARFILTERPRED_RTPOOL  *pool,
+                                      const int               *cpulist,
+                                      int                      NBcpu,
+                                      LINARFILTERPRED_MVM_FUNC mvmfunc,
+                                      long                     nrow,
+                                      long                     ncol0,
+                                      long                     ncol,
+                                      long                     ldm,
+                                      const float             *M,
+                                      volatile uint64_t       *Mcnt,
+                                      float                   *y)
+{
+    DEBUG_TRACE_FSTART();
+
+    pool->NBworker = NBcpu;
+    pool->mvmfunc  = mvmfunc;
+    pool->nrow     = nrow;
+    pool->ncol0    = ncol0;
+    pool->ncol     = ncol;
+    pool->ldm      = ldm;
+    pool->M        = M;
+    pool->Mcnt     = Mcnt;
+    pool->x        = NULL;
+    pool->y        = y;
+    atomic_init(&pool->framecnt, 0);
+    atomic_init(&pool->donecnt, 0);
+    atomic_init(&pool->stop, 0);
+
+    pool->worker = (LINARFILTERPRED_RTWORKER *) malloc(
+                       sizeof(LINARFILTERPRED_RTWORKER) * NBcpu);
+    if(pool->worker == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    long slice = (nrow + NBcpu - 1) / NBcpu;
+    slice = ((slice + RTPOOL_ROWALIGN - 1) / RTPOOL_ROWALIGN) * RTPOOL_ROWALIGN;
+
+    for(int w = 0; w < NBcpu; w++)
+    {
+        LINARFILTERPRED_RTWORKER *worker = &pool->worker[w];
+        worker->pool     = pool;
+        worker->cpu      = cpulist[w];
+        worker->rowstart = (w * slice < nrow) ? w * slice : nrow;
+        worker->rowend   = (worker->rowstart + slice < nrow) ?
+                           worker->rowstart + slice : nrow;
+        worker->Mloc     = NULL;
+        worker->Mcnt0    = 0;
+        if(pthread_create(&worker->thread, NULL, rtpool_worker, worker) != 0)
+        {
+            PRINT_ERROR("pthread_create failed");
+            abort();
+        }
+    }
+
+    while(atomic_load_explicit(&pool->donecnt, memory_order_acquire) <
+            (uint64_t) NBcpu)
+    {
+        rtpool_cpu_relax();
+    }
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Compute y = M x with all workers, return when complete
+ *
+ * x may change between frames (for example a window into a ring buffer):
+ * it is published to the workers by the frame counter increment.
+ */
+errno_t linARfilterPred_rtpool_run(LINARFILTERPRED_RTPOOL *pool,
+                                   const float            *x)
+{
+    pool->x = x;
+    uint64_t frame =
+        atomic_fetch_add_explicit(&pool->framecnt, 1, memory_order_release) + 1;
+    uint64_t donetarget = (uint64_t) pool->NBworker * (frame + 1);
+
+    while(atomic_load_explicit(&pool->donecnt, memory_order_acquire) <
+            donetarget)
+    {
+        rtpool_cpu_relax();
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t linARfilterPred_rtpool_destroy(LINARFILTERPRED_RTPOOL *pool)
+{
+    atomic_store_explicit(&pool->stop, 1, memory_order_relaxed);
+    for(int w = 0; w < pool->NBworker; w++)
+    {
+        pthread_join(pool->worker[w].thread, NULL);
+        if(pool->worker[w].Mloc != NULL)
+        {
+            linARfilterPred_tfir_free(&pool->worker[w].tfir);
+        }
+        free(pool->worker[w].Mloc);
+    }
+    free(pool->worker);
+    pool->worker   = NULL;
+    pool->NBworker = 0;
+
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file    linPF_rtpool.h
+ * @brief   Pinned spinning worker threads for real-time filter MVM
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_RTPOOL_H
+#define LINARFILTERPRED_LINPF_RTPOOL_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+#include "linPF_mvm.h"
+#include "linPF_tfir.h"
+
+typedef struct LINARFILTERPRED_RTPOOL LINARFILTERPRED_RTPOOL;
+
+/** @brief Worker thread, owning rows rowstart to rowend-1 of the filter
+ */
+typedef struct
+{
+    LINARFILTERPRED_RTPOOL *pool;
+    pthread_t               thread;
+    int                     cpu;      ///< CPU the worker is pinned to
+    long                    rowstart;
+    long                    rowend;
+    float                  *Mloc;     ///< local copy of filter rows
+    uint64_t                Mcnt0;    ///< filter cnt0 at last copy
+    LINARFILTERPRED_TFIR    tfir;     ///< split apply of local rows
+} LINARFILTERPRED_RTWORKER;
+
+/** @brief Worker pool computing y = M x, one slice of rows per worker
+ *
+ * M is nrow x ncol with leading dimension ldm. M and y are fixed at
+ * creation: the pool is triggered once per frame with the input vector x.
+ * If ncol0 > 0, the first ncol0 columns multiply the most recent input,
+ * and workers compute the older inputs contribution after each frame,
+ * see linPF_tfir.c.
+ */
+struct LINARFILTERPRED_RTPOOL
+{
+    int                       NBworker;
+    LINARFILTERPRED_RTWORKER *worker;
+
+    LINARFILTERPRED_MVM_FUNC mvmfunc;
+    long                     nrow;
+    long                     ncol0; ///< time step 0 columns, 0 if no split
+    long                     ncol;
+    long                     ldm;
+    const float             *M;
+    volatile uint64_t       *Mcnt; ///< update counter of M, NULL if fixed
+    const float             *x;    ///< input of current frame
+    float                   *y;
+
+    _Atomic uint64_t framecnt; ///< incremented to start computation
+    _Atomic uint64_t donecnt;  ///< incremented by each worker when done
+    _Atomic int      stop;
+};
+
+errno_t linARfilterPred_rtpool_create(LINARFILTERPRED_RTPOOL  *pool,
+                                      const int               *cpulist,
+                                      int                      NBcpu,
+                                      LINARFILTERPRED_MVM_FUNC mvmfunc,
+                                      long                     nrow,
+                                      long                     ncol0,
+                                      long                     ncol,
+                                      long                     ldm,
+                                      const float             *M,
+                                      volatile uint64_t       *Mcnt,
+                                      float                   *y);
+
+errno_t linARfilterPred_rtpool_run(LINARFILTERPRED_RTPOOL *pool,
+                                   const float            *x);
+
+errno_t linARfilterPred_rtpool_destroy(LINARFILTERPRED_RTPOOL *pool);
+
+#endif
@@ -0,0 +1,110 @@
+/**
+ * @file    linPF_runs.c
+ * @brief   Masked gather and scatter as contiguous runs
+ *
+ * Real-time apply reads the active inputs of a masked stream, and writes
+ * outputs to the active elements of a masked stream. Masks are usually
+ * dense, or made of a few blocks of consecutive modes. Index lists are
+ * converted once to runs of consecutive indices, so that each frame
+ * copies a few contiguous blocks instead of gathering element by
+ * element through the index list.
+ *
+ * A dense mask is a single run starting at 0 : outputs can then be
+ * computed directly in the output stream, without scatter.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_runs.h"
+
+
+
+
+/**
+ * @brief Convert mask index list to runs
+ */
+errno_t linARfilterPred_runs_init(LINARFILTERPRED_RUNS *runs,
+                                  const long           *index,
+                                  long                  NBindex)
+{
+    runs->NBrun = 0;
+    for(long k = 0; k < NBindex; k++)
+    {
+        if((k == 0) || (index[k] != index[k - 1] + 1))
+        {
+            runs->NBrun++;
+        }
+    }
+
+    runs->start = (long *) malloc(sizeof(long) * 3 * (runs->NBrun + 1));
+    if(runs->start == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    runs->off = runs->start + runs->NBrun + 1;
+    runs->len = runs->off + runs->NBrun + 1;
+
+    long r = -1;
+    for(long k = 0; k < NBindex; k++)
+    {
+        if((k == 0) || (index[k] != index[k - 1] + 1))
+        {
+            r++;
+            runs->start[r] = index[k];
+            runs->off[r]   = k;
+            runs->len[r]   = 0;
+        }
+        runs->len[r]++;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+void linARfilterPred_runs_free(LINARFILTERPRED_RUNS *runs)
+{
+    free(runs->start);
+    runs->start = NULL;
+    runs->off   = NULL;
+    runs->len   = NULL;
+    runs->NBrun = 0;
+}
+
+
+
+
+/**
+ * @brief dst[k] = src[index[k]]
+ */
+void linARfilterPred_runs_gather(const LINARFILTERPRED_RUNS *runs,
+                                 const float                *src,
+                                 float                      *dst)
+{
+    for(long r = 0; r < runs->NBrun; r++)
+    {
+        memcpy(dst + runs->off[r],
+               src + runs->start[r],
+               sizeof(float) * runs->len[r]);
+    }
+}
+
+
+
+
+/**
+ * @brief dst[index[k]] = src[k]
+ */
+void linARfilterPred_runs_scatter(const LINARFILTERPRED_RUNS *runs,
+                                  const float                *src,
+                                  float                      *dst)
+{
+    for(long r = 0; r < runs->NBrun; r++)
+    {
+        memcpy(dst + runs->start[r],
+               src + runs->off[r],
+               sizeof(float) * runs->len[r]);
+    }
+}
@@ -0,0 +1,38 @@
+/**
+ * @file    linPF_runs.h
+ * @brief   Masked gather and scatter as contiguous runs
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_RUNS_H
+#define LINARFILTERPRED_LINPF_RUNS_H
+
+/** @brief Mask index list, as runs of consecutive indices
+ *
+ * Run r covers packed elements off[r] to off[r]+len[r]-1, at mask
+ * indices start[r] to start[r]+len[r]-1.
+ */
+typedef struct
+{
+    long  NBrun;
+    long *start; ///< first mask index of run
+    long *off;   ///< first packed element of run
+    long *len;
+} LINARFILTERPRED_RUNS;
+
+errno_t linARfilterPred_runs_init(LINARFILTERPRED_RUNS *runs,
+                                  const long           *index,
+                                  long                  NBindex);
+
+void linARfilterPred_runs_free(LINARFILTERPRED_RUNS *runs);
+
+void linARfilterPred_runs_gather(const LINARFILTERPRED_RUNS *runs,
+                                 const float                *src,
+                                 float                      *dst);
+
+void linARfilterPred_runs_scatter(const LINARFILTERPRED_RUNS *runs,
+                                  const float                *src,
+                                  float                      *dst);
+
+#endif
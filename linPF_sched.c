@@ -0,0 +1,150 @@
+/**
+ * @file    linPF_sched.c
+ * @brief   Worker threads for filter build stages
+ *
+ * Build stages are split into tiles (groups of data matrix rows or of
+ * output modes), submitted as OpenMP tasks. Tiles of independent stages
+ * are submitted together, and tiles of dependent stages are chained by
+ * task dependencies, so that workers pick up pending tiles instead of
+ * waiting for a whole stage to complete.
+ *
+ * Worker count and core affinity are set once, before the compute loop:
+ * worker thread i is pinned to CPU cpulist[i % NBcpu]. The OpenMP runtime
+ * keeps the same worker threads for later parallel regions of the same
+ * size, so that the pinning applies to all build stages.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <sched.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_sched.h"
+
+
+
+
+/**
+ * @brief Parse CPU list, for example "0-3,8,10-11"
+ *
+ * @return number of CPUs written to cpulist, 0 if str is empty or "none",
+ *         -1 if str cannot be parsed
+ */
+long linARfilterPred_sched_cpuset_parse(const char *str,
+                                        int        *cpulist,
+                                        long        NBcpumax)
+{
+    if((str == NULL) || (str[0] == '\0') || (strcmp(str, "none") == 0))
+    {
+        return 0;
+    }
+
+    long        NBcpu = 0;
+    const char *ptr   = str;
+    while(*ptr != '\0')
+    {
+        char *endptr;
+        long  cpu0 = strtol(ptr, &endptr, 10);
+        if((endptr == ptr) || (cpu0 < 0))
+        {
+            return -1;
+        }
+        long cpu1 = cpu0;
+        ptr       = endptr;
+        if(*ptr == '-')
+        {
+            ptr++;
+            cpu1 = strtol(ptr, &endptr, 10);
+            if((endptr == ptr) || (cpu1 < cpu0))
+            {
+                return -1;
+            }
+            ptr = endptr;
+        }
+        for(long cpu = cpu0; (cpu <= cpu1) && (NBcpu < NBcpumax); cpu++)
+        {
+            cpulist[NBcpu] = (int) cpu;
+            NBcpu++;
+        }
+
+        if(*ptr == ',')
+        {
+            ptr++;
+        }
+        else if(*ptr != '\0')
+        {
+            return -1;
+        }
+    }
+
+    return NBcpu;
+}
+
+
+
+
+/**
+ * @brief Set number of worker threads and pin them to CPUs
+ *
+ * If NBthread is 0, the OpenMP default is used, or one worker per CPU
+ * if cpuset is given.
+ *
+ * @return number of worker threads
+ */
+int linARfilterPred_sched_init(int NBthread, const char *cpuset)
+{
+    DEBUG_TRACE_FSTART();
+
+    int  cpulist[LINPF_SCHED_NBCPUMAX];
+    long NBcpu =
+        linARfilterPred_sched_cpuset_parse(cpuset, cpulist, LINPF_SCHED_NBCPUMAX);
+    if(NBcpu == -1)
+    {
+        PRINT_WARNING("cannot parse cpuset \"%s\" - workers not pinned", cpuset);
+        NBcpu = 0;
+    }
+
+#ifdef _OPENMP
+    if(NBthread <= 0)
+    {
+        NBthread = (NBcpu > 0) ? NBcpu : omp_get_max_threads();
+    }
+    omp_set_num_threads(NBthread);
+
+    if(NBcpu > 0)
+    {
+        #pragma omp parallel
+        {
+            cpu_set_t mask;
+            CPU_ZERO(&mask);
+            CPU_SET(cpulist[omp_get_thread_num() % NBcpu], &mask);
+            if(sched_setaffinity(0, sizeof(cpu_set_t), &mask) != 0)
+            {
+                PRINT_WARNING("cannot pin worker %d to CPU %d",
+                              omp_get_thread_num(),
+                              cpulist[omp_get_thread_num() % NBcpu]);
+            }
+        }
+    }
+#else
+    NBthread = 1;
+    if(NBcpu > 0)
+    {
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        CPU_SET(cpulist[0], &mask);
+        sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+    }
+#endif
+
+    DEBUG_TRACE_FEXIT();
+    return NBthread;
+}
@@ -0,0 +1,20 @@
+/**
+ * @file    linPF_sched.h
+ * @brief   Worker threads for filter build stages
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_SCHED_H
+#define LINARFILTERPRED_LINPF_SCHED_H
+
+// maximum number of CPUs in a CPU list
+#define LINPF_SCHED_NBCPUMAX 1024
+
+long linARfilterPred_sched_cpuset_parse(const char *str,
+                                        int        *cpulist,
+                                        long        NBcpumax);
+
+int linARfilterPred_sched_init(int NBthread, const char *cpuset);
+
+#endif
@@ -0,0 +1,393 @@
+/**
+ * @file    linPF_sparse.c
+ * @brief   Sparse (CSR) predictive filter streams
+ *
+ * A sparse predictive filter <PFname> is stored as three streams,
+ * following the compressed sparse row (CSR) convention:
+ *
+ * - <PFname>_sprow : UINT32, nrow+1 entries, offset of each output row
+ * - <PFname>_spcol : UINT32, nnz entries, column index
+ * - <PFname>_spval : FLOAT,  nnz entries, filter coefficient
+ *
+ * Column indices follow the 2D filter convention: dt * NBmodeIN + mode,
+ * so that a sparse filter row is the subset of non-zero coefficients of
+ * the corresponding 2D filter row. The number of output rows is given by
+ * the size of <PFname>_sprow, and the number of time steps by the largest
+ * column index.
+ *
+ * The three streams are updated in place by mkPF. A CSR read across an
+ * update would combine row offsets of one filter with column indices of
+ * another, applying coefficients to the wrong inputs. Real-time apply
+ * therefore reads a private snapshot of the streams, double-buffered :
+ * a new snapshot is copied to the spare buffer when the cnt0 of any of
+ * the streams changes (values only are updated when the support is
+ * fixed), and only used if no stream was written during the copy (write
+ * flags clear and cnt0 unchanged before and after). Otherwise the
+ * previous snapshot is kept, and the copy is retried later.
+ */
+
+#include <stdatomic.h>
+#include <unistd.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "linPF_sparse.h"
+
+
+
+
+static imageID sparse_stream(const char *PFname,
+                             const char *suffix,
+                             long        nelem,
+                             uint8_t     datatype,
+                             int         exact)
+{
+    imageID ID;
+    char    name[STRINGMAXLEN_IMGNAME];
+    WRITE_IMAGENAME(name, "%s_%s", PFname, suffix);
+
+    // re-use existing stream if large enough (or same size if exact)
+    ID = image_ID(name);
+    if(ID != -1)
+    {
+        uint64_t nelement = data.image[ID].md[0].nelement;
+        if((nelement >= (uint64_t) nelem) &&
+                ((exact == 0) || (nelement == (uint64_t) nelem)) &&
+                (data.image[ID].md[0].datatype == datatype))
+        {
+            return ID;
+        }
+        delete_image_ID(name, DELETE_IMAGE_ERRMODE_WARNING);
+    }
+
+    uint32_t *imsizearray = (uint32_t *) malloc(sizeof(uint32_t) * 2);
+    if(imsizearray == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    imsizearray[0] = nelem;
+    imsizearray[1] = 1;
+    create_image_ID(name, 2, imsizearray, datatype, 1, 1, 0, &ID);
+    free(imsizearray);
+    COREMOD_MEMORY_image_set_semflush(name, -1);
+
+    return ID;
+}
+
+
+
+
+/**
+ * @brief Create (or connect to) the CSR streams of a sparse filter
+ *
+ * Existing streams are re-used if they can hold nnz coefficients. The
+ * row stream is only re-used if it has exactly nrow+1 entries, as its
+ * size sets the number of output rows.
+ */
+errno_t linARfilterPred_sparse_create(const char *PFname,
+                                      long        nrow,
+                                      long        nnz,
+                                      imageID    *IDrow,
+                                      imageID    *IDcol,
+                                      imageID    *IDval)
+{
+    DEBUG_TRACE_FSTART();
+
+    if(nnz < 1)
+    {
+        nnz = 1;
+    }
+
+    *IDrow = sparse_stream(PFname, "sprow", nrow + 1, _DATATYPE_UINT32, 1);
+    *IDcol = sparse_stream(PFname, "spcol", nnz, _DATATYPE_UINT32, 0);
+    *IDval = sparse_stream(PFname, "spval", nnz, _DATATYPE_FLOAT, 0);
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Connect to the CSR streams of sparse filter PFname
+ *
+ * @return number of output rows, -1 if a stream is missing
+ */
+long linARfilterPred_sparse_connect(const char *PFname,
+                                    imageID    *IDrow,
+                                    imageID    *IDcol,
+                                    imageID    *IDval)
+{
+    char name[STRINGMAXLEN_IMGNAME];
+
+    WRITE_IMAGENAME(name, "%s_sprow", PFname);
+    *IDrow = image_ID(name);
+    WRITE_IMAGENAME(name, "%s_spcol", PFname);
+    *IDcol = image_ID(name);
+    WRITE_IMAGENAME(name, "%s_spval", PFname);
+    *IDval = image_ID(name);
+
+    if((*IDrow == -1) || (*IDcol == -1) || (*IDval == -1))
+    {
+        return -1;
+    }
+    return data.image[*IDrow].md[0].nelement - 1;
+}
+
+
+
+
+/**
+ * @brief Number of 2D filter columns spanned by sparse filter
+ *
+ * Largest column index + 1, so that the number of time steps is
+ * ncol / NBmodeIN rounded up.
+ */
+long linARfilterPred_sparse_ncol(long            nrow,
+                                 const uint32_t *sprow,
+                                 const uint32_t *spcol)
+{
+    long ncol = 0;
+    for(uint32_t e = 0; e < sprow[nrow]; e++)
+    {
+        if(spcol[e] + 1 > ncol)
+        {
+            ncol = spcol[e] + 1;
+        }
+    }
+    return ncol;
+}
+
+
+
+
+/**
+ * @brief Kept 2D filter columns for per-mode filter order
+ *
+ * Input pixel pix only uses time steps dt < order(pix), where order is
+ * read from image IDordermap at pixel pixarray_xy[pix], and clamped to
+ * [0, PForder]. Kept columns dt * NBpixin + pix are written to colmap in
+ * increasing order.
+ *
+ * @return number of kept columns
+ */
+long linARfilterPred_sparse_ordermap(imageID     IDordermap,
+                                     long        NBpixin,
+                                     const long *pixarray_xy,
+                                     long        PForder,
+                                     long       *colmap)
+{
+    long ncol = 0;
+    for(long dt = 0; dt < PForder; dt++)
+        for(long pix = 0; pix < NBpixin; pix++)
+        {
+            long order =
+                (long)(data.image[IDordermap].array.F[pixarray_xy[pix]] + 0.5);
+            if(dt < order)
+            {
+                colmap[ncol] = dt * NBpixin + pix;
+                ncol++;
+            }
+        }
+    return ncol;
+}
+
+
+
+
+/**
+ * @brief Pack non-zero coefficients of 2D filter W in CSR format
+ *
+ * W is nrow x ncolfull, only columns colmap[c], c < ncol, are considered
+ * (all columns if colmap is NULL). spcol and spval must hold up to
+ * nrow x ncol entries.
+ *
+ * @return number of non-zero coefficients
+ */
+long linARfilterPred_sparse_pack(long         nrow,
+                                 long         ncolfull,
+                                 const float *W,
+                                 const long  *colmap,
+                                 long         ncol,
+                                 uint32_t    *sprow,
+                                 uint32_t    *spcol,
+                                 float       *spval)
+{
+    long nnz = 0;
+    for(long row = 0; row < nrow; row++)
+    {
+        sprow[row] = nnz;
+        for(long c = 0; c < ncol; c++)
+        {
+            long  col = (colmap == NULL) ? c : colmap[c];
+            float val = W[row * ncolfull + col];
+            if(val != 0.0)
+            {
+                spcol[nnz] = col;
+                spval[nnz] = val;
+                nnz++;
+            }
+        }
+    }
+    sprow[nrow] = nnz;
+
+    return nnz;
+}
+
+
+
+
+/**
+ * @brief Sparse matrix-vector multiplication y = A x
+ *
+ * x is the input history buffer, in 2D filter column order.
+ */
+void linARfilterPred_sparse_mvm(long            nrow,
+                                const uint32_t *sprow,
+                                const uint32_t *spcol,
+                                const float    *spval,
+                                const float    *x,
+                                float          *y)
+{
+    for(long row = 0; row < nrow; row++)
+    {
+        float val = 0.0;
+        for(uint32_t e = sprow[row]; e < sprow[row + 1]; e++)
+        {
+            val += spval[e] * x[spcol[e]];
+        }
+        y[row] = val;
+    }
+}
+
+
+
+
+
+/**
+ * @brief Private snapshot of sparse filter streams IDrow, IDcol, IDval
+ *
+ * Waits for a consistent copy of the streams.
+ */
+errno_t linARfilterPred_sparse_snapinit(LINARFILTERPRED_SPARSESNAP *snap,
+                                        long                        nrow,
+                                        imageID                     IDrow,
+                                        imageID                     IDcol,
+                                        imageID                     IDval)
+{
+    snap->nrow   = nrow;
+    snap->IDrow  = IDrow;
+    snap->IDcol  = IDcol;
+    snap->IDval  = IDval;
+    snap->nnzmax = data.image[IDcol].md[0].nelement;
+    if(data.image[IDval].md[0].nelement < (uint64_t) snap->nnzmax)
+    {
+        snap->nnzmax = data.image[IDval].md[0].nelement;
+    }
+
+    for(int b = 0; b < 2; b++)
+    {
+        snap->buffrow[b] = (uint32_t *) malloc(sizeof(uint32_t) * (nrow + 1));
+        snap->buffcol[b] = (uint32_t *) malloc(sizeof(uint32_t) * snap->nnzmax);
+        snap->buffval[b] = (float *) malloc(sizeof(float) * snap->nnzmax);
+        if((snap->buffrow[b] == NULL) || (snap->buffcol[b] == NULL) ||
+                (snap->buffval[b] == NULL))
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+    }
+    snap->cur      = 1;
+    snap->NBupdate = 0;
+    snap->NBretry  = 0;
+
+    // first copy, into buffer 0
+    snap->cnt0sum = data.image[IDrow].md[0].cnt0 +
+                    data.image[IDcol].md[0].cnt0 +
+                    data.image[IDval].md[0].cnt0 - 1;
+    while(linARfilterPred_sparse_snapupdate(snap) == 0)
+    {
+        usleep(100);
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Copy sparse filter streams if updated
+ *
+ * @return 1 if a new snapshot is in use, 0 otherwise
+ */
+int linARfilterPred_sparse_snapupdate(LINARFILTERPRED_SPARSESNAP *snap)
+{
+    volatile IMAGE_METADATA *mdrow = data.image[snap->IDrow].md;
+    volatile IMAGE_METADATA *mdcol = data.image[snap->IDcol].md;
+    volatile IMAGE_METADATA *mdval = data.image[snap->IDval].md;
+
+    // streams are only ever incremented : sum changes on any update
+    uint64_t cnt0sum = mdrow->cnt0 + mdcol->cnt0 + mdval->cnt0;
+    if(cnt0sum == snap->cnt0sum)
+    {
+        return 0;
+    }
+    if((mdrow->write != 0) || (mdcol->write != 0) || (mdval->write != 0))
+    {
+        snap->NBretry++;
+        return 0;
+    }
+    atomic_thread_fence(memory_order_acquire);
+
+    int b = 1 - snap->cur;
+    memcpy(snap->buffrow[b],
+           data.image[snap->IDrow].array.UI32,
+           sizeof(uint32_t) * (snap->nrow + 1));
+    long nnz = snap->buffrow[b][snap->nrow];
+    if(nnz <= snap->nnzmax)
+    {
+        memcpy(snap->buffcol[b],
+               data.image[snap->IDcol].array.UI32,
+               sizeof(uint32_t) * nnz);
+        memcpy(snap->buffval[b],
+               data.image[snap->IDval].array.F,
+               sizeof(float) * nnz);
+    }
+
+    atomic_thread_fence(memory_order_acquire);
+    if((nnz > snap->nnzmax) ||
+            (mdrow->cnt0 + mdcol->cnt0 + mdval->cnt0 != cnt0sum) ||
+            (mdrow->write != 0) || (mdcol->write != 0) ||
+            (mdval->write != 0))
+    {
+        // streams written during copy : keep previous snapshot
+        snap->NBretry++;
+        return 0;
+    }
+
+    snap->cur     = b;
+    snap->cnt0sum = cnt0sum;
+    snap->sprow   = snap->buffrow[b];
+    snap->spcol   = snap->buffcol[b];
+    snap->spval   = snap->buffval[b];
+    snap->NBupdate++;
+
+    return 1;
+}
+
+
+
+
+void linARfilterPred_sparse_snapfree(LINARFILTERPRED_SPARSESNAP *snap)
+{
+    for(int b = 0; b < 2; b++)
+    {
+        free(snap->buffrow[b]);
+        free(snap->buffcol[b]);
+        free(snap->buffval[b]);
+    }
+}
@@ -0,0 +1,87 @@
+/**
+ * @file    linPF_sparse.h
+ * @brief   Sparse (CSR) predictive filter streams
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_SPARSE_H
+#define LINARFILTERPRED_LINPF_SPARSE_H
+
+#include <stdint.h>
+
+/** @brief Double-buffered private copy of sparse filter streams
+ *
+ * sprow, spcol and spval point to the buffers of the snapshot in use.
+ */
+typedef struct
+{
+    long    nrow;
+    imageID IDrow;
+    imageID IDcol;
+    imageID IDval;
+    long    nnzmax;
+
+    uint32_t *buffrow[2];
+    uint32_t *buffcol[2];
+    float    *buffval[2];
+    int       cur;     ///< buffer in use
+    uint64_t  cnt0sum; ///< sum of stream cnt0 of snapshot in use
+
+    uint32_t *sprow;
+    uint32_t *spcol;
+    float    *spval;
+
+    uint64_t NBupdate;
+    uint64_t NBretry; ///< copies deferred by stream writes
+} LINARFILTERPRED_SPARSESNAP;
+
+errno_t linARfilterPred_sparse_create(const char *PFname,
+                                      long        nrow,
+                                      long        nnz,
+                                      imageID    *IDrow,
+                                      imageID    *IDcol,
+                                      imageID    *IDval);
+
+long linARfilterPred_sparse_connect(const char *PFname,
+                                    imageID    *IDrow,
+                                    imageID    *IDcol,
+                                    imageID    *IDval);
+
+long linARfilterPred_sparse_ncol(long            nrow,
+                                 const uint32_t *sprow,
+                                 const uint32_t *spcol);
+
+long linARfilterPred_sparse_ordermap(imageID     IDordermap,
+                                     long        NBpixin,
+                                     const long *pixarray_xy,
+                                     long        PForder,
+                                     long       *colmap);
+
+long linARfilterPred_sparse_pack(long         nrow,
+                                 long         ncolfull,
+                                 const float *W,
+                                 const long  *colmap,
+                                 long         ncol,
+                                 uint32_t    *sprow,
+                                 uint32_t    *spcol,
+                                 float       *spval);
+
+void linARfilterPred_sparse_mvm(long            nrow,
+                                const uint32_t *sprow,
+                                const uint32_t *spcol,
+                                const float    *spval,
+                                const float    *x,
+                                float          *y);
+
+errno_t linARfilterPred_sparse_snapinit(LINARFILTERPRED_SPARSESNAP *snap,
+                                        long                        nrow,
+                                        imageID                     IDrow,
+                                        imageID                     IDcol,
+                                        imageID                     IDval);
+
+int linARfilterPred_sparse_snapupdate(LINARFILTERPRED_SPARSESNAP *snap);
+
+void linARfilterPred_sparse_snapfree(LINARFILTERPRED_SPARSESNAP *snap);
+
+#endif
@@ -0,0 +1,420 @@
+/**
+ * @file    linPF_subspace.c
+ * @brief   Warm-started subspace iteration solver
+ *
+ * The truncated SVD pseudo-inverse solution only depends on the dominant
+ * right singular vectors of the data matrix X (NBrowX samples x n
+ * regressors). Instead of a full SVD, the dominant subspace of rank
+ * vectors is tracked by subspace (block power) iteration:
+ *
+ *   V <- orth( X^T X V )
+ *
+ * followed by a Rayleigh-Ritz step, which gives singular values and
+ * vectors within the subspace. In loop mode, the subspace from the
+ * previous iteration is an accurate starting point, so a couple of
+ * sweeps are enough. Each sweep costs 2 x NBrowX x n x rank operations,
+ * against NBrowX x n^2 for a full decomposition.
+ *
+ * Data matrices follow the PFmatD / PFfmdat convention: XT is n x NBrowX,
+ * YT is nout x NBrowY, row-major. If NBrowX > NBrowY, the extra rows of X
+ * are regularization rows, with zero target.
+ */
+
+#include <math.h>
+
+#include <gsl/gsl_cblas.h>
+#include <gsl/gsl_eigen.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_subspace.h"
+
+
+
+
+errno_t linARfilterPred_subspace_init(LINARFILTERPRED_SUBSPACE *ss,
+                                      long                      n,
+                                      long                      rank)
+{
+    if(rank > n)
+    {
+        rank = n;
+    }
+    if(rank < 1)
+    {
+        rank = 1;
+    }
+
+    ss->n    = n;
+    ss->rank = rank;
+    ss->init = 0;
+    ss->seed = 1;
+    ss->V    = (double *) calloc(n * rank, sizeof(double));
+    if(ss->V == NULL)
+    {
+        PRINT_ERROR("calloc returns NULL pointer");
+        abort();
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t linARfilterPred_subspace_free(LINARFILTERPRED_SUBSPACE *ss)
+{
+    free(ss->V);
+    ss->V    = NULL;
+    ss->init = 0;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+static void subspace_randomize_column(LINARFILTERPRED_SUBSPACE *ss, long i)
+{
+    for(long l = 0; l < ss->n; l++)
+    {
+        ss->V[l * ss->rank + i] = 1.0 * rand_r(&ss->seed) / RAND_MAX - 0.5;
+    }
+}
+
+
+
+
+/**
+ * @brief Orthonormalize columns of V
+ *
+ * Modified Gram-Schmidt, applied twice for numerical orthogonality.
+ * Columns in the span of the previous ones are replaced by random vectors.
+ */
+static void subspace_orthonormalize(LINARFILTERPRED_SUBSPACE *ss)
+{
+    long    n = ss->n;
+    long    k = ss->rank;
+    double *V = ss->V;
+
+    for(long i = 0; i < k; i++)
+    {
+        for(int iter = 0; iter < 4; iter++)
+        {
+            double norm0 = 0.0;
+            for(long l = 0; l < n; l++)
+            {
+                norm0 += V[l * k + i] * V[l * k + i];
+            }
+
+            for(int pass = 0; pass < 2; pass++)
+                for(long j = 0; j < i; j++)
+                {
+                    double dot = 0.0;
+                    for(long l = 0; l < n; l++)
+                    {
+                        dot += V[l * k + j] * V[l * k + i];
+                    }
+                    for(long l = 0; l < n; l++)
+                    {
+                        V[l * k + i] -= dot * V[l * k + j];
+                    }
+                }
+
+            double norm = 0.0;
+            for(long l = 0; l < n; l++)
+            {
+                norm += V[l * k + i] * V[l * k + i];
+            }
+
+            if((norm > 1.0e-20 * norm0) && (norm > 0.0))
+            {
+                norm = sqrt(norm);
+                for(long l = 0; l < n; l++)
+                {
+                    V[l * k + i] /= norm;
+                }
+                break;
+            }
+            subspace_randomize_column(ss, i);
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Solve predictive filter from warm-started subspace iteration
+ *
+ * NBsweepinit sweeps are used if no previous subspace is available,
+ * NBsweep otherwise. Singular values below SVDeps times the largest one
+ * are discarded, as in the SVD pseudo-inverse.
+ *
+ * W is nout x n, same layout as the 2D predictive filter.
+ *
+ * @return number of modes kept
+ */
+long linARfilterPred_subspace_solve(LINARFILTERPRED_SUBSPACE *ss,
+                                    const float              *XT,
+                                    long                      NBrowX,
+                                    const float              *YT,
+                                    long                      NBrowY,
+                                    long                      nout,
+                                    long                      NBsweep,
+                                    long                      NBsweepinit,
+                                    double                    SVDeps,
+                                    float                    *W)
+{
+    DEBUG_TRACE_FSTART();
+
+    long n = ss->n;
+    long k = ss->rank;
+
+    if(ss->init == 0)
+    {
+        for(long i = 0; i < k; i++)
+        {
+            subspace_randomize_column(ss, i);
+        }
+        subspace_orthonormalize(ss);
+        NBsweep = NBsweepinit;
+    }
+
+    float  *Vf = (float *) malloc(sizeof(float) * n * k);
+    float  *Zf = (float *) malloc(sizeof(float) * NBrowX * k);
+    double *Zd = (double *) malloc(sizeof(double) * NBrowX * k);
+    double *H  = (double *) malloc(sizeof(double) * k * k);
+    float  *Pf = (float *) malloc(sizeof(float) * nout * k);
+    double *P  = (double *) malloc(sizeof(double) * nout * k);
+    double *VU = (double *) malloc(sizeof(double) * n * k);
+    double *Wd = (double *) malloc(sizeof(double) * nout * n);
+    if((Vf == NULL) || (Zf == NULL) || (Zd == NULL) || (H == NULL) ||
+            (Pf == NULL) || (P == NULL) || (VU == NULL) || (Wd == NULL))
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+
+    // Subspace iteration: V <- orth(X^T X V)
+    //
+    for(long sweep = 0; sweep < NBsweep; sweep++)
+    {
+        for(long ii = 0; ii < n * k; ii++)
+        {
+            Vf[ii] = ss->V[ii];
+        }
+
+        // Z = X V
+        cblas_sgemm(CblasRowMajor,
+                    CblasTrans,
+                    CblasNoTrans,
+                    NBrowX,
+                    k,
+                    n,
+                    1.0,
+                    XT,
+                    NBrowX,
+                    Vf,
+                    k,
+                    0.0,
+                    Zf,
+                    k);
+
+        // V = X^T Z
+        cblas_sgemm(CblasRowMajor,
+                    CblasNoTrans,
+                    CblasNoTrans,
+                    n,
+                    k,
+                    NBrowX,
+                    1.0,
+                    XT,
+                    NBrowX,
+                    Zf,
+                    k,
+                    0.0,
+                    Vf,
+                    k);
+
+        for(long ii = 0; ii < n * k; ii++)
+        {
+            ss->V[ii] = Vf[ii];
+        }
+        subspace_orthonormalize(ss);
+    }
+
+
+    // Rayleigh-Ritz: H = (X V)^T (X V) = U diag(lambda) U^T
+    //
+    for(long ii = 0; ii < n * k; ii++)
+    {
+        Vf[ii] = ss->V[ii];
+    }
+    cblas_sgemm(CblasRowMajor,
+                CblasTrans,
+                CblasNoTrans,
+                NBrowX,
+                k,
+                n,
+                1.0,
+                XT,
+                NBrowX,
+                Vf,
+                k,
+                0.0,
+                Zf,
+                k);
+    for(long ii = 0; ii < NBrowX * k; ii++)
+    {
+        Zd[ii] = Zf[ii];
+    }
+    cblas_dsyrk(CblasRowMajor,
+                CblasUpper,
+                CblasTrans,
+                k,
+                NBrowX,
+                1.0,
+                Zd,
+                k,
+                0.0,
+                H,
+                k);
+    for(long i = 0; i < k; i++)
+        for(long j = 0; j < i; j++)
+        {
+            H[i * k + j] = H[j * k + i];
+        }
+
+    // P = Y^T X V, computed before the rotation
+    cblas_sgemm(CblasRowMajor,
+                CblasNoTrans,
+                CblasNoTrans,
+                nout,
+                k,
+                NBrowY,
+                1.0,
+                YT,
+                NBrowY,
+                Zf,
+                k,
+                0.0,
+                Pf,
+                k);
+
+    gsl_matrix *Hm   = gsl_matrix_alloc(k, k);
+    gsl_vector *eval = gsl_vector_alloc(k);
+    gsl_matrix *evec = gsl_matrix_alloc(k, k);
+    gsl_eigen_symmv_workspace *ws = gsl_eigen_symmv_alloc(k);
+
+    memcpy(Hm->data, H, sizeof(double) * k * k);
+    gsl_eigen_symmv(Hm, eval, evec, ws);
+    gsl_eigen_symmv_sort(eval, evec, GSL_EIGEN_SORT_VAL_DESC);
+
+    // U as contiguous k x k array
+    for(long i = 0; i < k; i++)
+        for(long j = 0; j < k; j++)
+        {
+            H[i * k + j] = evec->data[i * evec->tda + j];
+        }
+
+    // Ritz vectors V U, kept for next iteration
+    cblas_dgemm(CblasRowMajor,
+                CblasNoTrans,
+                CblasNoTrans,
+                n,
+                k,
+                k,
+                1.0,
+                ss->V,
+                k,
+                H,
+                k,
+                0.0,
+                VU,
+                k);
+    memcpy(ss->V, VU, sizeof(double) * n * k);
+    ss->init = 1;
+
+    // P U, scaled by inverse eigen values
+    for(long ii = 0; ii < nout * k; ii++)
+    {
+        Wd[ii] = Pf[ii];
+    }
+    cblas_dgemm(CblasRowMajor,
+                CblasNoTrans,
+                CblasNoTrans,
+                nout,
+                k,
+                k,
+                1.0,
+                Wd,
+                k,
+                H,
+                k,
+                0.0,
+                P,
+                k);
+
+    double evalmax    = gsl_vector_get(eval, 0);
+    double evallim    = SVDeps * SVDeps * evalmax;
+    long   NBmodekept = 0;
+    while((NBmodekept < k) &&
+            (gsl_vector_get(eval, NBmodekept) > evallim) &&
+            (gsl_vector_get(eval, NBmodekept) > 0.0))
+    {
+        NBmodekept++;
+    }
+    for(long j = 0; j < nout; j++)
+        for(long i = 0; i < k; i++)
+        {
+            if(i < NBmodekept)
+            {
+                P[j * k + i] /= gsl_vector_get(eval, i);
+            }
+            else
+            {
+                P[j * k + i] = 0.0;
+            }
+        }
+
+    // W = P (V U)^T
+    cblas_dgemm(CblasRowMajor,
+                CblasNoTrans,
+                CblasTrans,
+                nout,
+                n,
+                k,
+                1.0,
+                P,
+                k,
+                ss->V,
+                k,
+                0.0,
+                Wd,
+                n);
+    for(long ii = 0; ii < nout * n; ii++)
+    {
+        W[ii] = Wd[ii];
+    }
+
+    gsl_eigen_symmv_free(ws);
+    gsl_matrix_free(evec);
+    gsl_vector_free(eval);
+    gsl_matrix_free(Hm);
+
+    free(Vf);
+    free(Zf);
+    free(Zd);
+    free(H);
+    free(Pf);
+    free(P);
+    free(VU);
+    free(Wd);
+
+    DEBUG_TRACE_FEXIT();
+    return NBmodekept;
+}
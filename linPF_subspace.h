@@ -0,0 +1,41 @@
+/**
+ * @file    linPF_subspace.h
+ * @brief   Warm-started subspace iteration solver
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_SUBSPACE_H
+#define LINARFILTERPRED_LINPF_SUBSPACE_H
+
+/** @brief Dominant right singular subspace of the data matrix
+ *
+ * Kept between loop iterations to warm-start the next decomposition.
+ */
+typedef struct
+{
+    long     n;       ///< number of regressors
+    long     rank;    ///< subspace dimension
+    int      init;    ///< 1 if V holds a previous subspace
+    unsigned seed;    ///< random seed for initial subspace
+    double  *V;       ///< n x rank, row-major, orthonormal columns
+} LINARFILTERPRED_SUBSPACE;
+
+errno_t linARfilterPred_subspace_init(LINARFILTERPRED_SUBSPACE *ss,
+                                      long                      n,
+                                      long                      rank);
+
+errno_t linARfilterPred_subspace_free(LINARFILTERPRED_SUBSPACE *ss);
+
+long linARfilterPred_subspace_solve(LINARFILTERPRED_SUBSPACE *ss,
+                                    const float              *XT,
+                                    long                      NBrowX,
+                                    const float              *YT,
+                                    long                      NBrowY,
+                                    long                      nout,
+                                    long                      NBsweep,
+                                    long                      NBsweepinit,
+                                    double                    SVDeps,
+                                    float                    *W);
+
+#endif
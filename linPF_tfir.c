@@ -0,0 +1,126 @@
+/**
+ * @file    linPF_tfir.c
+ * @brief   Split filter apply: older time steps computed ahead of input
+ *
+ * The filter output for frame k is
+ *
+ *   y(k) = M_0 x(k) + sum_{dt>0} M_dt x(k-dt)
+ *
+ * Only the first term depends on the new input. The second term is the
+ * transposed-form FIR accumulator for frame k: it is computed once frame
+ * k-1 is published, in the idle time between frames, so that only the
+ * time step 0 block (1/NBPFstep of the filter) is on the critical path
+ * between input arrival and output.
+ *
+ * Inputs are ordered most recent first: the input vector of frame k-1,
+ * without its last (oldest) time step, is the older time steps input of
+ * frame k. Both are computed from the same input vector x, which must be
+ * unchanged between tfir_output() and tfir_prepare(), except for its last
+ * time step.
+ *
+ * The accumulator is a single output vector: it is recomputed from the
+ * input history each frame instead of accumulated per time step, so that
+ * a filter update applies to all time steps at the same frame. If the
+ * filter changes between tfir_prepare() and tfir_output(), the full
+ * filter is applied.
+ */
+
+#include <stdlib.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_tfir.h"
+
+
+
+
+errno_t linARfilterPred_tfir_init(LINARFILTERPRED_TFIR    *tfir,
+                                  LINARFILTERPRED_MVM_FUNC mvmfunc,
+                                  long                     nrow,
+                                  long                     ncol0,
+                                  long                     ncol,
+                                  long                     ldm,
+                                  const float             *M,
+                                  volatile uint64_t       *Mcnt)
+{
+    tfir->mvmfunc  = mvmfunc;
+    tfir->nrow     = nrow;
+    tfir->ncol0    = ncol0;
+    tfir->ncol     = ncol;
+    tfir->ldm      = ldm;
+    tfir->M        = M;
+    tfir->Mcnt     = Mcnt;
+    tfir->Mcnt0    = 0;
+    tfir->prevalid = 0;
+
+    tfir->pre = (float *) malloc(sizeof(float) * (nrow > 0 ? nrow : 1));
+    if(tfir->pre == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Compute output y = M x, using precomputed older time steps
+ */
+void linARfilterPred_tfir_output(LINARFILTERPRED_TFIR *tfir,
+                                 const float          *x,
+                                 float                *y)
+{
+    if((tfir->prevalid == 1) &&
+            ((tfir->Mcnt == NULL) || (*tfir->Mcnt == tfir->Mcnt0)))
+    {
+        tfir->mvmfunc(tfir->nrow, tfir->ncol0, tfir->ldm, tfir->M, x, y);
+        for(long r = 0; r < tfir->nrow; r++)
+        {
+            y[r] += tfir->pre[r];
+        }
+    }
+    else
+    {
+        tfir->mvmfunc(tfir->nrow, tfir->ncol, tfir->ldm, tfir->M, x, y);
+    }
+    tfir->prevalid = 0;
+}
+
+
+
+
+/**
+ * @brief Compute older time steps contribution to next frame output
+ *
+ * x is the input vector of the output just computed.
+ */
+void linARfilterPred_tfir_prepare(LINARFILTERPRED_TFIR *tfir,
+                                  const float          *x)
+{
+    if(tfir->Mcnt != NULL)
+    {
+        tfir->Mcnt0 = *tfir->Mcnt;
+    }
+    tfir->mvmfunc(tfir->nrow,
+                  tfir->ncol - tfir->ncol0,
+                  tfir->ldm,
+                  &tfir->M[tfir->ncol0],
+                  x,
+                  tfir->pre);
+    tfir->prevalid = 1;
+}
+
+
+
+
+errno_t linARfilterPred_tfir_free(LINARFILTERPRED_TFIR *tfir)
+{
+    free(tfir->pre);
+    tfir->pre      = NULL;
+    tfir->prevalid = 0;
+
+    return RETURN_SUCCESS;
+}
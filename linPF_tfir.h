@@ -0,0 +1,50 @@
+/**
+ * @file    linPF_tfir.h
+ * @brief   Split filter apply: older time steps computed ahead of input
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_TFIR_H
+#define LINARFILTERPRED_LINPF_TFIR_H
+
+#include "linPF_mvm.h"
+
+/** @brief Filter apply with precomputed older time step contribution
+ *
+ * M is nrow x ncol with leading dimension ldm. The first ncol0 columns
+ * multiply the most recent input (time step 0).
+ */
+typedef struct
+{
+    LINARFILTERPRED_MVM_FUNC mvmfunc;
+    long                     nrow;
+    long                     ncol0; ///< columns of time step 0
+    long                     ncol;
+    long                     ldm;
+    const float             *M;
+    volatile uint64_t       *Mcnt;  ///< update counter of M, NULL if fixed
+    uint64_t                 Mcnt0; ///< M counter when pre was computed
+    float                   *pre;   ///< older time steps contribution
+    int                      prevalid;
+} LINARFILTERPRED_TFIR;
+
+errno_t linARfilterPred_tfir_init(LINARFILTERPRED_TFIR    *tfir,
+                                  LINARFILTERPRED_MVM_FUNC mvmfunc,
+                                  long                     nrow,
+                                  long                     ncol0,
+                                  long                     ncol,
+                                  long                     ldm,
+                                  const float             *M,
+                                  volatile uint64_t       *Mcnt);
+
+void linARfilterPred_tfir_output(LINARFILTERPRED_TFIR *tfir,
+                                 const float          *x,
+                                 float                *y);
+
+void linARfilterPred_tfir_prepare(LINARFILTERPRED_TFIR *tfir,
+                                  const float          *x);
+
+errno_t linARfilterPred_tfir_free(LINARFILTERPRED_TFIR *tfir);
+
+#endif
@@ -0,0 +1,218 @@
+/**
+ * @file    linPF_timing.c
+ * @brief   Per-stage timing of filter builds
+ *
+ * Each loop iteration of the filter build is split into stages (see
+ * linPF_timing.h). Time is accumulated into the current stage until the
+ * next stage starts, so a stage entered several times in an iteration
+ * (for example publishing raw and mixed filters) is summed.
+ *
+ * Stages fused in the code are timed together: running averages are
+ * part of the copy, and target (future measured) values are filled with
+ * the data matrix or accumulated with the statistics.
+ *
+ * Bytes moved are estimated by the caller from array sizes. Resident
+ * memory is read from /proc/self/statm at the end of each stage.
+ *
+ * Results are written to a shared memory stream of size NBSTAGE x 3:
+ * - row 0 : time [s]
+ * - row 1 : data moved [MB]
+ * - row 2 : resident memory at end of stage [MB]
+ */
+
+#include <stdio.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "CommandLineInterface/CLIcore.h"
+#include "CommandLineInterface/timeutils.h"
+
+#include "COREMOD_memory/COREMOD_memory.h"
+
+#include "linPF_timing.h"
+
+
+
+
+static const char *stagename[LINPF_NBSTAGE] =
+{
+    "wait",
+    "copy",
+    "DC",
+    "fill",
+    "factor",
+    "assemble",
+    "score",
+    "blend",
+    "publish",
+    "io",
+    "monitor"
+};
+
+
+
+
+const char *linARfilterPred_timing_stagename(int stage)
+{
+    if((stage < 0) || (stage >= LINPF_NBSTAGE))
+    {
+        return "unknown";
+    }
+    return stagename[stage];
+}
+
+
+
+
+/**
+ * @brief Resident memory of process [MB]
+ */
+static double timing_rssMB()
+{
+    double rssMB = 0.0;
+    FILE  *fp    = fopen("/proc/self/statm", "r");
+    if(fp != NULL)
+    {
+        long size;
+        long resident;
+        if(fscanf(fp, "%ld %ld", &size, &resident) == 2)
+        {
+            rssMB = 1.0 * resident * sysconf(_SC_PAGESIZE) / 1024.0 / 1024.0;
+        }
+        fclose(fp);
+    }
+    return rssMB;
+}
+
+
+
+
+/**
+ * @brief Peak resident memory of process since start [MB]
+ */
+double linARfilterPred_timing_peakMB()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0; // ru_maxrss in kB
+}
+
+
+
+
+errno_t linARfilterPred_timing_reset(LINARFILTERPRED_TIMING *timing)
+{
+    timing->stage = -1;
+    for(int stage = 0; stage < LINPF_NBSTAGE; stage++)
+    {
+        timing->tsec[stage]  = 0.0;
+        timing->bytes[stage] = 0.0;
+        timing->rssMB[stage] = 0.0;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief End current stage, if any, and start stage
+ */
+errno_t linARfilterPred_timing_start(LINARFILTERPRED_TIMING *timing,
+                                     int                     stage)
+{
+    struct timespec tnow;
+    clock_gettime(CLOCK_REALTIME, &tnow);
+
+    if(timing->stage != -1)
+    {
+        struct timespec tdiff = timespec_diff(timing->tstart, tnow);
+        timing->tsec[timing->stage] +=
+            1.0 * tdiff.tv_sec + 1.0e-9 * tdiff.tv_nsec;
+        timing->rssMB[timing->stage] = timing_rssMB();
+    }
+
+    timing->stage  = stage;
+    timing->tstart = tnow;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief End current stage
+ */
+errno_t linARfilterPred_timing_stop(LINARFILTERPRED_TIMING *timing)
+{
+    linARfilterPred_timing_start(timing, -1);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+errno_t linARfilterPred_timing_bytes(LINARFILTERPRED_TIMING *timing,
+                                     int                     stage,
+                                     double                  nbytes)
+{
+    timing->bytes[stage] += nbytes;
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Write timing to stream name, created if *IDtiming is -1
+ */
+errno_t linARfilterPred_timing_stream(LINARFILTERPRED_TIMING *timing,
+                                      const char             *name,
+                                      imageID                *IDtiming)
+{
+    DEBUG_TRACE_FSTART();
+
+    if(*IDtiming == -1)
+    {
+        *IDtiming = image_ID(name);
+    }
+    if(*IDtiming == -1)
+    {
+        uint32_t *imsizearray = (uint32_t *) malloc(sizeof(uint32_t) * 2);
+        if(imsizearray == NULL)
+        {
+            PRINT_ERROR("malloc returns NULL pointer");
+            abort();
+        }
+        imsizearray[0] = LINPF_NBSTAGE;
+        imsizearray[1] = 3;
+        create_image_ID(name,
+                        2,
+                        imsizearray,
+                        _DATATYPE_FLOAT,
+                        1,
+                        1,
+                        0,
+                        IDtiming);
+        free(imsizearray);
+    }
+
+    float *array = data.image[*IDtiming].array.F;
+    data.image[*IDtiming].md[0].write = 1;
+    for(int stage = 0; stage < LINPF_NBSTAGE; stage++)
+    {
+        array[stage]                     = timing->tsec[stage];
+        array[LINPF_NBSTAGE + stage]     = timing->bytes[stage] / 1024.0 / 1024.0;
+        array[2 * LINPF_NBSTAGE + stage] = timing->rssMB[stage];
+    }
+    COREMOD_MEMORY_image_set_sempost_byID(*IDtiming, -1);
+    data.image[*IDtiming].md[0].cnt0++;
+    data.image[*IDtiming].md[0].write = 0;
+
+    DEBUG_TRACE_FEXIT();
+    return RETURN_SUCCESS;
+}
@@ -0,0 +1,57 @@
+/**
+ * @file    linPF_timing.h
+ * @brief   Per-stage timing of filter builds
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_TIMING_H
+#define LINARFILTERPRED_LINPF_TIMING_H
+
+#include <time.h>
+
+// build stages
+#define LINPF_STAGE_WAIT     0 // waiting for loop trigger
+#define LINPF_STAGE_COPY     1 // telemetry copy, running averages
+#define LINPF_STAGE_DC       2 // offset removal from statistics
+#define LINPF_STAGE_FILL     3 // data and target matrices, statistics
+#define LINPF_STAGE_FACTOR   4 // factorization, solve
+#define LINPF_STAGE_ASSEMBLE 5 // filter assembly, expansion
+#define LINPF_STAGE_SCORE    6 // held-out statistics and scores
+#define LINPF_STAGE_BLEND    7 // mixing with current filter
+#define LINPF_STAGE_PUBLISH  8 // output streams
+#define LINPF_STAGE_IO       9 // disk I/O
+#define LINPF_STAGE_MONITOR 10 // expected residual
+#define LINPF_NBSTAGE       11
+
+/** @brief Time, bytes moved and resident memory of each build stage
+ */
+typedef struct
+{
+    struct timespec tstart;                ///< start of current stage
+    int             stage;                 ///< current stage, -1 if none
+    double          tsec[LINPF_NBSTAGE];   ///< time [s]
+    double          bytes[LINPF_NBSTAGE];  ///< bytes read and written
+    double          rssMB[LINPF_NBSTAGE];  ///< resident memory at stage end [MB]
+} LINARFILTERPRED_TIMING;
+
+const char *linARfilterPred_timing_stagename(int stage);
+
+errno_t linARfilterPred_timing_reset(LINARFILTERPRED_TIMING *timing);
+
+errno_t linARfilterPred_timing_start(LINARFILTERPRED_TIMING *timing,
+                                     int                     stage);
+
+errno_t linARfilterPred_timing_stop(LINARFILTERPRED_TIMING *timing);
+
+errno_t linARfilterPred_timing_bytes(LINARFILTERPRED_TIMING *timing,
+                                     int                     stage,
+                                     double                  nbytes);
+
+double linARfilterPred_timing_peakMB();
+
+errno_t linARfilterPred_timing_stream(LINARFILTERPRED_TIMING *timing,
+                                      const char             *name,
+                                      imageID                *IDtiming);
+
+#endif
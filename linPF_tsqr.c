@@ -0,0 +1,309 @@
+/**
+ * @file    linPF_tsqr.c
+ * @brief   Tall-skinny QR (TSQR) least-squares solver
+ *
+ * The least-squares problem min | X w - y | is solved from the QR
+ * decomposition of the augmented matrix [X Y] (NBmvec x p, p = n + nout):
+ *
+ *   [X Y] = Q [ R11 R12 ]
+ *             [  0  R22 ]
+ *
+ * so that the solution is W^T = R11^+ R12. The pseudo-inverse of R11 is
+ * computed from its SVD, truncated at SVDeps. R11 has the same singular
+ * values as X, so the result matches the SVD pseudo-inverse of PFmatD,
+ * without squaring the condition number as the normal equations do.
+ *
+ * Only R is needed, which allows a communication-avoiding reduction:
+ * each thread factors its row blocks in turn, stacking the current R
+ * on top of the next block, then thread R factors are combined pairwise
+ * in a binary tree. Rows are built directly from telemetry, so the data
+ * matrix is never stored.
+ */
+
+#include <math.h>
+
+#include <gsl/gsl_linalg.h>
+#include <gsl/gsl_matrix.h>
+#include <gsl/gsl_vector.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_tsqr.h"
+
+
+
+
+/**
+ * @brief QR decomposition of the nrow x p matrix A, R written to p x p array
+ *
+ * Rows of R beyond nrow are zero.
+ */
+static void tsqr_factor(gsl_matrix *A, long nrow, long p, double *R)
+{
+    memset(R, 0, sizeof(double) * p * p);
+    if(nrow == 0)
+    {
+        return;
+    }
+
+    gsl_matrix_view Av  = gsl_matrix_submatrix(A, 0, 0, nrow, p);
+    long            nr  = (nrow < p) ? nrow : p;
+    gsl_vector     *tau = gsl_vector_alloc(nr);
+
+    gsl_linalg_QR_decomp(&Av.matrix, tau);
+
+    for(long i = 0; i < nr; i++)
+        for(long j = i; j < p; j++)
+        {
+            R[i * p + j] = gsl_matrix_get(&Av.matrix, i, j);
+        }
+
+    gsl_vector_free(tau);
+}
+
+
+
+
+/**
+ * @brief Solve predictive filter with TSQR
+ *
+ * Sample m uses frames m .. m+PForder-1 as input and predicts frame
+ * m+PForder-1+PFlag, as in mkPF. Offsets ave_inarray and ave_outarray are
+ * subtracted, samples with samplevalid[m] = 0 are skipped (all valid if
+ * NULL). If reglambda > 0, rows reglambda x I are appended to X, with
+ * zero target, as for the PFmatD regularization.
+ *
+ * If colmap is not NULL, only the ncol regressors of 2D filter columns
+ * colmap[c] are used (see .ordermap in mkPF), and W is NBpixout x ncol.
+ * Otherwise W is NBpixout x n, n = NBpixin x PForder, same layout as the
+ * 2D filter.
+ *
+ * @return number of singular values kept
+ */
+long linARfilterPred_tsqr_solve(const float   *incp,
+                                uint64_t       xysize,
+                                long           NBpixin,
+                                const long    *pixarray_xy,
+                                const double  *ave_inarray,
+                                long           NBpixout,
+                                const long    *outpixarray_xy,
+                                const double  *ave_outarray,
+                                long           PForder,
+                                float          PFlag,
+                                long           NBmvec,
+                                const uint8_t *samplevalid,
+                                const long    *colmap,
+                                long           ncol,
+                                double         reglambda,
+                                long           blocksize,
+                                double         SVDeps,
+                                float         *W)
+{
+    DEBUG_TRACE_FSTART();
+
+    long n = (colmap == NULL) ? NBpixin * PForder : ncol;
+    long p = n + NBpixout;
+
+    long  PFlagl = (long) PFlag;
+    float alpha  = PFlag - PFlagl;
+
+    if(blocksize < 1)
+    {
+        blocksize = p;
+    }
+    long NBblock = (NBmvec + blocksize - 1) / blocksize;
+
+    int NBthread = 1;
+#ifdef _OPENMP
+    NBthread = omp_get_max_threads();
+#endif
+
+    // one R factor per thread
+    double *Rthread = (double *) calloc((long) NBthread * p * p, sizeof(double));
+    if(Rthread == NULL)
+    {
+        PRINT_ERROR("calloc returns NULL pointer");
+        abort();
+    }
+
+
+    // Local reduction: R <- qr([R ; block])
+    //
+    #pragma omp parallel num_threads(NBthread)
+    {
+        int tid = 0;
+#ifdef _OPENMP
+        tid = omp_get_thread_num();
+#endif
+        double     *R     = &Rthread[(long) tid * p * p];
+        long        nrowR = 0; // number of non-zero rows in R
+        gsl_matrix *A     = gsl_matrix_alloc(p + blocksize, p);
+
+        #pragma omp for schedule(static)
+        for(long block = 0; block < NBblock; block++)
+        {
+            long mstart = block * blocksize;
+            long mend   = mstart + blocksize;
+            if(mend > NBmvec)
+            {
+                mend = NBmvec;
+            }
+
+            // previous R on top
+            long nrow = 0;
+            for(long i = 0; i < nrowR; i++)
+            {
+                for(long j = 0; j < p; j++)
+                {
+                    gsl_matrix_set(A, nrow, j, R[i * p + j]);
+                }
+                nrow++;
+            }
+
+            // sample rows [x y]
+            for(long m = mstart; m < mend; m++)
+            {
+                if((samplevalid != NULL) && (samplevalid[m] == 0))
+                {
+                    continue;
+                }
+
+                double *row = gsl_matrix_ptr(A, nrow, 0);
+                long    k0  = m + PForder - 1; // dt=0 index
+                for(long c = 0; c < n; c++)
+                {
+                    long col = (colmap == NULL) ? c : colmap[c];
+                    long dt  = col / NBpixin;
+                    long pix = col - dt * NBpixin;
+                    row[c]   = incp[(k0 - dt) * xysize + pixarray_xy[pix]] -
+                               ave_inarray[pix];
+                }
+                k0 += PFlagl;
+                for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+                {
+                    row[n + PFpix] =
+                        (1.0 - alpha) * incp[k0 * xysize + outpixarray_xy[PFpix]] +
+                        alpha * incp[(k0 + 1) * xysize + outpixarray_xy[PFpix]] -
+                        ave_outarray[PFpix];
+                }
+                nrow++;
+            }
+
+            if(nrow > nrowR)
+            {
+                tsqr_factor(A, nrow, p, R);
+                nrowR = (nrow < p) ? nrow : p;
+            }
+        }
+
+        gsl_matrix_free(A);
+    }
+
+
+    // Tree reduction across threads: R[i] <- qr([R[i] ; R[i+step]])
+    //
+    for(long step = 1; step < NBthread; step *= 2)
+    {
+        #pragma omp parallel for schedule(static, 1)
+        for(long i = 0; i < NBthread - step; i += 2 * step)
+        {
+            gsl_matrix *A = gsl_matrix_alloc(2 * p, p);
+            for(long r = 0; r < p; r++)
+                for(long j = 0; j < p; j++)
+                {
+                    gsl_matrix_set(A, r, j, Rthread[(i * p + r) * p + j]);
+                    gsl_matrix_set(A,
+                                   p + r,
+                                   j,
+                                   Rthread[((i + step) * p + r) * p + j]);
+                }
+            tsqr_factor(A, 2 * p, p, &Rthread[i * p * p]);
+            gsl_matrix_free(A);
+        }
+    }
+    double *R = Rthread;
+
+
+    // Regularization rows
+    //
+    if(reglambda > 0.0)
+    {
+        gsl_matrix *A = gsl_matrix_calloc(p + n, p);
+        for(long r = 0; r < p; r++)
+            for(long j = 0; j < p; j++)
+            {
+                gsl_matrix_set(A, r, j, R[r * p + j]);
+            }
+        for(long i = 0; i < n; i++)
+        {
+            gsl_matrix_set(A, p + i, i, reglambda);
+        }
+        tsqr_factor(A, p + n, p, R);
+        gsl_matrix_free(A);
+    }
+
+
+    // Truncated SVD of R11 = U S V^T, W^T = V S^+ U^T R12
+    //
+    gsl_matrix *U    = gsl_matrix_alloc(n, n);
+    gsl_matrix *V    = gsl_matrix_alloc(n, n);
+    gsl_vector *S    = gsl_vector_alloc(n);
+    gsl_vector *work = gsl_vector_alloc(n);
+    for(long i = 0; i < n; i++)
+        for(long j = 0; j < n; j++)
+        {
+            gsl_matrix_set(U, i, j, R[i * p + j]);
+        }
+    gsl_linalg_SV_decomp(U, V, S, work);
+
+    double Smax       = gsl_vector_get(S, 0);
+    long   NBmodekept = 0;
+    while((NBmodekept < n) &&
+            (gsl_vector_get(S, NBmodekept) > SVDeps * Smax) &&
+            (gsl_vector_get(S, NBmodekept) > 0.0))
+    {
+        NBmodekept++;
+    }
+
+    double *proj = (double *) malloc(sizeof(double) * n);
+    if(proj == NULL)
+    {
+        PRINT_ERROR("malloc returns NULL pointer");
+        abort();
+    }
+    for(long PFpix = 0; PFpix < NBpixout; PFpix++)
+    {
+        for(long k = 0; k < NBmodekept; k++)
+        {
+            double val = 0.0;
+            for(long i = 0; i < n; i++)
+            {
+                val += gsl_matrix_get(U, i, k) * R[i * p + n + PFpix];
+            }
+            proj[k] = val / gsl_vector_get(S, k);
+        }
+        for(long l = 0; l < n; l++)
+        {
+            double val = 0.0;
+            for(long k = 0; k < NBmodekept; k++)
+            {
+                val += gsl_matrix_get(V, l, k) * proj[k];
+            }
+            W[PFpix * n + l] = val;
+        }
+    }
+
+    free(proj);
+    gsl_vector_free(work);
+    gsl_vector_free(S);
+    gsl_matrix_free(V);
+    gsl_matrix_free(U);
+    free(Rthread);
+
+    DEBUG_TRACE_FEXIT();
+    return NBmodekept;
+}
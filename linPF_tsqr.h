@@ -0,0 +1,30 @@
+/**
+ * @file    linPF_tsqr.h
+ * @brief   Tall-skinny QR (TSQR) least-squares solver
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_TSQR_H
+#define LINARFILTERPRED_LINPF_TSQR_H
+
+long linARfilterPred_tsqr_solve(const float   *incp,
+                                uint64_t       xysize,
+                                long           NBpixin,
+                                const long    *pixarray_xy,
+                                const double  *ave_inarray,
+                                long           NBpixout,
+                                const long    *outpixarray_xy,
+                                const double  *ave_outarray,
+                                long           PForder,
+                                float          PFlag,
+                                long           NBmvec,
+                                const uint8_t *samplevalid,
+                                const long    *colmap,
+                                long           ncol,
+                                double         reglambda,
+                                long           blocksize,
+                                double         SVDeps,
+                                float         *W);
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file    linPF_valid.c
+ * @brief   Valid telemetry frames and training samples
+ *
+ * Telemetry may contain several clean segments, separated by invalid
+ * frames (loop opened, saturation, dropped frames). A frame is valid if it
+ * is within one of the listed segments, and flagged valid in the validity
+ * mask. A training sample is valid only if all the frames it spans,
+ * history and future, are valid, so that no sample straddles two segments.
+ *
+ * Invalid samples are skipped by the solvers, and statistics from all
+ * segments are pooled into a single solve.
+ */
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_valid.h"
+
+
+
+
+/**
+ * @brief Flag valid frames
+ *
+ * segments is a comma-separated list of frame ranges start:end
+ * (end excluded), or "none" for all frames.
+ * IDvalidmask is an image of NBframe values, frame k is valid if value
+ * k is > 0.5, or -1 for all frames.
+ *
+ * @return number of valid frames
+ */
+long linARfilterPred_valid_frames(long        NBframe,
+                                  const char *segments,
+                                  imageID     IDvalidmask,
+                                  uint8_t    *framevalid)
+{
+    if((segments == NULL) || (strcmp(segments, "none") == 0) ||
+            (segments[0] == '\0'))
+    {
+        memset(framevalid, 1, NBframe);
+    }
+    else
+    {
+        memset(framevalid, 0, NBframe);
+
+        const char *ptr = segments;
+        while(*ptr != '\0')
+        {
+            char *endptr;
+            long  kstart = strtol(ptr, &endptr, 10);
+            if((endptr == ptr) || (*endptr != ':'))
+            {
+                PRINT_ERROR("invalid segment list \"%s\"", segments);
+                break;
+            }
+            ptr       = endptr + 1;
+            long kend = strtol(ptr, &endptr, 10);
+            if(endptr == ptr)
+            {
+                PRINT_ERROR("invalid segment list \"%s\"", segments);
+                break;
+            }
+            ptr = endptr;
+
+            if(kstart < 0)
+            {
+                kstart = 0;
+            }
+            if(kend > NBframe)
+            {
+                kend = NBframe;
+            }
+            for(long k = kstart; k < kend; k++)
+            {
+                framevalid[k] = 1;
+            }
+
+            if(*ptr == ',')
+            {
+                ptr++;
+            }
+        }
+    }
+
+    if(IDvalidmask != -1)
+    {
+        uint64_t nelem = data.image[IDvalidmask].md[0].nelement;
+        for(long k = 0; k < NBframe; k++)
+        {
+            if(((uint64_t) k >= nelem) ||
+                    (data.image[IDvalidmask].array.F[k] < 0.5))
+            {
+                framevalid[k] = 0;
+            }
+        }
+    }
+
+    long NBframevalid = 0;
+    for(long k = 0; k < NBframe; k++)
+    {
+        NBframevalid += framevalid[k];
+    }
+
+    return NBframevalid;
+}
+
+
+
+
+/**
+ * @brief Flag valid training samples
+ *
+ * Sample m spans frames m .. m+span-1, and is valid if none of them
+ * is invalid. Uses a running count of invalid frames, so the cost does
+ * not depend on span.
+ *
+ * NBinvalid is a work array of NBframe+1 entries, owned by the caller.
+ *
+ * @return number of valid samples
+ */
+long linARfilterPred_valid_samples(long           NBframe,
+                                   const uint8_t *framevalid,
+                                   long           NBmvec,
+                                   long           span,
+                                   uint8_t       *samplevalid,
+                                   long          *NBinvalid)
+{
+    // NBinvalid[k] : number of invalid frames before frame k
+    NBinvalid[0] = 0;
+    for(long k = 0; k < NBframe; k++)
+    {
+        NBinvalid[k + 1] = NBinvalid[k] + (1 - framevalid[k]);
+    }
+
+    long NBmvecvalid = 0;
+    for(long m = 0; m < NBmvec; m++)
+    {
+        long kend = m + span;
+        if(kend > NBframe)
+        {
+            kend = NBframe;
+        }
+        samplevalid[m] = (NBinvalid[kend] == NBinvalid[m]) ? 1 : 0;
+        NBmvecvalid += samplevalid[m];
+    }
+
+    return NBmvecvalid;
+}
@@ -0,0 +1,23 @@
+/**
+ * @file    linPF_valid.h
+ * @brief   Valid telemetry frames and training samples
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_VALID_H
+#define LINARFILTERPRED_LINPF_VALID_H
+
+long linARfilterPred_valid_frames(long        NBframe,
+                                  const char *segments,
+                                  imageID     IDvalidmask,
+                                  uint8_t    *framevalid);
+
+long linARfilterPred_valid_samples(long           NBframe,
+                                   const uint8_t *framevalid,
+                                   long           NBmvec,
+                                   long           span,
+                                   uint8_t       *samplevalid,
+                                   long          *NBinvalid);
+
+#endif
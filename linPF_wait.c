@@ -0,0 +1,224 @@
+/**
+ * @file    linPF_wait.c
+ * @brief   Input frame wait strategies for real-time filter apply
+ *
+ * Semaphore wait : the loop sleeps in sem_wait until the input stream is
+ * posted. Wake-up goes through the kernel scheduler, adding several to
+ * tens of us, more on cores shared with other processes.
+ *
+ * Spin wait : the loop polls the input stream cnt0, with a pause
+ * instruction between reads, and wakes as soon as the writer updates it.
+ * This keeps one core busy, and should be used on a dedicated core. If
+ * no frame arrives within the spin budget, the loop falls back to the
+ * semaphore until the next frame, so that an idle input does not burn
+ * the core indefinitely.
+ *
+ * The semaphore is still posted by the writer while spinning: it is
+ * drained before each wait, so that a fallback wait does not return on
+ * an already processed frame. Writers post the semaphore and increment
+ * cnt0 in either order: after a semaphore wake, cnt0 is polled shortly,
+ * so that the next spin wait does not wake on the same frame.
+ *
+ * Wake latency is measured as the difference between wake time and
+ * input stream write time (CLOCK_REALTIME), for each strategy.
+ */
+
+#include <time.h>
+
+#include "CommandLineInterface/CLIcore.h"
+
+#include "linPF_wait.h"
+
+
+// polls between spin budget checks
+#define WAIT_SPINCHECK 256
+
+// polls for cnt0 update after semaphore wake
+#define WAIT_CNT0POLL 10000
+
+
+static const char *modename[LINPF_WAIT_NBMODE] =
+{
+    "sem",
+    "spin"
+};
+
+
+
+
+static inline void wait_cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#else
+    __asm__ volatile("" ::: "memory");
+#endif
+}
+
+
+
+
+/**
+ * @brief Wait mode from name, -1 if unknown
+ */
+int linARfilterPred_wait_parsemode(const char *str)
+{
+    for(int mode = 0; mode < LINPF_WAIT_NBMODE; mode++)
+    {
+        if(strcmp(str, modename[mode]) == 0)
+        {
+            return mode;
+        }
+    }
+    return -1;
+}
+
+
+
+
+const char *linARfilterPred_wait_modename(int mode)
+{
+    if((mode < 0) || (mode >= LINPF_WAIT_NBMODE))
+    {
+        return "unknown";
+    }
+    return modename[mode];
+}
+
+
+
+
+/**
+ * @brief Initialize, cnt0 is the input cnt0 of the last processed frame
+ */
+errno_t linARfilterPred_wait_init(LINARFILTERPRED_WAIT *w,
+                                  int                   mode,
+                                  double                spinbudgetus,
+                                  uint64_t              cnt0)
+{
+    w->mode         = mode;
+    w->spinbudgetus = spinbudgetus;
+    w->cnt0last     = cnt0;
+    linARfilterPred_wait_reset(w);
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Reset wake latency statistics
+ */
+errno_t linARfilterPred_wait_reset(LINARFILTERPRED_WAIT *w)
+{
+    for(int mode = 0; mode < LINPF_WAIT_NBMODE; mode++)
+    {
+        w->NBwake[mode] = 0;
+        w->latsum[mode] = 0.0;
+        w->latmax[mode] = 0.0;
+    }
+
+    return RETURN_SUCCESS;
+}
+
+
+
+
+/**
+ * @brief Add wake latency of current frame to strategy statistics
+ *
+ * Frames without valid write time (not set by writer, or older than 1 s)
+ * are not counted.
+ */
+void linARfilterPred_wait_latency(LINARFILTERPRED_WAIT *w,
+                                  int                   strategy,
+                                  IMAGE_METADATA       *md)
+{
+    struct timespec tnow;
+    clock_gettime(CLOCK_REALTIME, &tnow);
+
+    double latus = 1.0e6 * (tnow.tv_sec - md->writetime.tv_sec) +
+                   1.0e-3 * (tnow.tv_nsec - md->writetime.tv_nsec);
+    if((latus >= 0.0) && (latus < 1.0e6))
+    {
+        w->NBwake[strategy]++;
+        w->latsum[strategy] += latus;
+        if(latus > w->latmax[strategy])
+        {
+            w->latmax[strategy] = latus;
+        }
+    }
+}
+
+
+
+
+/**
+ * @brief Wait for next input frame
+ *
+ * md is the input stream metadata, sem one of its semaphores, reserved
+ * for this loop.
+ *
+ * @return strategy that woke the loop
+ */
+int linARfilterPred_wait_frame(LINARFILTERPRED_WAIT *w,
+                               IMAGE_METADATA       *md,
+                               sem_t                *sem)
+{
+    volatile uint64_t *cnt0 = &md->cnt0;
+
+    // posts of processed frames
+    while(sem_trywait(sem) == 0)
+    {
+    }
+
+    int strategy = LINPF_WAIT_SEM;
+    if(*cnt0 != w->cnt0last)
+    {
+        // frame arrived during processing of previous frame
+        strategy = w->mode;
+    }
+    else if(w->mode == LINPF_WAIT_SPIN)
+    {
+        struct timespec t0;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+
+        long NBpoll = 0;
+        while(*cnt0 == w->cnt0last)
+        {
+            wait_cpu_relax();
+            NBpoll++;
+            if((w->spinbudgetus > 0.0) && (NBpoll % WAIT_SPINCHECK == 0))
+            {
+                struct timespec t1;
+                clock_gettime(CLOCK_MONOTONIC, &t1);
+                double dtus = 1.0e6 * (t1.tv_sec - t0.tv_sec) +
+                              1.0e-3 * (t1.tv_nsec - t0.tv_nsec);
+                if(dtus > w->spinbudgetus)
+                {
+                    break;
+                }
+            }
+        }
+        if(*cnt0 != w->cnt0last)
+        {
+            strategy = LINPF_WAIT_SPIN;
+        }
+    }
+
+    if((strategy == LINPF_WAIT_SEM) && (*cnt0 == w->cnt0last))
+    {
+        sem_wait(sem);
+        for(long poll = 0; (poll < WAIT_CNT0POLL) && (*cnt0 == w->cnt0last);
+                poll++)
+        {
+            wait_cpu_relax();
+        }
+    }
+
+    w->cnt0last = *cnt0;
+    linARfilterPred_wait_latency(w, strategy, md);
+
+    return strategy;
+}
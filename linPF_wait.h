@@ -0,0 +1,54 @@
+/**
+ * @file    linPF_wait.h
+ * @brief   Input frame wait strategies for real-time filter apply
+ *
+ *
+ */
+
+#ifndef LINARFILTERPRED_LINPF_WAIT_H
+#define LINARFILTERPRED_LINPF_WAIT_H
+
+#include <semaphore.h>
+#include <stdint.h>
+
+// wait strategies
+#define LINPF_WAIT_SEM    0 // semaphore
+#define LINPF_WAIT_SPIN   1 // poll input cnt0, semaphore after spin budget
+#define LINPF_WAIT_NBMODE 2
+
+/** @brief Wait strategy and wake latency statistics
+ *
+ * Wake latency is the time from input stream write time to wake, for
+ * each strategy that woke the loop.
+ */
+typedef struct
+{
+    int      mode;
+    double   spinbudgetus;             ///< spin time limit [us], 0: none
+    uint64_t cnt0last;                 ///< input cnt0 of last frame
+
+    uint64_t NBwake[LINPF_WAIT_NBMODE];
+    double   latsum[LINPF_WAIT_NBMODE]; ///< [us]
+    double   latmax[LINPF_WAIT_NBMODE]; ///< [us]
+} LINARFILTERPRED_WAIT;
+
+int linARfilterPred_wait_parsemode(const char *str);
+
+const char *linARfilterPred_wait_modename(int mode);
+
+errno_t linARfilterPred_wait_init(LINARFILTERPRED_WAIT *w,
+                                  int                   mode,
+                                  double                spinbudgetus,
+                                  uint64_t              cnt0);
+
+errno_t linARfilterPred_wait_reset(LINARFILTERPRED_WAIT *w);
+
+void linARfilterPred_wait_latency(LINARFILTERPRED_WAIT *w,
+                                  int                   strategy,
+                                  IMAGE_METADATA       *md);
+
+int linARfilterPred_wait_frame(LINARFILTERPRED_WAIT *w,
+                               IMAGE_METADATA       *md,
+                               sem_t                *sem);
+
+#endif